@@ -17,19 +17,40 @@
  */
 
 .equ FS_BASE, 0xffff000030000000
-.equ FS_SIZE, 101*16*63*512 // Num of cylinders * num of heads * num of sectors per track * block size
+.equ FS_PHYS_BASE, 0x30000000
+.equ FS_SIZE, 101*16*63*512 // Fallback without a partition table: Num of cylinders * num of heads * num of sectors per track * block size
+#ifdef RPI4
+.equ FS_MAX_SIZE, 0x40000000 - FS_PHYS_BASE // Up to the end of the first 1G covered by the kernel middle directory table
+#else
+.equ FS_MAX_SIZE, 0x3f000000 - FS_PHYS_BASE // Up to the start of the peripheral region
+#endif
+.equ MBR_PARTITION_ENTRY, 0x1be
+.equ MBR_SIGNATURE_OFFSET, 0x1fe
+.equ ZIMAGE_SIZE_OFFSET, 16 // Offset of the total size in the compressed disk image header
+.equ SPIN_TABLE_BASE, 0xd8 // Release address mailbox of core 0. Cores 1-3 poll the 8 byte mailboxes following it
 
 .section .text
 .global _start
+.global start_cpu
+.global secondary_entry
 
 _start:
     mrs x0, mpidr_el1
     # get the lower 2 bits of the x0 register
     and x0, x0, #3
-    # check if value is 0 (CPU0). We are building this kernel to run on CPU0 core only
+    # check if value is 0 (CPU0). The kernel is set up by CPU0 which releases the other cores once it is ready
     cmp x0, #0      
     beq kernel_entry
 
+    # Secondary cores which enter here rather than in the firmware's spin table loop poll their own mailbox just the same
+    mov x1, #SPIN_TABLE_BASE
+    add x1, x1, x0, lsl #3
+secondary_park:
+    wfe
+    ldr x0, [x1]
+    cbz x0, secondary_park
+    br x0
+
 end:
     # Equivalent to a NOP except that the system has stopped or stalled
     b end               
@@ -48,6 +69,12 @@ kernel_entry:
     mov x0, #1
     lsl x0, x0, #31
     msr hcr_el2, x0
+    # Clear the FP/SIMD trap bit (TFP) of the architectural feature trap register leaving only its reserved bits set
+    # Whether FP instructions trap is then decided at EL1 by the CPACR register
+    mov x0, #0x33ff
+    msr cptr_el2, x0
+    # Zero the virtual counter offset so that the virtual count read by user programs matches the physical count the kernel keeps time with
+    msr cntvoff_el2, xzr
 
     # Set the spsr register which will restore contents of pstate register with EL1 mode field and masked interrrupts (DAIF bits set to 1)
     mov x0, #0b1111000101
@@ -62,19 +89,40 @@ kernel_entry:
 el1_entry:
     # initialising stack pointer to 0x80000 which will then grow downwards from there
     mov sp, #0x80000
+    # Allow FP/SIMD at EL1 but trap it at EL0 (FPEN = 0b01) until a process first uses it
+    mov x0, #(1 << 20)
+    msr cpacr_el1, x0
+
+#if !defined(SDCARD) && !defined(ROOTFS_CPIO)
+    # Work out the size of the disk image appended to the kernel from its partition table
+    # The MMU is still off, hence the physical address of the image is taken relative to the program counter
+    adrp x0, disk_img_end
+    add x0, x0, :lo12:disk_img_end
+    bl disk_img_size
+    # Keep the size in a callee saved register for the copy after paging is enabled
+    mov x19, x0
+#else
+    # The filesystem is read on demand from the SD card or linked into the kernel as an archive, nothing is appended to the kernel image
+    mov x0, #0
+#endif
 
     # Set up paging and map kernel to the high memory address 0xFFFF000000000000 - 0xFFFFFFFFFFFFFFFF
+    # The mapping covers physical memory up to the end of the filesystem copied to FS_PHYS_BASE
+    mov x1, #FS_PHYS_BASE
+    add x0, x0, x1
     bl setup_vm
     bl enable_mmu
 
+#if !defined(SDCARD) && !defined(ROOTFS_CPIO)
     # Use memcpy to extract and load the filesystem appended to the kernel image just after the kernel end
     # The bss section does not have space reserved in kernel image file on the disk and bss start can have padding
-    # We can extract the FAT16 disk image immediately after data section ends which also marks end of kernel image on disk
+    # We can extract the FAT disk image immediately after data section ends which also marks end of kernel image on disk
     # Once we copy the fs in desired location, the bss segment is set up with memset in memory
     ldr x0, =FS_BASE
     ldr x1, =disk_img_end
-    ldr x2, =FS_SIZE
+    mov x2, x19
     bl memcpy
+#endif
 
     # Load start address of bss in register x0 and end address in x1
     ldr x0, =bss_start
@@ -108,7 +156,133 @@ idle:
     b idle
 
 halt:
+    # Only the boot core reports the shutdown
+    mrs x0, mpidr_el1
+    and x0, x0, #3
+    cbnz x0, halt_cpu
     bl shutdown_banner
+halt_cpu:
     # Disable all interrupts
     msr daifset, #2
     b end
+
+start_cpu:
+    # x0 => core number, x1 => physical address for the core to jump to
+    # Write the address to the spin table mailbox of the core and wake it up from wfe
+    # The data cache is disabled hence the store reaches memory where the core, still running without the MMU, polls for it
+    mov x2, #SPIN_TABLE_BASE
+    add x2, x2, x0, lsl #3
+    mov x3, #0xffff000000000000
+    add x2, x2, x3
+    str x1, [x2]
+    dsb sy
+    sev
+    ret
+
+secondary_entry:
+    # Secondary cores are released here by start_cpu with the MMU off. Drop from EL2 to EL1 like the boot core
+    mrs x0, currentel
+    lsr x0, x0, #2
+    cmp x0, #2
+    bne end
+
+    msr sctlr_el1, xzr
+    mov x0, #1
+    lsl x0, x0, #31
+    msr hcr_el2, x0
+    mov x0, #0x33ff
+    msr cptr_el2, x0
+    msr cntvoff_el2, xzr
+    mov x0, #0b1111000101
+    msr spsr_el2, x0
+    adr x0, secondary_el1_entry
+    msr elr_el2, x0
+
+    eret
+
+secondary_el1_entry:
+    mov x0, #(1 << 20)
+    msr cpacr_el1, x0
+    # The page tables were set up by the boot core. Just turn on paging with them
+    bl enable_mmu
+
+    ldr x0, =vector_table
+    msr vbar_el1, x0
+
+    # Switch to the kernel stack the boot core allocated for this core, found in cpu_stacks by the core number
+    mrs x1, mpidr_el1
+    and x1, x1, #3
+    ldr x0, =cpu_stacks
+    ldr x0, [x0, x1, lsl #3]
+    mov sp, x0
+
+    ldr x0, =secondary_main
+    blr x0
+    # The core becomes idle once it has set up its idle process, timer and run queue
+    b idle
+
+disk_img_size:
+    # x0 => start of the disk image. Returns the size of the image in bytes in x0
+    # Only byte loads are used since data accesses with the MMU off are treated as device memory which faults on unaligned access
+    # A compressed image starts with the magic "FBZ1" and carries its total size at offset 16 of the header
+    ldrb w1, [x0]
+    cmp w1, #0x46 // 'F'
+    bne disk_img_mbr
+    ldrb w1, [x0, #1]
+    cmp w1, #0x42 // 'B'
+    bne disk_img_mbr
+    ldrb w1, [x0, #2]
+    cmp w1, #0x5a // 'Z'
+    bne disk_img_mbr
+    ldrb w1, [x0, #3]
+    cmp w1, #0x31 // '1'
+    bne disk_img_mbr
+    add x3, x0, #ZIMAGE_SIZE_OFFSET
+    ldrb w1, [x3]
+    ldrb w2, [x3, #1]
+    orr w1, w1, w2, lsl #8
+    ldrb w2, [x3, #2]
+    orr w1, w1, w2, lsl #16
+    ldrb w2, [x3, #3]
+    orr w1, w1, w2, lsl #24
+    mov x0, x1
+    b disk_img_clamp
+
+disk_img_mbr:
+    # Fall back to the legacy fixed geometry if the image does not carry an MBR boot signature (0x55 0xaa)
+    ldrb w1, [x0, #MBR_SIGNATURE_OFFSET]
+    ldrb w2, [x0, #(MBR_SIGNATURE_OFFSET + 1)]
+    cmp w1, #0x55
+    bne disk_img_default
+    cmp w2, #0xaa
+    bne disk_img_default
+    # The first partition entry holds the starting LBA at offset 8 followed by the sector count, both 32-bit little endian
+    add x3, x0, #(MBR_PARTITION_ENTRY + 8)
+    ldrb w1, [x3]
+    ldrb w2, [x3, #1]
+    orr w1, w1, w2, lsl #8
+    ldrb w2, [x3, #2]
+    orr w1, w1, w2, lsl #16
+    ldrb w2, [x3, #3]
+    orr w1, w1, w2, lsl #24
+    ldrb w4, [x3, #4]
+    ldrb w2, [x3, #5]
+    orr w4, w4, w2, lsl #8
+    ldrb w2, [x3, #6]
+    orr w4, w4, w2, lsl #16
+    ldrb w2, [x3, #7]
+    orr w4, w4, w2, lsl #24
+    cbz w4, disk_img_default
+    # The image ends where the partition ends. Convert sectors to bytes (512 byte sectors)
+    add x1, x1, x4
+    lsl x0, x1, #9
+disk_img_clamp:
+    # Clamp to the physical memory reserved for the filesystem
+    ldr x1, =FS_MAX_SIZE
+    cmp x0, x1
+    csel x0, x1, x0, hi
+    ret
+
+disk_img_default:
+    ldr x0, =FS_SIZE
+    ret
@@ -0,0 +1,248 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "block.h"
+#include "file.h"
+#include "lz4.h"
+#include <lib/lib.h>
+#include <memory/memory.h>
+#include <io/emmc.h>
+#include <io/print.h>
+
+static struct Buffer buffers[BCACHE_BUFFERS];
+/* Sentinel of the LRU list. The most recently used buffer follows it and the least recently used one precedes it */
+static struct Buffer lru;
+static uint8_t readahead_buf[BCACHE_READAHEAD * SECTOR_SIZE] __attribute__((aligned(8)));
+
+#ifdef SDCARD
+static struct BlockDevice sdcard = {
+    .name = "sd",
+    .base = NULL,
+    .read = emmc_read_blocks
+};
+#else
+/* The disk image appended to the kernel image and copied to FS_BASE at boot */
+static struct BlockDevice ramdisk = {
+    .name = "ram",
+    .base = (uint8_t*)FS_BASE,
+    .read = NULL
+};
+
+/* Compressed disk image copied to FS_BASE at boot. Chunks are decompressed on first access and kept for later reads */
+static bool zdisk_read(uint64_t lba, uint32_t count, void* buf);
+static struct BlockDevice zdisk = {
+    .name = "lz4",
+    .base = NULL,
+    .read = zdisk_read
+};
+static struct ZImageHeader* zimage;
+static uint32_t* zimage_offsets;
+static uint8_t* zchunks[ZIMAGE_MAX_CHUNKS];
+/* Page currently carved up for decompressed chunks and the bytes used from it */
+static uint8_t* zpage;
+static uint32_t zpage_used;
+#endif
+
+static void move_to_front(struct Buffer* buf)
+{
+    /* Unlink from the current position and insert right after the sentinel */
+    buf->prev->next = buf->next;
+    buf->next->prev = buf->prev;
+    buf->next = lru.next;
+    buf->prev = &lru;
+    lru.next->prev = buf;
+    lru.next = buf;
+}
+
+static struct Buffer* lookup_buffer(uint64_t lba)
+{
+    for (struct Buffer* buf = lru.next; buf != &lru; buf = buf->next)
+    {
+        if (buf->valid && buf->lba == lba)
+            return buf;
+    }
+    return NULL;
+}
+
+static struct Buffer* get_buffer(struct BlockDevice* dev, uint64_t lba)
+{
+    struct Buffer* buf = lookup_buffer(lba);
+    uint32_t count = BCACHE_READAHEAD;
+
+    if (buf != NULL){
+        move_to_front(buf);
+        return buf;
+    }
+
+    /* On a miss, read the following sectors along with the requested one since file data is mostly read sequentially
+       Retry with only the requested sector in case the read ahead runs past the end of the disk */
+    if (!dev->read(lba, count, readahead_buf)){
+        count = 1;
+        if (!dev->read(lba, count, readahead_buf))
+            return NULL;
+    }
+    /* Install in reverse so that the requested sector ends up as the most recently used. Victims come off the tail */
+    for (int i = count-1; i >= 0; i--)
+    {
+        buf = lookup_buffer(lba + i);
+        if (buf == NULL){
+            buf = lru.prev;
+            buf->lba = lba + i;
+            buf->valid = true;
+            memcpy(buf->data, readahead_buf + i * SECTOR_SIZE, SECTOR_SIZE);
+        }
+        move_to_front(buf);
+    }
+
+    return buf;
+}
+
+bool block_read(struct BlockDevice* dev, uint64_t offset, void* buf, uint32_t size)
+{
+    struct Buffer* sector;
+    uint32_t sector_offset, copy_size;
+
+    /* A memory resident image needs no caching */
+    if (dev->base != NULL){
+        memcpy(buf, dev->base + offset, size);
+        return true;
+    }
+
+    while (size > 0)
+    {
+        sector_offset = offset % SECTOR_SIZE;
+        copy_size = SECTOR_SIZE - sector_offset;
+        if (copy_size > size)
+            copy_size = size;
+        sector = get_buffer(dev, offset / SECTOR_SIZE);
+        if (sector == NULL)
+            return false;
+        memcpy(buf, sector->data + sector_offset, copy_size);
+        buf = (uint8_t*)buf + copy_size;
+        offset += copy_size;
+        size -= copy_size;
+    }
+
+    return true;
+}
+
+#ifndef SDCARD
+static uint8_t* load_chunk(uint32_t index)
+{
+    uint32_t start = zimage_offsets[index];
+    uint32_t size = zimage_offsets[index+1] - start;
+    uint8_t* chunk;
+
+    if (zchunks[index] != NULL)
+        return zchunks[index];
+    /* Decompressed chunks are never evicted, take a new page once the current one is used up */
+    if (zpage == NULL || zpage_used + zimage->chunk_size > PAGE_SIZE){
+        zpage = kalloc();
+        if (zpage == NULL)
+            return NULL;
+        zpage_used = 0;
+    }
+    chunk = zpage + zpage_used;
+
+    if (size == 0)
+        memset(chunk, 0, zimage->chunk_size);
+    else if (size == zimage->chunk_size)
+        memcpy(chunk, (uint8_t*)zimage + start, size);
+    else if (lz4_decompress((uint8_t*)zimage + start, size, chunk, zimage->chunk_size) != zimage->chunk_size){
+        printk("Corrupt chunk %u in compressed disk image\n", index);
+        return NULL;
+    }
+    zpage_used += zimage->chunk_size;
+    zchunks[index] = chunk;
+
+    return chunk;
+}
+
+static bool zdisk_read(uint64_t lba, uint32_t count, void* buf)
+{
+    uint64_t offset = lba * SECTOR_SIZE;
+    uint64_t end = offset + (uint64_t)count * SECTOR_SIZE;
+    uint32_t chunk_offset, copy_size;
+    uint8_t* chunk;
+
+    if (end > zimage->image_size)
+        return false;
+    while (offset < end)
+    {
+        chunk = load_chunk(offset / zimage->chunk_size);
+        if (chunk == NULL)
+            return false;
+        chunk_offset = offset % zimage->chunk_size;
+        copy_size = zimage->chunk_size - chunk_offset;
+        if (copy_size > end - offset)
+            copy_size = end - offset;
+        memcpy(buf, chunk + chunk_offset, copy_size);
+        buf = (uint8_t*)buf + copy_size;
+        offset += copy_size;
+    }
+
+    return true;
+}
+
+static bool init_zdisk(void)
+{
+    zimage = (struct ZImageHeader*)FS_BASE;
+    zimage_offsets = (uint32_t*)(zimage + 1);
+    /* Chunks are whole sectors and have to pack evenly into a page */
+    if (zimage->chunk_size == 0 || zimage->chunk_size % SECTOR_SIZE != 0 || PAGE_SIZE % zimage->chunk_size != 0 ||
+        zimage->chunk_count > ZIMAGE_MAX_CHUNKS || (uint64_t)zimage->chunk_count * zimage->chunk_size < zimage->image_size){
+        printk("Invalid compressed disk image\n");
+        return false;
+    }
+    printk("Compressed disk image: %u KB unpacks to %u KB\n", zimage->total_size / 1024, zimage->image_size / 1024);
+
+    return true;
+}
+#endif
+
+static void init_bcache(void)
+{
+    lru.next = &lru;
+    lru.prev = &lru;
+    for (int i = 0; i < BCACHE_BUFFERS; i++)
+    {
+        buffers[i].valid = false;
+        buffers[i].next = lru.next;
+        buffers[i].prev = &lru;
+        lru.next->prev = buffers + i;
+        lru.next = buffers + i;
+    }
+}
+
+struct BlockDevice* init_block_device(void)
+{
+    init_bcache();
+#ifdef SDCARD
+    /* Read the disk from the SD card on demand instead of a copy preloaded in memory */
+    if (!init_emmc()){
+        printk("SD card initialization failed\n");
+        return NULL;
+    }
+    return &sdcard;
+#else
+    /* A compressed image is recognised by the magic number in its header, otherwise it is a plain disk image */
+    if (((struct ZImageHeader*)FS_BASE)->magic == ZIMAGE_MAGIC)
+        return init_zdisk() ? &zdisk : NULL;
+    return &ramdisk;
+#endif
+}
@@ -0,0 +1,66 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BLOCK_H
+#define _BLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SECTOR_SIZE 512
+#define BCACHE_BUFFERS 128
+#define BCACHE_READAHEAD 8 /* Sectors fetched with a single request on a cache miss */
+
+#define ZIMAGE_MAGIC 0x315a4246 /* "FBZ1" */
+#define ZIMAGE_MAX_CHUNKS 4096
+
+/* A disk the root filesystem is read from */
+struct BlockDevice
+{
+    const char* name;
+    uint8_t* base; /* Start of a memory resident image. NULL if sectors are fetched through the buffer cache */
+    bool (*read)(uint64_t lba, uint32_t count, void* buf);
+};
+
+/* Header of a compressed disk image. The image is split in fixed size chunks compressed independently as LZ4 blocks
+   An offset table of chunk_count+1 entries relative to the header follows, chunk i spans offsets i to i+1
+   A chunk of length 0 is all zeros and a chunk of length chunk_size is stored uncompressed */
+struct ZImageHeader
+{
+    uint32_t magic;
+    uint32_t chunk_size;
+    uint32_t chunk_count;
+    uint32_t image_size; /* Size of the uncompressed disk image */
+    uint32_t total_size; /* Size of the compressed image including this header and the offset table */
+    uint32_t reserved[3];
+};
+
+/* A cached disk sector. Buffers are kept on a list in least recently used order */
+struct Buffer
+{
+    struct Buffer* prev;
+    struct Buffer* next;
+    uint64_t lba;
+    bool valid;
+    uint8_t data[SECTOR_SIZE] __attribute__((aligned(8)));
+};
+
+struct BlockDevice* init_block_device(void);
+bool block_read(struct BlockDevice* dev, uint64_t offset, void* buf, uint32_t size);
+
+#endif
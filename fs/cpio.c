@@ -0,0 +1,229 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cpio.h"
+#include <kernel.h>
+#include <lib/lib.h>
+#include <io/print.h>
+#include <debug/debug.h>
+
+/* Bounds of the newc archive linked into the kernel image (fs/initramfs.s) */
+extern char initramfs_start[];
+extern char initramfs_end[];
+
+static struct CpioFile cpio_files[CPIO_MAX_FILES];
+static int cpio_file_count;
+/* Open addressed index from the 8.3 name to a file built once at boot. Empty slots hold -1 */
+static int16_t cpio_index[CPIO_HASH_SLOTS];
+static struct FileSystem cpio_fs;
+
+static uint32_t parse_hex(const char* field)
+{
+    uint32_t value = 0;
+
+    for (int i = 0; i < CPIO_FIELD_SIZE; i++)
+    {
+        char ch = field[i];
+        value <<= 4;
+        if (ch >= '0' && ch <= '9')
+            value |= ch - '0';
+        else if (ch >= 'a' && ch <= 'f')
+            value |= ch - 'a' + 10;
+        else if (ch >= 'A' && ch <= 'F')
+            value |= ch - 'A' + 10;
+        else
+            return UINT32_MAX;
+    }
+
+    return value;
+}
+
+static int find_file(char* name, char* ext)
+{
+    uint32_t slot = name_hash(name, ext) & (CPIO_HASH_SLOTS - 1);
+
+    while (cpio_index[slot] >= 0)
+    {
+        struct Inode* inode = &cpio_files[cpio_index[slot]].inode;
+        if (memcmp(inode->name, name, MAX_FILENAME_BYTES) == 0 && memcmp(inode->ext, ext, MAX_EXTNAME_BYTES) == 0)
+            return cpio_index[slot];
+        slot = (slot + 1) & (CPIO_HASH_SLOTS - 1);
+    }
+
+    return -1;
+}
+
+static struct Inode* cpio_lookup(char* path, bool create)
+{
+    char name[MAX_FILENAME_BYTES];
+    char ext[MAX_EXTNAME_BYTES];
+    int index;
+
+    /* The archive is part of the kernel image and read-only */
+    if (create)
+        return NULL;
+    memset(name, CHAR_SPACE_ASCII, MAX_FILENAME_BYTES);
+    memset(ext, CHAR_SPACE_ASCII, MAX_EXTNAME_BYTES);
+    if (!split_path(path, name, ext))
+        return NULL;
+    to_upper_bytes(name, MAX_FILENAME_BYTES);
+    to_upper_bytes(ext, MAX_EXTNAME_BYTES);
+
+    index = find_file(name, ext);
+    if (index < 0)
+        return NULL;
+    cpio_files[index].inode.ref_count++;
+
+    return &cpio_files[index].inode;
+}
+
+static uint32_t cpio_read(struct Inode* inode, void* buf, uint32_t offset, uint32_t size)
+{
+    struct CpioFile* file = (struct CpioFile*)inode;
+
+    memcpy(buf, file->data + offset, size);
+
+    return size;
+}
+
+static void* cpio_map(struct Inode* inode, uint32_t offset, uint32_t* size)
+{
+    struct CpioFile* file = (struct CpioFile*)inode;
+
+    /* Files are stored whole in the archive, the rest of the file can be handed out at once */
+    if (offset >= inode->file_size)
+        return NULL;
+    if (*size > inode->file_size - offset)
+        *size = inode->file_size - offset;
+
+    return file->data + offset;
+}
+
+static int cpio_list(struct DirEntry* entries, int max)
+{
+    int count = 0;
+
+    for (int i = 0; i < cpio_file_count && count < max; i++, count++)
+    {
+        memset(entries + count, 0, sizeof(struct DirEntry));
+        memcpy(entries[count].name, cpio_files[i].inode.name, MAX_FILENAME_BYTES);
+        memcpy(entries[count].ext, cpio_files[i].inode.ext, MAX_EXTNAME_BYTES);
+        entries[count].attributes = ATTR_FILETYPE_FILE;
+        entries[count].file_size = cpio_files[i].inode.file_size;
+    }
+
+    return count;
+}
+
+static struct FileSystem cpio_fs = {
+    .mount_point = "/",
+    .lookup = cpio_lookup,
+    .read = cpio_read,
+    .write = NULL,
+    .map = cpio_map,
+    .list = cpio_list,
+    .close = NULL,
+    .release = NULL,
+    .remove = NULL,
+    .stream = false
+};
+
+/* Add a regular file from the archive to the table and the name index. Names which don't fit 8.3 are skipped */
+static void add_file(char* path, uint8_t* data, uint32_t size)
+{
+    struct CpioFile* file;
+    char name[MAX_FILENAME_BYTES];
+    char ext[MAX_EXTNAME_BYTES];
+    uint32_t slot;
+
+    /* Archives built with find carry a ./ prefix */
+    if (path[0] == '.' && path[1] == '/')
+        path += 2;
+    memset(name, CHAR_SPACE_ASCII, MAX_FILENAME_BYTES);
+    memset(ext, CHAR_SPACE_ASCII, MAX_EXTNAME_BYTES);
+    if (*path == '\0' || !split_path(path, name, ext)){
+        printk("cpio: skipping %s\n", path);
+        return;
+    }
+    to_upper_bytes(name, MAX_FILENAME_BYTES);
+    to_upper_bytes(ext, MAX_EXTNAME_BYTES);
+    if (find_file(name, ext) >= 0 || cpio_file_count == CPIO_MAX_FILES){
+        printk("cpio: skipping %s\n", path);
+        return;
+    }
+
+    file = cpio_files + cpio_file_count;
+    memcpy(file->inode.name, name, MAX_FILENAME_BYTES);
+    memcpy(file->inode.ext, ext, MAX_EXTNAME_BYTES);
+    file->inode.dir_index = cpio_file_count;
+    file->inode.file_size = size;
+    file->inode.contiguous = true;
+    file->inode.fs = &cpio_fs;
+    file->data = data;
+
+    slot = name_hash(name, ext) & (CPIO_HASH_SLOTS - 1);
+    while (cpio_index[slot] >= 0)
+    {
+        slot = (slot + 1) & (CPIO_HASH_SLOTS - 1);
+    }
+    cpio_index[slot] = cpio_file_count++;
+}
+
+/* Walk the newc archive once and index every regular file in it
+   Each member is a 110 byte ASCII header, the name and the data, with name and data padded to 4 bytes */
+static bool parse_archive(char* start, char* end)
+{
+    char* pos = start;
+    uint32_t mode, file_size, name_size;
+    char* name;
+    uint8_t* data;
+
+    while (pos + CPIO_HEADER_SIZE <= end)
+    {
+        if (memcmp(pos, CPIO_MAGIC, sizeof(CPIO_MAGIC) - 1) != 0)
+            return false;
+        mode = parse_hex(pos + CPIO_MODE_OFFSET);
+        file_size = parse_hex(pos + CPIO_FILESIZE_OFFSET);
+        name_size = parse_hex(pos + CPIO_NAMESIZE_OFFSET);
+        if (mode == UINT32_MAX || file_size == UINT32_MAX || name_size == UINT32_MAX || name_size == 0)
+            return false;
+        name = pos + CPIO_HEADER_SIZE;
+        data = (uint8_t*)start + UPPER_BOUND((uint64_t)(name - start) + name_size, 4);
+        if (name + name_size > end || name[name_size-1] != '\0' || (char*)data + file_size > end)
+            return false;
+        if (name_size == sizeof(CPIO_TRAILER) && memcmp(name, CPIO_TRAILER, sizeof(CPIO_TRAILER)) == 0)
+            return true;
+
+        if ((mode & CPIO_TYPE_MASK) == CPIO_TYPE_REGULAR)
+            add_file(name, data, file_size);
+        pos = start + UPPER_BOUND((uint64_t)((char*)data - start) + file_size, 4);
+    }
+
+    return false;
+}
+
+void init_cpio(void)
+{
+    for (int i = 0; i < CPIO_HASH_SLOTS; i++)
+        cpio_index[i] = -1;
+    cpio_file_count = 0;
+    ASSERT(parse_archive(initramfs_start, initramfs_end));
+    printk("cpio root filesystem: %d files\n", cpio_file_count);
+    /* The archive is always mounted as the root filesystem */
+    ASSERT(mount_fs(&cpio_fs));
+}
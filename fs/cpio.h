@@ -0,0 +1,45 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CPIO_H
+#define _CPIO_H
+
+#include "file.h"
+
+#define CPIO_MAX_FILES 256
+#define CPIO_HASH_SLOTS 512 /* Power of 2, twice the file count keeps probe sequences short */
+#define CPIO_HEADER_SIZE 110
+#define CPIO_FIELD_SIZE 8
+#define CPIO_MODE_OFFSET 14
+#define CPIO_FILESIZE_OFFSET 54
+#define CPIO_NAMESIZE_OFFSET 94
+#define CPIO_TYPE_MASK 0170000
+#define CPIO_TYPE_REGULAR 0100000
+#define CPIO_MAGIC "070701"
+#define CPIO_TRAILER "TRAILER!!!"
+
+/* A regular file in the archive linked into the kernel image. Data is handed out in place */
+struct CpioFile
+{
+    struct Inode inode;
+    uint8_t* data;
+};
+
+void init_cpio(void);
+
+#endif
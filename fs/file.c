@@ -22,70 +22,112 @@
 #include <lib/lib.h>
 #include <debug/debug.h>
 #include <process/process.h>
+#include "tmpfs.h"
+#include "procfs.h"
+#include "pipe.h"
+#include "block.h"
+#include "cpio.h"
+#include <io/uart.h>
 
 static struct Inode* inode_table;
 static struct FileEntry* global_file_table;
-
-static struct BPB* get_fs_bpb(void)
+/* Guards slot allocation and reference counts of the in core inode and global file tables */
+static struct Spinlock table_lock;
+static struct FileSystem* mount_table[MAX_MOUNTS];
+static struct FileSystem fat_fs;
+static int fat_list(struct DirEntry* entries, int max);
+
+static struct FatVolume volume;
+/* Lookup index of the root directory. Valid only if slot_count is non-zero */
+static struct FsIndexHeader index_header;
+static struct FsIndexEntry index_table[FS_INDEX_MAX_SLOTS];
+
+/* Position in the root directory while walking it entry by entry */
+struct DirCursor
 {
-    uint32_t lba = *(uint32_t*)(FS_BASE + PARTITION_ENTRY_OFFSET + LBA_OFFSET);
+    uint32_t index; /* Index of the next entry */
+    uint32_t cluster; /* Cluster holding the next entry on FAT32 */
+};
 
-    return (struct BPB*)(FS_BASE + (lba * BYTES_PER_SECTOR));
+static bool read_volume(uint64_t offset, void* buf, uint32_t size)
+{
+    return block_read(volume.dev, volume.base + offset, buf, size);
 }
 
-static uint16_t *get_fat_table(void)
+static uint32_t get_next_cluster_index(uint32_t cluster_index)
 {
-    struct BPB* bpb = get_fs_bpb();
-    uint32_t offset = (uint32_t)bpb->reserved_sector_count * bpb->bytes_per_sector;
+    uint32_t entry = 0;
 
-    return (uint16_t *)((uint8_t*)bpb + offset);
+    /* FAT32 entries are 28 bits wide, the top 4 bits are reserved. An unreadable entry ends the chain */
+    if (volume.type == FAT_TYPE_32){
+        if (!read_volume(volume.fat_offset + (uint64_t)cluster_index * sizeof(uint32_t), &entry, sizeof(uint32_t)))
+            return volume.end_of_chain;
+        return entry & FAT32_ENTRY_MASK;
+    }
+    if (!read_volume(volume.fat_offset + (uint64_t)cluster_index * sizeof(uint16_t), &entry, sizeof(uint16_t)))
+        return volume.end_of_chain;
+    return entry;
 }
 
-static uint16_t get_next_cluster_index(uint32_t cluster_index)
+static bool end_of_chain(uint32_t cluster_index)
 {
-    uint16_t *fat_table = get_fat_table();
-
-    return fat_table[cluster_index];
+    return cluster_index >= volume.end_of_chain;
 }
 
 static uint32_t get_cluster_size(void)
 {
-    struct BPB* bpb = get_fs_bpb();
-
-    return (uint32_t)bpb->bytes_per_sector * bpb->sectors_per_cluster;
+    return volume.cluster_size;
 }
 
-static uint32_t get_cluster_offset(uint32_t index)
+static uint64_t get_cluster_offset(uint32_t index)
 {
     ASSERT(index >= FAT_RESERVED_BYTES);
 
-    struct BPB* bpb = get_fs_bpb();
-
-    /* Starting from the FAT partition, calculate the size reserved for the BIOS param block */
-    uint32_t bpb_size = (uint32_t)bpb->reserved_sector_count * bpb->bytes_per_sector;
-    /* Next calculate the size occupied on disk by the file allocation table section */
-    uint32_t fat_size = (uint32_t)bpb->fat_count * bpb->sectors_per_fat * bpb->bytes_per_sector;
-    /* Finally, calculate the size occupied by the root directory section */
-    uint32_t dir_size = (uint32_t)bpb->root_entry_count * sizeof(struct DirEntry);
-
     /* Subtract the reserved bytes in the allocation table because the first index always starts after that */
-    return bpb_size + fat_size + dir_size + (index - FAT_RESERVED_BYTES) * get_cluster_size();
+    return volume.data_offset + (uint64_t)(index - FAT_RESERVED_BYTES) * volume.cluster_size;
 }
 
-static uint32_t get_root_dir_count(void)
+static uint32_t get_dir_entry_cluster(struct DirEntry* dir_entry)
 {
-    struct BPB* bpb = get_fs_bpb();
-
-    return bpb->root_entry_count;
+    if (volume.type == FAT_TYPE_32)
+        return ((uint32_t)dir_entry->cluster_index_hi << 16) | dir_entry->cluster_index;
+    return dir_entry->cluster_index;
 }
 
-static struct DirEntry *get_root_dir_section(void)
+/* Read the root directory entry at the cursor and advance it. Returns false past the last entry
+   FAT16 has a single fixed region while the FAT32 root directory is a cluster chain like any other file */
+static bool next_root_dir_entry(struct DirCursor* cursor, struct DirEntry* entry)
 {
-    struct BPB* bpb = get_fs_bpb();
-    /* Get the offset from FAT partition beginning (BIOS param block) to the root directory section */
-    uint32_t offset = (bpb->reserved_sector_count + (uint32_t)bpb->fat_count * bpb->sectors_per_fat) * bpb->bytes_per_sector;
+    uint32_t entries_per_cluster = volume.cluster_size / sizeof(struct DirEntry);
+    uint64_t offset;
 
-    return (struct DirEntry *)((uint64_t)bpb + offset);
+    if (cursor->index == DIR_ENTRY_END)
+        return false;
+    if (volume.type == FAT_TYPE_16){
+        if (cursor->index >= volume.root_entry_count){
+            cursor->index = DIR_ENTRY_END;
+            return false;
+        }
+        offset = volume.root_offset + (uint64_t)cursor->index * sizeof(struct DirEntry);
+    }
+    else{
+        if (cursor->index == 0)
+            cursor->cluster = volume.root_cluster;
+        else if (cursor->index % entries_per_cluster == 0)
+            cursor->cluster = get_next_cluster_index(cursor->cluster);
+        if (cursor->cluster < FAT_RESERVED_BYTES || end_of_chain(cursor->cluster)){
+            cursor->index = DIR_ENTRY_END;
+            return false;
+        }
+        offset = get_cluster_offset(cursor->cluster) + (uint64_t)(cursor->index % entries_per_cluster) * sizeof(struct DirEntry);
+    }
+    if (!read_volume(offset, entry, sizeof(struct DirEntry))){
+        cursor->index = DIR_ENTRY_END;
+        return false;
+    }
+    cursor->index++;
+
+    return true;
 }
 
 static bool file_match(struct DirEntry *dir_entry, char *name, char *ext)
@@ -93,7 +135,7 @@ static bool file_match(struct DirEntry *dir_entry, char *name, char *ext)
     return memcmp(dir_entry->name, name, MAX_FILENAME_BYTES) == 0 && memcmp(dir_entry->ext, ext, MAX_EXTNAME_BYTES) == 0;
 }
 
-static bool split_path(char *path, char *name, char *ext)
+bool split_path(char *path, char *name, char *ext)
 {
     int i;
 
@@ -130,47 +172,92 @@ static bool split_path(char *path, char *name, char *ext)
     return true;
 }
 
-static uint32_t search_file(char *path)
+static uint32_t search_file(char *path, struct DirEntry* entry)
 {
     char name[MAX_FILENAME_BYTES];
     char ext[MAX_EXTNAME_BYTES];
-    uint32_t root_entry_count;
-    struct DirEntry *dir_entry;
-    uint32_t dir_index = DIR_ENTRY_INVALID;
+    struct DirCursor cursor = {0, 0};
 
     /* Initialize the buffers with spaces */
     memset(name, CHAR_SPACE_ASCII, MAX_FILENAME_BYTES);
     memset(ext, CHAR_SPACE_ASCII, MAX_EXTNAME_BYTES);
 
     if (split_path(path, name, ext)) {
-        root_entry_count = get_root_dir_count();
-        dir_entry = get_root_dir_section();
-
-        for (uint32_t i = 0; i < root_entry_count; i++) {
-            if (dir_entry[i].name[0] == ENTRY_AVAILABLE || dir_entry[i].name[0] == ENTRY_DELETED)
+        while (next_root_dir_entry(&cursor, entry))
+        {
+            /* A free entry marks the end of the directory, no further entries are in use */
+            if (entry->name[0] == ENTRY_AVAILABLE)
+                break;
+            if (entry->name[0] == ENTRY_DELETED)
                 continue;
 
-            if (dir_entry[i].attributes == INVALID_FILETYPE)
+            if (entry->attributes == INVALID_FILETYPE)
                 continue;
 
-            if (file_match(dir_entry+i, name, ext)){
-                dir_index = i;
-                break;
-            }
+            if (file_match(entry, name, ext))
+                return cursor.index - 1;
         }
     }
 
-    return dir_index;
+    return DIR_ENTRY_INVALID;
+}
+
+/* Fold a name to upper case in place. Names are matched case insensitively in line with the 8.3 filename convention */
+void to_upper_bytes(char* str, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        if (str[i] >= 'a' && str[i] <= 'z')
+            str[i] -= ('a' - 'A');
+    }
+}
+
+uint32_t name_hash(char* name, char* ext)
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+
+    /* FNV-1a over the space padded 8.3 name as stored in the directory entry */
+    for (int i = 0; i < MAX_FILENAME_BYTES; i++)
+        hash = (hash ^ (uint8_t)name[i]) * FNV_PRIME;
+    for (int i = 0; i < MAX_EXTNAME_BYTES; i++)
+        hash = (hash ^ (uint8_t)ext[i]) * FNV_PRIME;
+
+    return hash;
+}
+
+static struct FsIndexEntry* search_index(char* path)
+{
+    char name[MAX_FILENAME_BYTES];
+    char ext[MAX_EXTNAME_BYTES];
+    uint32_t hash, slot;
+
+    memset(name, CHAR_SPACE_ASCII, MAX_FILENAME_BYTES);
+    memset(ext, CHAR_SPACE_ASCII, MAX_EXTNAME_BYTES);
+    if (!split_path(path, name, ext))
+        return NULL;
+
+    /* Linear probing from the home slot until the entry or an empty slot is found */
+    hash = name_hash(name, ext);
+    slot = hash & (index_header.slot_count - 1);
+    for (uint32_t i = 0; i < index_header.slot_count; i++)
+    {
+        struct FsIndexEntry* entry = index_table + slot;
+        if (!(entry->flags & FS_INDEX_USED))
+            break;
+        if (entry->hash == hash && memcmp(entry->name, name, MAX_FILENAME_BYTES) == 0 && memcmp(entry->ext, ext, MAX_EXTNAME_BYTES) == 0)
+            return entry;
+        slot = (slot + 1) & (index_header.slot_count - 1);
+    }
+
+    return NULL;
 }
 
 static uint32_t read_raw_data(uint32_t cluster_index, char *buf, uint32_t offset, uint32_t size)
 {
-    char *data;
     uint32_t read_size = 0;
     uint32_t cluster_size, start_cluster;
-    uint32_t index, start_offset, copy_size, bytes_remaining;
+    uint32_t index, start_offset, copy_size;
     
-    struct BPB* bpb = get_fs_bpb();
     cluster_size = get_cluster_size();
     /* Get the starting cluster number based on the file offset */
     start_cluster = offset / cluster_size;
@@ -181,86 +268,393 @@ static uint32_t read_raw_data(uint32_t cluster_index, char *buf, uint32_t offset
         start_cluster--;
     }
 
-    if (index < FAT_RESERVED_BYTES)
+    if (index < FAT_RESERVED_BYTES || end_of_chain(index))
         return UINT32_MAX;
 
-    /* Point data to address where reading should start after calculating the offset into the chosen cluster */
+    /* Reading starts at the offset into the chosen cluster and continues from the start of every following cluster */
     start_offset = offset % cluster_size;
-    data  = (char *)((uint64_t)bpb + get_cluster_offset(index) + start_offset);
-    uint32_t boundary_offset = cluster_size - start_offset;
-    copy_size = size > boundary_offset ? boundary_offset : size;
-    
     while (read_size < size)
     {
-        memcpy(buf, data, copy_size);
+        copy_size = cluster_size - start_offset;
+        if (copy_size > size - read_size)
+            copy_size = size - read_size;
+        if (!read_volume(get_cluster_offset(index) + start_offset, buf, copy_size))
+            return read_size > 0 ? read_size : UINT32_MAX;
 
         buf += copy_size;
         read_size += copy_size;
-        bytes_remaining = size - read_size;
-        copy_size = bytes_remaining > cluster_size ? cluster_size : bytes_remaining;
+        start_offset = 0;
+        if (read_size == size)
+            break;
 
         index = get_next_cluster_index(index);
-        if (index == END_OF_DATA) {
-            memcpy(buf, data, bytes_remaining);
-            read_size += bytes_remaining;
+        if (index < FAT_RESERVED_BYTES || end_of_chain(index))
             break;
-        }
-        data  = (char *)((uint64_t)bpb + get_cluster_offset(index));
     }
 
     return read_size;
 }
 
+static uint32_t fat_read(struct Inode* inode, void* buf, uint32_t offset, uint32_t size)
+{
+    /* Files laid out in consecutive clusters are read in one go without following the chain */
+    if (inode->contiguous){
+        if (inode->cluster_index < FAT_RESERVED_BYTES)
+            return UINT32_MAX;
+        return read_volume(get_cluster_offset(inode->cluster_index) + offset, buf, size) ? size : UINT32_MAX;
+    }
+    return read_raw_data(inode->cluster_index, buf, offset, size);
+}
+
+static void* fat_map(struct Inode* inode, uint32_t offset, uint32_t* size)
+{
+    uint32_t cluster_size = get_cluster_size();
+    uint32_t start_cluster = offset / cluster_size;
+    uint32_t start_offset = offset % cluster_size;
+    uint32_t index = inode->cluster_index;
+
+    if (offset >= inode->file_size)
+        return NULL;
+    if (inode->contiguous){
+        if (index < FAT_RESERVED_BYTES)
+            return NULL;
+        if (*size > inode->file_size - offset)
+            *size = inode->file_size - offset;
+        return volume.dev->base + volume.base + get_cluster_offset(index) + offset;
+    }
+    while (start_cluster)
+    {
+        index = get_next_cluster_index(index);
+        start_cluster--;
+    }
+    if (index < FAT_RESERVED_BYTES || end_of_chain(index))
+        return NULL;
+    /* The image is resident in memory, so the file data can be handed out in place one cluster at a time */
+    if (*size > cluster_size - start_offset)
+        *size = cluster_size - start_offset;
+    if (*size > inode->file_size - offset)
+        *size = inode->file_size - offset;
+
+    return volume.dev->base + volume.base + get_cluster_offset(index) + start_offset;
+}
+
+static struct Inode* fat_lookup(char* path, bool create)
+{
+    struct DirEntry dir_entry;
+    struct FsIndexEntry* index_entry = NULL;
+    uint32_t dir_entry_index;
+
+    /* The FAT image is mounted read-only hence files can't be created on it */
+    if (create)
+        return NULL;
+    /* If the image carries a lookup index it lists every file, no need to scan the directory */
+    if (index_header.slot_count != 0){
+        index_entry = search_index(path);
+        if (index_entry == NULL)
+            return NULL;
+        dir_entry_index = index_entry->dir_index;
+    }
+    else{
+        dir_entry_index = search_file(path, &dir_entry);
+        if (DIR_ENTRY_INVALID == dir_entry_index)
+            return NULL;
+    }
+    /* A FAT32 root directory can outgrow the in core inode table which is indexed by directory entry */
+    if (dir_entry_index >= PAGE_SIZE / sizeof(struct Inode))
+        return NULL;
+
+    /* Cache the file metadata to an in core inode if it is free (ref_count == 0) */
+    spin_lock(&table_lock);
+    if (inode_table[dir_entry_index].ref_count == 0){
+        /* Currently we work with a paradigm where the root dir index is used as the in core inode table index */
+        inode_table[dir_entry_index].dir_index = dir_entry_index;
+        inode_table[dir_entry_index].fs = &fat_fs;
+        if (index_entry != NULL){
+            inode_table[dir_entry_index].file_size = index_entry->file_size;
+            inode_table[dir_entry_index].cluster_index = index_entry->cluster_index;
+            inode_table[dir_entry_index].contiguous = true;
+            memcpy(inode_table[dir_entry_index].name, index_entry->name, MAX_FILENAME_BYTES);
+            memcpy(inode_table[dir_entry_index].ext, index_entry->ext, MAX_EXTNAME_BYTES);
+        }
+        else{
+            inode_table[dir_entry_index].file_size = dir_entry.file_size;
+            inode_table[dir_entry_index].cluster_index = get_dir_entry_cluster(&dir_entry);
+            inode_table[dir_entry_index].contiguous = false;
+            memcpy(inode_table[dir_entry_index].name, dir_entry.name, MAX_FILENAME_BYTES);
+            memcpy(inode_table[dir_entry_index].ext, dir_entry.ext, MAX_EXTNAME_BYTES);
+        }
+    }
+
+    /* Increment the reference count of the in core inode */
+    inode_table[dir_entry_index].ref_count++;
+    spin_unlock(&table_lock);
+
+    return inode_table + dir_entry_index;
+}
+
+static struct FileSystem fat_fs = {
+    .mount_point = "/",
+    .lookup = fat_lookup,
+    .read = fat_read,
+    .write = NULL,
+    .map = fat_map,
+    .list = fat_list,
+    .close = NULL,
+    .release = NULL,
+    .remove = NULL,
+    .stream = false
+};
+
+bool mount_fs(struct FileSystem* fs)
+{
+    for (int i = 0; i < MAX_MOUNTS; i++)
+    {
+        if (mount_table[i] == NULL){
+            mount_table[i] = fs;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Find the filesystem mounted on the longest matching prefix of the path and return the path relative to its mount point */
+static struct FileSystem* resolve_path(char* pathname, char** rel_path)
+{
+    struct FileSystem* fs = NULL;
+    int match_len = 0, len, i;
+
+    /* There's no notion of a working directory yet, hence relative paths are always looked up in the root filesystem */
+    if (*pathname != '/'){
+        *rel_path = pathname;
+        return mount_table[0];
+    }
+
+    for (int mount = 0; mount < MAX_MOUNTS; mount++)
+    {
+        if (mount_table[mount] == NULL)
+            continue;
+        len = strlen(mount_table[mount]->mount_point);
+        if (len <= match_len)
+            continue;
+        /* Mount points are matched case insensitively in line with the 8.3 filename convention */
+        for (i = 0; i < len; i++)
+        {
+            char ch = pathname[i];
+            to_upper_bytes(&ch, 1);
+            if (ch != mount_table[mount]->mount_point[i])
+                break;
+        }
+        if (i == len){
+            fs = mount_table[mount];
+            match_len = len;
+        }
+    }
+    *rel_path = pathname + match_len;
+
+    return fs;
+}
+
+static struct FileEntry* get_file_entry(struct Process* process, int fd)
+{
+    if (fd < 0 || fd >= MAX_OPEN_FILES)
+        return NULL;
+    return process->fd_table[fd];
+}
+
 uint32_t read_file(struct Process* process, int fd, void *buf, uint32_t size)
 {
-    uint32_t offset = process->fd_table[fd]->offset;
-    uint32_t file_size = process->fd_table[fd]->inode->file_size;
+    struct FileEntry* file = get_file_entry(process, fd);
+    if (file == NULL || !(file->mode & FILE_READ) || file->inode->fs->read == NULL)
+        return UINT32_MAX;
+    /* Streams like pipes have neither a size nor a position, the filesystem decides how much to return */
+    if (file->inode->fs->stream)
+        return file->inode->fs->read(file->inode, buf, 0, size);
+
+    uint32_t offset = file->offset;
+    uint32_t file_size = file->inode->file_size;
 
     /* Modify requested size if the offset from current position exceeds total file size */
+    if (offset >= file_size)
+        return 0;
     if (offset + size > file_size)
         size = file_size - offset;
     
-    uint32_t read_size = read_raw_data(process->fd_table[fd]->inode->cluster_index, buf, offset, size);
+    uint32_t read_size = file->inode->fs->read(file->inode, buf, offset, size);
     /* Update the file offset in global file table entry after previous read operation */
     if (read_size <= size)
-        process->fd_table[fd]->offset += read_size;
+        file->offset += read_size;
 
     return read_size;
 }
 
-int get_inode_entry(uint32_t dir_entry_index)
+uint32_t write_file(struct Process* process, int fd, void *buf, uint32_t size)
 {
-    struct DirEntry* dir_table;
-    /* Cache the file metadata to an in core inode if it is free (ref_count == 0) */
-    if (inode_table[dir_entry_index].ref_count == 0){
-        dir_table = get_root_dir_section();
-        /* Currently we work with a paradigm where the FAT16 root dir index is used as the in core inode table index */
-        inode_table[dir_entry_index].dir_index = dir_entry_index;
-        inode_table[dir_entry_index].file_size = dir_table[dir_entry_index].file_size;
-        inode_table[dir_entry_index].cluster_index = dir_table[dir_entry_index].cluster_index;
-        memcpy(inode_table[dir_entry_index].name, dir_table[dir_entry_index].name, MAX_FILENAME_BYTES);
-        memcpy(inode_table[dir_entry_index].ext, dir_table[dir_entry_index].ext, MAX_EXTNAME_BYTES);
+    struct FileEntry* file = get_file_entry(process, fd);
+    /* Filesystems which do not implement a write operation are read-only */
+    if (file == NULL || !(file->mode & FILE_WRITE) || file->inode->fs->write == NULL)
+        return UINT32_MAX;
+    if (file->inode->fs->stream)
+        return file->inode->fs->write(file->inode, buf, 0, size);
+
+    uint32_t write_size = file->inode->fs->write(file->inode, buf, file->offset, size);
+    /* Advance the file offset by the amount written so that subsequent writes append */
+    if (write_size <= size)
+        file->offset += write_size;
+
+    return write_size;
+}
+
+uint32_t write_out(struct Process* process, int fd, void* buf, uint32_t size)
+{
+    /* Standard output goes straight to the console unless it is redirected */
+    if (fd == STDOUT_FILENO && process->fd_table[STDOUT_FILENO] == NULL){
+        write_buffer(buf, size);
+        return size;
     }
+    return write_file(process, fd, buf, size);
+}
 
-    /* Increment the reference count of the in core inode */
-    inode_table[dir_entry_index].ref_count++;
+uint32_t read_vec(struct Process* process, int fd, struct IoVec* iov, int iovcnt)
+{
+    uint32_t total = 0, read_size;
+
+    if (iov == NULL || iovcnt <= 0 || iovcnt > IOV_MAX)
+        return UINT32_MAX;
+    /* Fill the segments in order and stop at the first short read i.e. end of file or a drained pipe */
+    for (int i = 0; i < iovcnt; i++)
+    {
+        read_size = read_file(process, fd, iov[i].base, iov[i].len);
+        if (read_size == UINT32_MAX)
+            return total > 0 ? total : UINT32_MAX;
+        total += read_size;
+        if (read_size < iov[i].len)
+            break;
+    }
+    /* Only restart an interrupted pipe read if nothing has been read yet */
+    if (total > 0)
+        process->event = NONE;
+
+    return total;
+}
+
+uint32_t write_vec(struct Process* process, int fd, struct IoVec* iov, int iovcnt)
+{
+    uint32_t total = 0, write_size;
+
+    if (iov == NULL || iovcnt <= 0 || iovcnt > IOV_MAX)
+        return UINT32_MAX;
+    for (int i = 0; i < iovcnt; i++)
+    {
+        /* Segment lengths are explicit hence data is written as is, null bytes included */
+        write_size = write_out(process, fd, iov[i].base, iov[i].len);
+        if (write_size == UINT32_MAX)
+            return total > 0 ? total : UINT32_MAX;
+        total += write_size;
+        if (write_size < iov[i].len)
+            break;
+    }
+    if (total > 0)
+        process->event = NONE;
 
-    return dir_entry_index;
+    return total;
+}
+
+uint32_t send_file(struct Process* process, int out_fd, int in_fd, uint32_t* offset, uint32_t count)
+{
+    struct FileEntry* file = get_file_entry(process, in_fd);
+    uint32_t sent = 0, chunk, written;
+    uint32_t pos;
+    void* data;
+
+    if (file == NULL || !(file->mode & FILE_READ))
+        return UINT32_MAX;
+    if (count > SENDFILE_MAX_BYTES)
+        count = SENDFILE_MAX_BYTES;
+
+    /* Streams and filesystems without resident data are copied through a small bounce buffer */
+    if (file->inode->fs->stream || file->inode->fs->map == NULL){
+        char buf[512];
+        while (sent < count)
+        {
+            chunk = count - sent > sizeof(buf) ? sizeof(buf) : count - sent;
+            chunk = read_file(process, in_fd, buf, chunk);
+            if (chunk == UINT32_MAX)
+                return sent > 0 ? sent : UINT32_MAX;
+            if (chunk == 0)
+                break;
+            written = write_out(process, out_fd, buf, chunk);
+            if (written == UINT32_MAX)
+                return sent > 0 ? sent : UINT32_MAX;
+            sent += written;
+            if (written < chunk)
+                break;
+        }
+        /* A pipe interrupted by a caught signal leaves the event set to restart the call. Not wanted once data has moved */
+        if (sent > 0)
+            process->event = NONE;
+        return sent;
+    }
+
+    /* Use the file offset unless the caller supplies its own, which is then updated instead */
+    pos = offset != NULL ? *offset : file->offset;
+    while (sent < count)
+    {
+        chunk = count - sent;
+        data = file->inode->fs->map(file->inode, pos, &chunk);
+        if (data == NULL)
+            break;
+        /* Data goes from the filesystem image to its destination without an intermediate copy */
+        written = write_out(process, out_fd, data, chunk);
+        if (written == UINT32_MAX){
+            if (sent == 0)
+                return UINT32_MAX;
+            break;
+        }
+        sent += written;
+        pos += written;
+        if (written < chunk)
+            break;
+    }
+    if (offset != NULL)
+        *offset = pos;
+    else
+        file->offset = pos;
+    if (sent > 0)
+        process->event = NONE;
+
+    return sent;
 }
 
 uint32_t get_file_size(struct Process* process, int fd)
 {
-    return process->fd_table[fd]->inode->file_size;
+    struct FileEntry* file = get_file_entry(process, fd);
+    return file != NULL ? file->inode->file_size : 0;
 }
 
-int open_file(struct Process* process, char* pathname)
+static void inode_put(struct Inode* inode)
+{
+    if (inode == NULL)
+        return;
+    
+    /* The system should halt if an iput is attempted when there are no open files */
+    ASSERT(inode->ref_count > 0);
+    spin_lock(&table_lock);
+    inode->ref_count--;
+    bool unused = inode->ref_count == 0;
+    spin_unlock(&table_lock);
+    /* Let the owning filesystem release its in core data once the inode isn't referring to any file */
+    if (unused && inode->fs->release != NULL)
+        inode->fs->release(inode);
+}
+
+int install_file(struct Process* process, struct Inode* inode, int mode)
 {
     int fd = -1;
     int file_table_index = -1;
-    uint32_t dir_entry_index, inode_table_index;
 
-    /* Find the first free entry in the user file descriptor table of the process */
-    for(int i = 0; i < MAX_OPEN_FILES; i++)
+    /* Find the first free entry in the user file descriptor table of the process
+       Descriptors for the standard streams are only ever assigned explicitly with dup2 */
+    for(int i = STDERR_FILENO+1; i < MAX_OPEN_FILES; i++)
     {
         if (process->fd_table[i] == NULL){
             fd = i;
@@ -271,6 +665,7 @@ int open_file(struct Process* process, char* pathname)
         return fd;
 
     /* Next find first free entry (entry not pointing to any inode) in the global file table */
+    spin_lock(&table_lock);
     for(int i = 0; i < PAGE_SIZE / sizeof(struct FileEntry); i++)
     {
         if (global_file_table[i].inode == NULL){
@@ -279,65 +674,239 @@ int open_file(struct Process* process, char* pathname)
         }
     }
     /* If no entry available in file table, the open operation fails */
-    if (file_table_index == -1)
-        return -1;
-
-    dir_entry_index = search_file(pathname);
-    if (DIR_ENTRY_INVALID == dir_entry_index)
+    if (file_table_index == -1){
+        spin_unlock(&table_lock);
         return -1;
+    }
 
-    inode_table_index = get_inode_entry(dir_entry_index);
     memset(global_file_table + file_table_index, 0, sizeof(struct FileEntry));
     /* An open call will always create a new file table entry. Hence we initialize the ref count to 1 */
     global_file_table[file_table_index].ref_count = 1;
+    global_file_table[file_table_index].mode = mode;
     /* Link the in core inode to the global file table entry */
-    global_file_table[file_table_index].inode = inode_table + inode_table_index;
+    global_file_table[file_table_index].inode = inode;
+    spin_unlock(&table_lock);
     /* Link the file table entry to the process file descriptor table */
     process->fd_table[fd] = global_file_table + file_table_index;
 
     return fd;
 }
 
-static void inode_put(struct Inode* inode)
+static int open_inode(struct Process* process, char* pathname, bool create)
 {
+    int fd;
+    char* rel_path;
+    struct FileSystem* fs;
+    struct Inode* inode;
+
+    /* Let the filesystem mounted on the path prefix resolve the rest of it to an in core inode */
+    fs = resolve_path(pathname, &rel_path);
+    if (fs == NULL || fs->lookup == NULL)
+        return -1;
+    inode = fs->lookup(rel_path, create);
     if (inode == NULL)
-        return;
-    
-    /* The system should halt if an iput is attempted when there are no open files */
-    ASSERT(inode->ref_count > 0);
-    inode->ref_count--;
-    /* Release the in core inode if it's not referring to any file */
-    if (inode->ref_count == 0)
-        inode = NULL;
+        return -1;
+
+    fd = install_file(process, inode, FILE_READ | FILE_WRITE);
+    /* Drop the reference taken by the lookup if the file couldn't be installed */
+    if (fd < 0)
+        inode_put(inode);
+
+    return fd;
+}
+
+int open_file(struct Process* process, char* pathname)
+{
+    return open_inode(process, pathname, false);
+}
+
+int create_file(struct Process* process, char* pathname)
+{
+    /* Creation truncates an existing file on filesystems which support it */
+    return open_inode(process, pathname, true);
+}
+
+int remove_file(char* pathname)
+{
+    char* rel_path;
+    struct FileSystem* fs = resolve_path(pathname, &rel_path);
+
+    if (fs == NULL || fs->remove == NULL)
+        return -1;
+    return fs->remove(rel_path);
 }
 
 void close_file(struct Process* process, int fd)
 {
-    if (fd < 0 || process->fd_table[fd] == NULL)
+    struct FileEntry* file = get_file_entry(process, fd);
+    if (file == NULL)
         return;
     
-    /* Algorithm iput => unlink the inode by decrementing reference count */
-    inode_put(process->fd_table[fd]->inode);
+    struct Inode* inode = file->inode;
 
     /* Unlink the file table entry by decrementing reference count */
-    process->fd_table[fd]->ref_count--;
+    spin_lock(&table_lock);
+    file->ref_count--;
+    bool last_ref = file->ref_count == 0;
+    spin_unlock(&table_lock);
     /* Free the file table entry if the ref count is zero. File table entry ref count may not always be zero
        There could be occasions like a fork system call causing file table entry to be shared by the parent with the child
        This is different from the inode reference count which keeps a count of all processes accessing a file */
-    if (process->fd_table[fd]->ref_count == 0)
-        process->fd_table[fd] = NULL;
+    if (last_ref){
+        /* Let the filesystem act on the last close of the file table entry e.g. hanging up a pipe end */
+        if (inode->fs->close != NULL)
+            inode->fs->close(file);
+        file->inode = NULL;
+    }
+    /* Algorithm iput => unlink the inode by decrementing reference count */
+    inode_put(inode);
+    process->fd_table[fd] = NULL;
 }
 
-int read_root_dir_table(char* buf)
+/* Take another reference to an open file and its inode for a new descriptor pointing to it. The counts are dropped under the same lock on close */
+void file_get(struct FileEntry* file)
+{
+    spin_lock(&table_lock);
+    file->ref_count++;
+    file->inode->ref_count++;
+    spin_unlock(&table_lock);
+}
+
+int dup_file(struct Process* process, int oldfd, int newfd)
+{
+    struct FileEntry* file = get_file_entry(process, oldfd);
+
+    if (file == NULL || newfd < 0 || newfd >= MAX_OPEN_FILES)
+        return -1;
+    if (oldfd == newfd)
+        return newfd;
+
+    /* The new descriptor shares the file table entry, hence file offset and mode, with the old one like after a fork */
+    close_file(process, newfd);
+    file_get(file);
+    process->fd_table[newfd] = file;
+
+    return newfd;
+}
+
+void close_all_files(struct Process* process)
 {
-    struct DirEntry* dir_table = get_root_dir_section();
-    uint32_t count = get_root_dir_count();
+    for (int fd = 0; fd < MAX_OPEN_FILES; fd++)
+    {
+        close_file(process, fd);
+    }
+}
 
-    memcpy(buf, dir_table, count * sizeof(struct DirEntry));
+static int fat_list(struct DirEntry* entries, int max)
+{
+    struct DirCursor cursor = {0, 0};
+    int count = 0;
+
+    /* Copy entries up to the end of the directory or as many as a listing buffer can hold */
+    while (count < max && next_root_dir_entry(&cursor, entries + count))
+    {
+        if (entries[count++].name[0] == ENTRY_AVAILABLE)
+            break;
+    }
 
     return count;
 }
 
+int read_root_dir_table(char* buf)
+{
+    /* The filesystem mounted at the root is the first one in the mount table */
+    if (mount_table[0] == NULL || mount_table[0]->list == NULL)
+        return 0;
+
+    return mount_table[0]->list((struct DirEntry*)buf, ROOT_DIR_LIST_MAX);
+}
+
+static bool init_volume(struct BlockDevice* dev)
+{
+    struct BPB* bpb = &volume.bpb;
+    uint8_t sector[BYTES_PER_SECTOR];
+    uint32_t lba, total_sectors, fat_sectors, root_sectors, data_sectors;
+    uint16_t sign;
+
+    memset(&volume, 0, sizeof(volume));
+    volume.dev = dev;
+    /* Locate the FAT partition from the LBA in the first partition entry of the master boot record */
+    if (!block_read(dev, PARTITION_ENTRY_OFFSET + LBA_OFFSET, &lba, sizeof(lba)))
+        return false;
+    volume.base = (uint64_t)lba * BYTES_PER_SECTOR;
+    if (!read_volume(0, sector, BYTES_PER_SECTOR))
+        return false;
+    /* Get the value of the last 2 bytes of the BIOS parameter block sector */
+    sign = (sector[BYTES_PER_SECTOR-1] << 8) | sector[BYTES_PER_SECTOR-2];
+    if (BPB_SECTOR_SIGNATURE != sign) {
+        printk("Invalid FAT signature\n");
+        return false;
+    }
+    memcpy(bpb, sector, sizeof(struct BPB));
+
+    volume.cluster_size = (uint32_t)bpb->bytes_per_sector * bpb->sectors_per_cluster;
+    if (volume.cluster_size == 0)
+        return false;
+    /* A zero 16-bit count means the 32-bit field holds the value. This is always the case on FAT32 */
+    total_sectors = bpb->sector_count ? bpb->sector_count : bpb->large_sector_count;
+    fat_sectors = bpb->sectors_per_fat ? bpb->sectors_per_fat : bpb->ext.fat32.sectors_per_fat;
+    root_sectors = UPPER_BOUND((uint32_t)bpb->root_entry_count * sizeof(struct DirEntry), bpb->bytes_per_sector) / bpb->bytes_per_sector;
+
+    volume.fat_offset = (uint32_t)bpb->reserved_sector_count * bpb->bytes_per_sector;
+    volume.root_offset = volume.fat_offset + (uint32_t)bpb->fat_count * fat_sectors * bpb->bytes_per_sector;
+    volume.data_offset = volume.root_offset + root_sectors * bpb->bytes_per_sector;
+    data_sectors = total_sectors - (volume.data_offset / bpb->bytes_per_sector);
+    volume.cluster_count = data_sectors / bpb->sectors_per_cluster;
+    volume.free_clusters = FSINFO_FREE_UNKNOWN;
+
+    /* The FAT type is determined by the count of clusters alone, as per the specification */
+    if (volume.cluster_count < FAT16_MIN_CLUSTERS){
+        printk("FAT12 volumes are not supported\n");
+        return false;
+    }
+    if (volume.cluster_count < FAT32_MIN_CLUSTERS){
+        volume.type = FAT_TYPE_16;
+        volume.root_entry_count = bpb->root_entry_count;
+        volume.end_of_chain = FAT16_END_OF_CHAIN;
+    }
+    else{
+        volume.type = FAT_TYPE_32;
+        volume.root_cluster = bpb->ext.fat32.root_cluster;
+        volume.end_of_chain = FAT32_END_OF_CHAIN;
+        /* Pick up the free cluster hint if the FSInfo sector is valid */
+        struct FSInfo* fs_info = (struct FSInfo*)sector;
+        if (bpb->ext.fat32.fs_info_sector != 0 &&
+            read_volume((uint64_t)bpb->ext.fat32.fs_info_sector * bpb->bytes_per_sector, sector, BYTES_PER_SECTOR) &&
+            fs_info->lead_signature == FSINFO_LEAD_SIGNATURE && fs_info->struct_signature == FSINFO_STRUCT_SIGNATURE &&
+            fs_info->free_count <= volume.cluster_count)
+            volume.free_clusters = fs_info->free_count;
+    }
+
+    return true;
+}
+
+/* Load the lookup index written by the host image packer if the disk carries one built for this partition */
+static void load_index(void)
+{
+    uint8_t sector[BYTES_PER_SECTOR];
+    uint32_t size;
+
+    index_header.slot_count = 0;
+    if (!block_read(volume.dev, FS_INDEX_LBA * BYTES_PER_SECTOR, sector, BYTES_PER_SECTOR))
+        return;
+    memcpy(&index_header, sector, sizeof(index_header));
+    size = index_header.slot_count * sizeof(struct FsIndexEntry);
+    if (index_header.magic != FS_INDEX_MAGIC || index_header.slot_count == 0 || index_header.slot_count > FS_INDEX_MAX_SLOTS ||
+        (index_header.slot_count & (index_header.slot_count - 1)) != 0 ||
+        (uint64_t)index_header.partition_lba * BYTES_PER_SECTOR != volume.base ||
+        FS_INDEX_LBA + 1 + size / BYTES_PER_SECTOR > index_header.partition_lba ||
+        !block_read(volume.dev, (FS_INDEX_LBA + 1) * BYTES_PER_SECTOR, index_table, size)){
+        index_header.slot_count = 0;
+        return;
+    }
+    printk("Filesystem index: %u files\n", index_header.entry_count);
+}
+
 bool init_inode_table(void)
 {
     inode_table = (struct Inode*)kalloc();
@@ -362,18 +931,31 @@ bool init_file_table(void)
 
 void init_fs(void)
 {
-    /* Get the BIOS parameter block location in the FAT16 partition derived from LBA in partition entry */
-    uint8_t *bpb = (uint8_t*)get_fs_bpb();
-    /* Get the value of the last 2 bytes of the BIOS parameter block sector */
-    uint16_t sign = (bpb[BYTES_PER_SECTOR-1] << 8) | bpb[BYTES_PER_SECTOR-2];
-    
-    if (BPB_SECTOR_SIGNATURE != sign) {
-        printk("Invalid FAT16 signature\n");
-        ASSERT(0);
-    }
-
     /* Setup in-core inode table and global file table */
     ASSERT(init_inode_table());
     ASSERT(init_file_table());
-}
 
+#ifdef ROOTFS_CPIO
+    /* The root filesystem is the archive linked into the kernel image, there is no disk to read */
+    init_cpio();
+#else
+    /* Get the disk holding the root filesystem, either preloaded in memory or read on demand from the SD card */
+    struct BlockDevice* dev = init_block_device();
+    ASSERT(dev != NULL);
+
+    /* Detect FAT16 or FAT32 from the parameter block and work out the volume layout */
+    ASSERT(init_volume(dev));
+    if (volume.type == FAT_TYPE_32 && volume.free_clusters != FSINFO_FREE_UNKNOWN)
+        printk("FAT32 volume: %u of %u clusters free\n", volume.free_clusters, volume.cluster_count);
+    load_index();
+    /* File data can only be handed out in place if the disk is resident in memory */
+    if (dev->base == NULL)
+        fat_fs.map = NULL;
+
+    /* The FAT partition is mounted as the root filesystem */
+    ASSERT(mount_fs(&fat_fs));
+#endif
+    init_tmpfs();
+    init_procfs();
+    init_pipes();
+}
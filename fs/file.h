@@ -20,6 +20,7 @@
 #define _FILE_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 struct BPB {
     uint8_t jump[3];
@@ -36,12 +37,43 @@ struct BPB {
     uint16_t head_count;
     uint32_t hidden_sector_count;
     uint32_t large_sector_count;
-    uint8_t drive_number;
-    uint8_t flags;
-    uint8_t signature;
-    uint32_t volume_id;
-    uint8_t volume_label[11];
-    uint8_t file_system[8];
+    /* The extended parameter block differs between FAT16 and FAT32 */
+    union {
+        struct {
+            uint8_t drive_number;
+            uint8_t flags;
+            uint8_t signature;
+            uint32_t volume_id;
+            uint8_t volume_label[11];
+            uint8_t file_system[8];
+        } __attribute__((packed)) fat16;
+        struct {
+            uint32_t sectors_per_fat;
+            uint16_t ext_flags;
+            uint16_t version;
+            uint32_t root_cluster;
+            uint16_t fs_info_sector;
+            uint16_t backup_boot_sector;
+            uint8_t reserved[12];
+            uint8_t drive_number;
+            uint8_t flags;
+            uint8_t signature;
+            uint32_t volume_id;
+            uint8_t volume_label[11];
+            uint8_t file_system[8];
+        } __attribute__((packed)) fat32;
+    } ext;
+} __attribute__((packed));
+
+/* FAT32 filesystem information sector. Free cluster count is only a hint and may be stale */
+struct FSInfo {
+    uint32_t lead_signature;
+    uint8_t reserved[480];
+    uint32_t struct_signature;
+    uint32_t free_count;
+    uint32_t next_free;
+    uint8_t reserved2[12];
+    uint32_t trail_signature;
 } __attribute__((packed));
 
 struct DirEntry {
@@ -53,13 +85,56 @@ struct DirEntry {
     uint16_t create_time;
     uint16_t create_date;
     uint16_t access_date;
-    uint16_t attr_index;
+    uint16_t cluster_index_hi; /* Upper 16 bits of the first cluster on FAT32 */
     uint16_t m_time;
     uint16_t m_date;
     uint16_t cluster_index;
     uint32_t file_size;
 } __attribute__((packed));
 
+/* Header of the file index written by the host image packer in the sectors between the MBR and the partition
+   The header sector is followed by an open addressed hash table of slot_count entries keyed by the 8.3 name */
+struct FsIndexHeader
+{
+    uint32_t magic;
+    uint32_t slot_count; /* Power of 2 */
+    uint32_t entry_count;
+    uint32_t partition_lba; /* Start of the partition the index was built for */
+};
+
+struct FsIndexEntry
+{
+    uint32_t hash;
+    uint32_t dir_index; /* Index of the file in the root directory */
+    uint32_t cluster_index; /* First of the consecutive clusters holding the file */
+    uint32_t file_size;
+    char name[8];
+    char ext[3];
+    uint8_t flags;
+    uint32_t reserved;
+};
+
+struct BlockDevice;
+
+/* Layout of the mounted FAT volume worked out from the BIOS parameter block once at init */
+struct FatVolume {
+    struct BlockDevice* dev; /* Disk holding the volume */
+    uint64_t base; /* Byte offset of the partition on the disk */
+    struct BPB bpb;
+    int type; /* FAT_TYPE_16 or FAT_TYPE_32 */
+    uint32_t cluster_size;
+    uint64_t fat_offset; /* Byte offsets from the start of the partition */
+    uint64_t root_offset;
+    uint64_t data_offset;
+    uint32_t root_entry_count; /* Fixed root directory region on FAT16 */
+    uint32_t root_cluster; /* First cluster of the chained root directory on FAT32 */
+    uint32_t cluster_count;
+    uint32_t end_of_chain; /* Entries at or above this mark the last cluster of a chain */
+    uint32_t free_clusters; /* FSInfo hint, UINT32_MAX if unknown */
+};
+
+struct FileSystem;
+
 struct Inode
 {
     char name[8];
@@ -67,7 +142,10 @@ struct Inode
     uint32_t cluster_index;
     uint32_t dir_index;
     uint32_t file_size;
+    bool contiguous; /* File data occupies consecutive clusters and can be located without walking the FAT */
     int ref_count;
+    struct FileSystem* fs; /* Mounted filesystem which owns this inode */
+    void* data; /* Filesystem specific in core data */
 };
 
 struct FileEntry
@@ -75,6 +153,34 @@ struct FileEntry
     struct Inode* inode;
     uint32_t offset;
     int ref_count;
+    int mode; /* Access mode (FILE_READ, FILE_WRITE) of this open file */
+};
+
+/* Segment of a scatter-gather transfer. Layout matches struct iovec in the user library */
+struct IoVec
+{
+    void* base;
+    uint64_t len;
+};
+
+/* Operations every mounted filesystem exposes to the VFS layer. Unsupported operations are left NULL */
+struct FileSystem
+{
+    const char* mount_point;
+    /* Return the in core inode for a path relative to the mount point with its ref count incremented, NULL if not found */
+    struct Inode* (*lookup)(char* path, bool create);
+    uint32_t (*read)(struct Inode* inode, void* buf, uint32_t offset, uint32_t size);
+    uint32_t (*write)(struct Inode* inode, void* buf, uint32_t offset, uint32_t size);
+    /* Return a pointer to file data at offset in memory backed filesystems. Size is clamped to the contiguous bytes from there */
+    void* (*map)(struct Inode* inode, uint32_t offset, uint32_t* size);
+    /* Fill in directory entries for the files at the top of the filesystem. Returns the count filled in */
+    int (*list)(struct DirEntry* entries, int max);
+    /* Invoked when the last reference to a file table entry is dropped */
+    void (*close)(struct FileEntry* file);
+    /* Invoked when the last reference to an in core inode is dropped */
+    void (*release)(struct Inode* inode);
+    int (*remove)(char* path);
+    bool stream; /* Files have no size or offset. Reads and writes are passed through as is */
 };
 
 #define UPPER_BOUND(x,a)    (((x)+(a-1)) & ~(a-1))
@@ -83,6 +189,7 @@ struct FileEntry
 #define BYTES_PER_SECTOR 512
 #define PARTITION_ENTRY_OFFSET 0x1be
 #define LBA_OFFSET 8
+#define DIR_ENTRY_END UINT32_MAX /* Cursor value past the last root directory entry */
 #define BPB_SECTOR_SIGNATURE 0xAA55
 
 #define ENTRY_AVAILABLE 0
@@ -90,22 +197,64 @@ struct FileEntry
 #define ATTR_VOLUME_LABEL 0x08
 #define ATTR_FILETYPE_DIRECTORY 0x10
 #define ATTR_LONG_FILENAME 0x0f
+#define ATTR_FILETYPE_FILE 0x20
 
 #define MAX_FILENAME_BYTES 8
 #define MAX_EXTNAME_BYTES 3
 #define INVALID_FILETYPE 15
 #define DIR_ENTRY_INVALID UINT32_MAX
 #define FAT_RESERVED_BYTES 2
-#define END_OF_DATA 0xffff
+#define FAT_TYPE_16 16
+#define FAT_TYPE_32 32
+#define FAT16_MIN_CLUSTERS 4085
+#define FAT32_MIN_CLUSTERS 65525
+#define FAT16_END_OF_CHAIN 0xfff8
+#define FAT32_END_OF_CHAIN 0x0ffffff8
+#define FAT32_ENTRY_MASK 0x0fffffff
+#define FSINFO_LEAD_SIGNATURE 0x41615252
+#define FSINFO_STRUCT_SIGNATURE 0x61417272
+#define FSINFO_FREE_UNKNOWN 0xffffffff
+#define FS_INDEX_MAGIC 0x58494246 /* "FBIX" */
+#define FS_INDEX_LBA 1
+#define FS_INDEX_MAX_SLOTS 512
+#define FS_INDEX_USED 1
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+#define ROOT_DIR_LIST_MAX 1024 /* Entries returned to userspace in a root directory listing */
 #define CHAR_SPACE_ASCII 32
+#define MAX_MOUNTS 4
+#define SENDFILE_MAX_BYTES (64*1024) /* Bytes moved per sendfile call to bound the time spent in the kernel */
+#define IOV_MAX 16
+#define FILE_READ 1
+#define FILE_WRITE 2
+
+#define STDIN_FILENO 0
+#define STDOUT_FILENO 1
+#define STDERR_FILENO 2
+#define MAX_PATH_BYTES 64
 
 struct Process;
 
 void init_fs(void);
+bool mount_fs(struct FileSystem* fs);
+bool split_path(char *path, char *name, char *ext);
+void to_upper_bytes(char* str, int size);
+uint32_t name_hash(char* name, char* ext);
 int open_file(struct Process* process, char* pathname);
+int create_file(struct Process* process, char* pathname);
+int install_file(struct Process* process, struct Inode* inode, int mode);
+void file_get(struct FileEntry* file);
+int dup_file(struct Process* process, int oldfd, int newfd);
 void close_file(struct Process* process, int fd);
+void close_all_files(struct Process* process);
 uint32_t get_file_size(struct Process* process, int fd);
 uint32_t read_file(struct Process* process, int fd, void *buf, uint32_t size);
+uint32_t write_file(struct Process* process, int fd, void *buf, uint32_t size);
+uint32_t write_out(struct Process* process, int fd, void* buf, uint32_t size);
+uint32_t read_vec(struct Process* process, int fd, struct IoVec* iov, int iovcnt);
+uint32_t write_vec(struct Process* process, int fd, struct IoVec* iov, int iovcnt);
+uint32_t send_file(struct Process* process, int out_fd, int in_fd, uint32_t* offset, uint32_t count);
+int remove_file(char* pathname);
 int read_root_dir_table(char* buf);
 
 #endif
\ No newline at end of file
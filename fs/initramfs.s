@@ -0,0 +1,30 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// The newc cpio archive holding the root filesystem is linked into the kernel image read-only
+// INITRAMFS is set by the Makefile to the path of the archive built from the userspace apps
+
+.global initramfs_start
+.global initramfs_end
+
+.section .rodata
+.balign 16
+initramfs_start:
+    .incbin INITRAMFS
+initramfs_end:
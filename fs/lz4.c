@@ -0,0 +1,82 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "lz4.h"
+#include <stdbool.h>
+
+/* Read the extra bytes of a length that overflowed its 4-bit token field. Each byte of 255 continues the length */
+static bool read_length(const uint8_t** ip, const uint8_t* end, uint32_t* length)
+{
+    uint8_t byte;
+
+    do {
+        if (*ip >= end)
+            return false;
+        byte = *(*ip)++;
+        *length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+/* Decompress an LZ4 block. Every sequence is a token followed by literals and a match copied from the output already produced
+   Returns the number of bytes written to dst or UINT32_MAX if the block is malformed or does not fit */
+uint32_t lz4_decompress(const uint8_t* src, uint32_t src_size, uint8_t* dst, uint32_t dst_size)
+{
+    const uint8_t* ip = src;
+    const uint8_t* ip_end = src + src_size;
+    uint8_t* op = dst;
+    uint8_t* op_end = dst + dst_size;
+    uint32_t length, offset;
+    uint8_t token;
+
+    while (ip < ip_end)
+    {
+        token = *ip++;
+        /* Literals */
+        length = token >> 4;
+        if (length == 15 && !read_length(&ip, ip_end, &length))
+            return UINT32_MAX;
+        if (length > (uint32_t)(ip_end - ip) || length > (uint32_t)(op_end - op))
+            return UINT32_MAX;
+        for (uint32_t i = 0; i < length; i++)
+            *op++ = *ip++;
+        /* The last sequence carries literals only */
+        if (ip == ip_end)
+            break;
+
+        /* Match offset is 16-bit little endian and points back into the output */
+        if (ip_end - ip < 2)
+            return UINT32_MAX;
+        offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (uint32_t)(op - dst))
+            return UINT32_MAX;
+        length = token & 0xf;
+        if (length == 15 && !read_length(&ip, ip_end, &length))
+            return UINT32_MAX;
+        length += LZ4_MIN_MATCH;
+        if (length > (uint32_t)(op_end - op))
+            return UINT32_MAX;
+        /* Copy byte by byte since the source may overlap the destination to repeat a short pattern */
+        for (uint32_t i = 0; i < length; i++, op++)
+            *op = *(op - offset);
+    }
+
+    return op - dst;
+}
@@ -0,0 +1,183 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "pipe.h"
+#include <kernel.h>
+#include <lib/lib.h>
+#include <process/process.h>
+
+static struct Pipe pipes[MAX_PIPES];
+static struct FileSystem pipefs;
+
+static uint32_t pipe_read(struct Inode* inode, void* buf, uint32_t offset, uint32_t size)
+{
+    struct Pipe* pipe = container_of(inode, struct Pipe, inode);
+    int index = pipe - pipes;
+    struct Process* process = get_curr_process();
+    uint32_t read_size = 0, copy_size;
+
+    /* Block until there is something to read. No data and no writers left means end of file */
+    while (pipe->count == 0)
+    {
+        if (pipe->writers == 0)
+            return 0;
+        sleep_on(&pipe->read_wait, PIPE_READ_EVENT(index));
+        /* The event is retained if a caught signal woke the process. Bail out and let the syscall be restarted */
+        if (process->event != NONE)
+            return 0;
+    }
+
+    /* Return whatever is available instead of waiting for the full size like a regular file read would */
+    while (read_size < size && pipe->count > 0)
+    {
+        copy_size = PIPE_BUF_SIZE - pipe->read_pos;
+        if (copy_size > pipe->count)
+            copy_size = pipe->count;
+        if (copy_size > size - read_size)
+            copy_size = size - read_size;
+        memcpy((char*)buf + read_size, pipe->buf + pipe->read_pos, copy_size);
+        pipe->read_pos = (pipe->read_pos + copy_size) % PIPE_BUF_SIZE;
+        pipe->count -= copy_size;
+        read_size += copy_size;
+    }
+    /* Space was freed up in the buffer for blocked writers */
+    wake_up_queue(&pipe->write_wait);
+
+    return read_size;
+}
+
+static uint32_t pipe_write(struct Inode* inode, void* buf, uint32_t offset, uint32_t size)
+{
+    struct Pipe* pipe = container_of(inode, struct Pipe, inode);
+    int index = pipe - pipes;
+    struct Process* process = get_curr_process();
+    uint32_t write_size = 0, copy_size;
+
+    while (write_size < size)
+    {
+        /* Writing to a pipe nobody can read from is an error */
+        if (pipe->readers == 0)
+            return write_size > 0 ? write_size : UINT32_MAX;
+        if (pipe->count == PIPE_BUF_SIZE){
+            /* Let readers drain the full buffer before writing the rest */
+            wake_up_queue(&pipe->read_wait);
+            sleep_on(&pipe->write_wait, PIPE_WRITE_EVENT(index));
+            if (process->event != NONE){
+                /* Restart the syscall on a caught signal only if nothing has been written yet, else report the partial write */
+                if (write_size > 0)
+                    process->event = NONE;
+                return write_size;
+            }
+            continue;
+        }
+        copy_size = PIPE_BUF_SIZE - pipe->write_pos;
+        if (copy_size > PIPE_BUF_SIZE - pipe->count)
+            copy_size = PIPE_BUF_SIZE - pipe->count;
+        if (copy_size > size - write_size)
+            copy_size = size - write_size;
+        memcpy(pipe->buf + pipe->write_pos, (char*)buf + write_size, copy_size);
+        pipe->write_pos = (pipe->write_pos + copy_size) % PIPE_BUF_SIZE;
+        pipe->count += copy_size;
+        write_size += copy_size;
+    }
+    wake_up_queue(&pipe->read_wait);
+
+    return write_size;
+}
+
+static void pipe_close(struct FileEntry* file)
+{
+    struct Pipe* pipe = container_of(file->inode, struct Pipe, inode);
+
+    /* Hang up an end of the pipe and unblock the other side so that it sees end of file or a broken pipe */
+    if (file->mode & FILE_READ){
+        pipe->readers--;
+        wake_up_queue(&pipe->write_wait);
+    }
+    if (file->mode & FILE_WRITE){
+        pipe->writers--;
+        wake_up_queue(&pipe->read_wait);
+    }
+}
+
+static void pipe_release(struct Inode* inode)
+{
+    struct Pipe* pipe = container_of(inode, struct Pipe, inode);
+    pipe->used = false;
+}
+
+int create_pipe(struct Process* process, int* fds)
+{
+    struct Pipe* pipe = NULL;
+    int read_fd, write_fd;
+
+    for (int i = 0; i < MAX_PIPES; i++)
+    {
+        if (!pipes[i].used){
+            pipe = pipes + i;
+            break;
+        }
+    }
+    if (pipe == NULL)
+        return -1;
+
+    memset(pipe, 0, sizeof(struct Pipe));
+    pipe->used = true;
+    pipe->inode.fs = &pipefs;
+    pipe->inode.dir_index = DIR_ENTRY_INVALID;
+    /* Each end holds its own reference to the shared inode */
+    pipe->inode.ref_count = 2;
+
+    read_fd = install_file(process, &pipe->inode, FILE_READ);
+    if (read_fd < 0){
+        pipe->used = false;
+        return -1;
+    }
+    pipe->readers = 1;
+    write_fd = install_file(process, &pipe->inode, FILE_WRITE);
+    if (write_fd < 0){
+        /* Closing the read end drops its inode reference, the one meant for the write end is dropped here */
+        pipe->inode.ref_count--;
+        close_file(process, read_fd);
+        return -1;
+    }
+    pipe->writers = 1;
+
+    fds[0] = read_fd;
+    fds[1] = write_fd;
+
+    return 0;
+}
+
+static struct FileSystem pipefs = {
+    .mount_point = NULL,
+    .lookup = NULL,
+    .read = pipe_read,
+    .write = pipe_write,
+    .map = NULL,
+    .list = NULL,
+    .close = pipe_close,
+    .release = pipe_release,
+    .remove = NULL,
+    .stream = true
+};
+
+void init_pipes(void)
+{
+    memset(pipes, 0, sizeof(pipes));
+}
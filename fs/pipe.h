@@ -0,0 +1,51 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PIPE_H
+#define _PIPE_H
+
+#include "file.h"
+#include <process/process.h>
+
+#define MAX_PIPES 32
+#define PIPE_BUF_SIZE 4096
+
+/* Sleep events for processes blocked on a pipe. They count down from the last scheduler event to stay clear of PIDs
+   The process is queued on the wait queue of the pipe end and the event only records that it is blocked on a pipe */
+#define PIPE_READ_EVENT(i)  (NONE - 1 - 2*(i))
+#define PIPE_WRITE_EVENT(i) (NONE - 2 - 2*(i))
+
+/* An anonymous pipe. Both ends share the inode and data flows through a ring buffer */
+struct Pipe
+{
+    struct Inode inode;
+    bool used;
+    char buf[PIPE_BUF_SIZE];
+    uint32_t read_pos;
+    uint32_t write_pos;
+    uint32_t count; /* Bytes currently buffered */
+    int readers; /* Open file table entries referring to the read end */
+    int writers; /* Open file table entries referring to the write end */
+    struct WaitQueue read_wait; /* Readers blocked on an empty buffer */
+    struct WaitQueue write_wait; /* Writers blocked on a full buffer */
+};
+
+int create_pipe(struct Process* process, int* fds);
+void init_pipes(void);
+
+#endif
@@ -0,0 +1,300 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "procfs.h"
+#include <kernel.h>
+#include <memory/memory.h>
+#include <process/process.h>
+#include <irq/handler.h>
+#include <lib/lib.h>
+#include <io/print.h>
+#include <debug/debug.h>
+
+static struct ProcNode proc_nodes[PROCFS_MAX_NODES];
+static struct FileSystem procfs;
+
+static void put_char(struct ProcBuf* out, char ch)
+{
+    /* Output beyond the buffer is dropped. A truncated snapshot is still consistent */
+    if (out->len < out->size)
+        out->buf[out->len++] = ch;
+}
+
+static void put_str(struct ProcBuf* out, const char* str)
+{
+    while (*str)
+        put_char(out, *str++);
+}
+
+static void put_uint(struct ProcBuf* out, uint64_t value)
+{
+    char digits[20];
+    int count = 0;
+
+    do
+    {
+        digits[count++] = value % 10 + BASE_NUMERIC_ASCII;
+        value /= 10;
+    } while (value != 0);
+    while (count)
+        put_char(out, digits[--count]);
+}
+
+static void put_int(struct ProcBuf* out, int value)
+{
+    if (value < 0){
+        put_char(out, '-');
+        put_uint(out, -(int64_t)value);
+    }
+    else
+        put_uint(out, value);
+}
+
+static char state_rep(int state)
+{
+    switch (state)
+    {
+    case INIT:
+        return 'i';
+    case RUNNING:
+        return 'R';
+    case READY:
+        return 'r';
+    case SLEEP:
+        return 's';
+    case STOPPED:
+        return 'T';
+    case KILLED:
+        return 'z';
+    default:
+        return '?';
+    }
+}
+
+static void gen_stat(struct ProcBuf* out)
+{
+    int pid_list[PROC_TABLE_SIZE];
+    int count = get_active_pids(NULL, pid_list, 1);
+    int running = 0, blocked = 0, stopped = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        struct Process* process = get_process(pid_list[i]);
+        if (process->state == RUNNING || process->state == READY)
+            running++;
+        else if (process->state == SLEEP)
+            blocked++;
+        else if (process->state == STOPPED)
+            stopped++;
+    }
+    put_str(out, "ticks ");
+    put_uint(out, get_ticks());
+    put_str(out, "\nprocesses ");
+    put_int(out, count);
+    put_str(out, "\nprocs_running ");
+    put_int(out, running);
+    put_str(out, "\nprocs_blocked ");
+    put_int(out, blocked);
+    put_str(out, "\nprocs_stopped ");
+    put_int(out, stopped);
+    put_char(out, '\n');
+}
+
+static void gen_meminfo(struct ProcBuf* out)
+{
+    put_str(out, "MemTotal: ");
+    put_uint(out, get_total_pages() * (PAGE_SIZE / 1024));
+    put_str(out, " kB\nMemFree: ");
+    put_uint(out, get_free_pages() * (PAGE_SIZE / 1024));
+    put_str(out, " kB\nPageSize: ");
+    put_uint(out, PAGE_SIZE / 1024);
+    put_str(out, " kB\n");
+}
+
+/* Load averages over 1, 5 and 15 minutes with two decimals */
+static void gen_loadavg(struct ProcBuf* out)
+{
+    uint64_t loads[3];
+
+    get_load_avg(loads);
+    for (int i = 0; i < 3; i++)
+    {
+        put_uint(out, loads[i] / 100);
+        put_char(out, '.');
+        put_char(out, loads[i] / 10 % 10 + BASE_NUMERIC_ASCII);
+        put_char(out, loads[i] % 10 + BASE_NUMERIC_ASCII);
+        put_char(out, i < 2 ? ' ' : '\n');
+    }
+}
+
+/* Single line of space separated fields: pid (name) state ppid job_spec daemon */
+static void gen_pid_stat(struct ProcBuf* out, struct Process* process)
+{
+    put_int(out, process->pid);
+    put_str(out, " (");
+    put_str(out, process->name);
+    put_str(out, ") ");
+    put_char(out, state_rep(process->state));
+    put_char(out, ' ');
+    put_int(out, process->ppid);
+    put_char(out, ' ');
+    put_int(out, process->job_spec);
+    put_char(out, ' ');
+    put_int(out, process->daemon);
+    put_char(out, '\n');
+}
+
+/* Program arguments, each one null terminated */
+static void gen_pid_cmdline(struct ProcBuf* out, struct Process* process)
+{
+    char* arg = (char*)process->args;
+
+    for (uint32_t i = 0; i < process->argc; i++)
+    {
+        put_str(out, arg);
+        put_char(out, '\0');
+        arg += strlen(arg) + 1;
+    }
+}
+
+static bool name_equal(const char* path, const char* name)
+{
+    /* Virtual file names are matched case insensitively in line with the 8.3 filename convention */
+    while (*path && *name)
+    {
+        char ch = *path++;
+        if (ch >= 'a' && ch <= 'z')
+            ch -= ('a' - 'A');
+        if (ch != *name++)
+            return false;
+    }
+    return *path == *name;
+}
+
+/* Fill the buffer with the contents of the file at path. Returns false if there's no such file */
+static bool generate(char* path, struct ProcBuf* out)
+{
+    struct Process* process;
+    int pid = 0;
+
+    if (name_equal(path, "STAT"))
+        gen_stat(out);
+    else if (name_equal(path, "MEMINFO"))
+        gen_meminfo(out);
+    else if (name_equal(path, "LOADAVG"))
+        gen_loadavg(out);
+    else{
+        /* Per process files live under a directory named after the PID */
+        if (*path < '0' || *path > '9')
+            return false;
+        while (*path >= '0' && *path <= '9')
+            pid = pid * 10 + (*path++ - BASE_NUMERIC_ASCII);
+        if (*path++ != '/' || (process = get_process(pid)) == NULL)
+            return false;
+        if (name_equal(path, "STAT"))
+            gen_pid_stat(out, process);
+        else if (name_equal(path, "CMDLINE"))
+            gen_pid_cmdline(out, process);
+        else
+            return false;
+    }
+
+    return true;
+}
+
+static struct Inode* procfs_lookup(char* path, bool create)
+{
+    struct ProcNode* node = NULL;
+    struct ProcBuf out;
+
+    /* Virtual files can't be created */
+    if (create)
+        return NULL;
+    for (int i = 0; i < PROCFS_MAX_NODES; i++)
+    {
+        if (!proc_nodes[i].used){
+            node = proc_nodes + i;
+            break;
+        }
+    }
+    if (node == NULL)
+        return NULL;
+
+    out.buf = node->buf;
+    out.len = 0;
+    out.size = PROCFS_BUF_SIZE;
+    if (!generate(path, &out))
+        return NULL;
+
+    /* Every open gets a node of its own holding the snapshot taken now */
+    memset(&node->inode, 0, sizeof(struct Inode));
+    node->used = true;
+    node->inode.file_size = out.len;
+    node->inode.dir_index = DIR_ENTRY_INVALID;
+    node->inode.contiguous = true;
+    node->inode.fs = &procfs;
+    node->inode.ref_count++;
+
+    return &node->inode;
+}
+
+static uint32_t procfs_read(struct Inode* inode, void* buf, uint32_t offset, uint32_t size)
+{
+    struct ProcNode* node = (struct ProcNode*)inode;
+
+    memcpy(buf, node->buf + offset, size);
+
+    return size;
+}
+
+static void* procfs_map(struct Inode* inode, uint32_t offset, uint32_t* size)
+{
+    struct ProcNode* node = (struct ProcNode*)inode;
+
+    if (offset >= inode->file_size)
+        return NULL;
+    if (*size > inode->file_size - offset)
+        *size = inode->file_size - offset;
+
+    return node->buf + offset;
+}
+
+static void procfs_release(struct Inode* inode)
+{
+    ((struct ProcNode*)inode)->used = false;
+}
+
+static struct FileSystem procfs = {
+    .mount_point = PROCFS_MOUNT_POINT,
+    .lookup = procfs_lookup,
+    .read = procfs_read,
+    .write = NULL,
+    .map = procfs_map,
+    .list = NULL,
+    .close = NULL,
+    .release = procfs_release,
+    .remove = NULL,
+    .stream = false
+};
+
+void init_procfs(void)
+{
+    for (int i = 0; i < PROCFS_MAX_NODES; i++)
+        proc_nodes[i].used = false;
+    ASSERT(mount_fs(&procfs));
+}
@@ -0,0 +1,46 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PROCFS_H
+#define _PROCFS_H
+
+#include "file.h"
+
+#define PROCFS_MOUNT_POINT "/PROC/"
+#define PROCFS_MAX_NODES 16
+#define PROCFS_BUF_SIZE 4096
+
+/* An open virtual file. Its contents are generated once when it is opened so that every read sees the same snapshot */
+struct ProcNode
+{
+    struct Inode inode;
+    bool used;
+    char buf[PROCFS_BUF_SIZE];
+};
+
+/* Output cursor for generating file contents */
+struct ProcBuf
+{
+    char* buf;
+    uint32_t len;
+    uint32_t size;
+};
+
+void init_procfs(void);
+
+#endif
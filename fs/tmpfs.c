@@ -0,0 +1,223 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "tmpfs.h"
+#include <kernel.h>
+#include <memory/memory.h>
+#include <lib/lib.h>
+#include <debug/debug.h>
+
+static struct TmpNode tmp_nodes[TMPFS_MAX_FILES];
+static struct FileSystem tmpfs;
+
+static struct TmpNode* find_node(char* name, char* ext)
+{
+    for (int i = 0; i < TMPFS_MAX_FILES; i++)
+    {
+        if (tmp_nodes[i].used && !tmp_nodes[i].unlinked &&
+            memcmp(tmp_nodes[i].inode.name, name, MAX_FILENAME_BYTES) == 0 &&
+            memcmp(tmp_nodes[i].inode.ext, ext, MAX_EXTNAME_BYTES) == 0)
+            return tmp_nodes + i;
+    }
+    return NULL;
+}
+
+static void truncate_node(struct TmpNode* node)
+{
+    for (uint32_t i = 0; i < node->page_count; i++)
+    {
+        kfree(node->pages[i]);
+        node->pages[i] = 0;
+    }
+    node->page_count = 0;
+    node->inode.file_size = 0;
+}
+
+static void free_node(struct TmpNode* node)
+{
+    truncate_node(node);
+    node->unlinked = false;
+    node->used = false;
+}
+
+static struct Inode* tmpfs_lookup(char* path, bool create)
+{
+    char name[MAX_FILENAME_BYTES];
+    char ext[MAX_EXTNAME_BYTES];
+    struct TmpNode* node;
+
+    /* Names are stored the same way as FAT16 directory entries i.e. upper case and padded with spaces */
+    memset(name, CHAR_SPACE_ASCII, MAX_FILENAME_BYTES);
+    memset(ext, CHAR_SPACE_ASCII, MAX_EXTNAME_BYTES);
+    if (!split_path(path, name, ext) || name[0] == CHAR_SPACE_ASCII)
+        return NULL;
+    to_upper_bytes(name, MAX_FILENAME_BYTES);
+    to_upper_bytes(ext, MAX_EXTNAME_BYTES);
+
+    node = find_node(name, ext);
+    if (node == NULL){
+        if (!create)
+            return NULL;
+        for (int i = 0; i < TMPFS_MAX_FILES; i++)
+        {
+            if (!tmp_nodes[i].used){
+                node = tmp_nodes + i;
+                break;
+            }
+        }
+        if (node == NULL)
+            return NULL;
+        memset(node, 0, sizeof(struct TmpNode));
+        node->used = true;
+        node->inode.fs = &tmpfs;
+        node->inode.dir_index = DIR_ENTRY_INVALID;
+        memcpy(node->inode.name, name, MAX_FILENAME_BYTES);
+        memcpy(node->inode.ext, ext, MAX_EXTNAME_BYTES);
+    }
+    else if (create) /* Creating an existing file truncates it */
+        truncate_node(node);
+
+    node->inode.ref_count++;
+    return &node->inode;
+}
+
+static uint32_t tmpfs_read(struct Inode* inode, void* buf, uint32_t offset, uint32_t size)
+{
+    struct TmpNode* node = container_of(inode, struct TmpNode, inode);
+    uint32_t read_size = 0, page_offset, copy_size;
+
+    /* The VFS clamps the size to the file size, hence all pages covering the range are present */
+    while (read_size < size)
+    {
+        /* Offset to page translation is a direct index into the page list, making random access O(1) */
+        page_offset = offset % PAGE_SIZE;
+        copy_size = PAGE_SIZE - page_offset;
+        if (copy_size > size - read_size)
+            copy_size = size - read_size;
+        memcpy((char*)buf + read_size, (void*)(node->pages[offset / PAGE_SIZE] + page_offset), copy_size);
+        read_size += copy_size;
+        offset += copy_size;
+    }
+
+    return read_size;
+}
+
+static uint32_t tmpfs_write(struct Inode* inode, void* buf, uint32_t offset, uint32_t size)
+{
+    struct TmpNode* node = container_of(inode, struct TmpNode, inode);
+    uint32_t write_size = 0, page_index, page_offset, copy_size;
+    void* page;
+
+    /* Files can't have holes. An offset past the end is only possible if another opener truncated the file */
+    if (offset > inode->file_size)
+        return UINT32_MAX;
+
+    while (write_size < size)
+    {
+        page_index = offset / PAGE_SIZE;
+        if (page_index >= TMPFS_MAX_FILE_PAGES)
+            break;
+        /* Appending past the last page only requires a new page at the end of the list */
+        if (page_index == node->page_count){
+            page = kalloc();
+            if (page == NULL)
+                break;
+            node->pages[node->page_count++] = (uint64_t)page;
+        }
+        page_offset = offset % PAGE_SIZE;
+        copy_size = PAGE_SIZE - page_offset;
+        if (copy_size > size - write_size)
+            copy_size = size - write_size;
+        memcpy((void*)(node->pages[page_index] + page_offset), (char*)buf + write_size, copy_size);
+        write_size += copy_size;
+        offset += copy_size;
+    }
+    if (offset > inode->file_size)
+        inode->file_size = offset;
+
+    return write_size;
+}
+
+static void* tmpfs_map(struct Inode* inode, uint32_t offset, uint32_t* size)
+{
+    struct TmpNode* node = container_of(inode, struct TmpNode, inode);
+    uint32_t page_offset = offset % PAGE_SIZE;
+
+    if (offset >= inode->file_size)
+        return NULL;
+    /* File data is only contiguous till the end of the page holding the offset */
+    if (*size > PAGE_SIZE - page_offset)
+        *size = PAGE_SIZE - page_offset;
+    if (*size > inode->file_size - offset)
+        *size = inode->file_size - offset;
+
+    return (void*)(node->pages[offset / PAGE_SIZE] + page_offset);
+}
+
+static void tmpfs_release(struct Inode* inode)
+{
+    struct TmpNode* node = container_of(inode, struct TmpNode, inode);
+
+    /* Data of a file still present in the namespace outlives its last close */
+    if (node->unlinked)
+        free_node(node);
+}
+
+static int tmpfs_remove(char* path)
+{
+    char name[MAX_FILENAME_BYTES];
+    char ext[MAX_EXTNAME_BYTES];
+    struct TmpNode* node;
+
+    memset(name, CHAR_SPACE_ASCII, MAX_FILENAME_BYTES);
+    memset(ext, CHAR_SPACE_ASCII, MAX_EXTNAME_BYTES);
+    if (!split_path(path, name, ext))
+        return -1;
+    to_upper_bytes(name, MAX_FILENAME_BYTES);
+    to_upper_bytes(ext, MAX_EXTNAME_BYTES);
+
+    node = find_node(name, ext);
+    if (node == NULL)
+        return -1;
+    /* Defer releasing the pages to the last close if the file is still open */
+    if (node->inode.ref_count > 0)
+        node->unlinked = true;
+    else
+        free_node(node);
+
+    return 0;
+}
+
+static struct FileSystem tmpfs = {
+    .mount_point = TMPFS_MOUNT_POINT,
+    .lookup = tmpfs_lookup,
+    .read = tmpfs_read,
+    .write = tmpfs_write,
+    .map = tmpfs_map,
+    .list = NULL,
+    .close = NULL,
+    .release = tmpfs_release,
+    .remove = tmpfs_remove,
+    .stream = false
+};
+
+void init_tmpfs(void)
+{
+    memset(tmp_nodes, 0, sizeof(tmp_nodes));
+    ASSERT(mount_fs(&tmpfs));
+}
@@ -0,0 +1,40 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TMPFS_H
+#define _TMPFS_H
+
+#include "file.h"
+
+#define TMPFS_MOUNT_POINT "/TMP/"
+#define TMPFS_MAX_FILES 64
+#define TMPFS_MAX_FILE_PAGES 16 /* Caps a file at 32M with 2M pages */
+
+/* A file on the RAM backed scratch filesystem. File data lives in kernel pages indexed by file offset */
+struct TmpNode
+{
+    struct Inode inode;
+    bool used;
+    bool unlinked; /* Removed from the namespace while still open. Released on last close */
+    uint32_t page_count;
+    uint64_t pages[TMPFS_MAX_FILE_PAGES]; /* Kernel pages holding file data in the order of file offset */
+};
+
+void init_tmpfs(void);
+
+#endif
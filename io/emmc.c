@@ -0,0 +1,196 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "emmc.h"
+#include <lib/lib.h>
+#include <io/print.h>
+
+static bool high_capacity = false; /* SDHC/SDXC cards are block addressed, standard capacity cards byte addressed */
+static uint32_t rca = 0; /* Relative card address assigned by the card during initialization */
+
+static bool wait_for(uint64_t reg, uint32_t mask, bool set)
+{
+    for (int i = 0; i < EMMC_TIMEOUT; i++)
+    {
+        if (((in_word(reg) & mask) != 0) == set)
+            return true;
+    }
+    return false;
+}
+
+static bool wait_interrupt(uint32_t mask)
+{
+    uint32_t flags;
+
+    for (int i = 0; i < EMMC_TIMEOUT; i++)
+    {
+        flags = in_word(EMMC_INTERRUPT);
+        if (flags & INT_ERROR_MASK){
+            /* Acknowledge all raised flags and fail the operation */
+            out_word(EMMC_INTERRUPT, flags);
+            return false;
+        }
+        if (flags & mask){
+            out_word(EMMC_INTERRUPT, mask);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool send_command(uint32_t cmd, uint32_t arg)
+{
+    if (!wait_for(EMMC_STATUS, SR_CMD_INHIBIT, false))
+        return false;
+    /* Clear stale flags so that the completion of this command is not mistaken for an earlier one */
+    out_word(EMMC_INTERRUPT, in_word(EMMC_INTERRUPT));
+    out_word(EMMC_ARG1, arg);
+    out_word(EMMC_CMDTM, cmd);
+
+    return wait_interrupt(INT_CMD_DONE);
+}
+
+static bool send_app_command(uint32_t cmd, uint32_t arg)
+{
+    /* Application specific commands must be preceded by APP_CMD addressed to the card */
+    if (!send_command(CMD_INDEX(SD_APP_CMD) | CMD_RSPNS_48, rca << 16))
+        return false;
+    return send_command(cmd, arg);
+}
+
+static bool set_clock(uint32_t freq)
+{
+    uint32_t ctrl;
+    /* The card clock is the base clock divided by twice the divider value in the 10-bit divided clock mode */
+    uint32_t divider = (EMMC_BASE_CLOCK + 2*freq - 1) / (2*freq);
+
+    if (divider > 0x3ff)
+        divider = 0x3ff;
+    if (!wait_for(EMMC_STATUS, SR_CMD_INHIBIT | SR_DAT_INHIBIT, false))
+        return false;
+
+    /* The card clock must be stopped while the frequency is changed */
+    ctrl = in_word(EMMC_CONTROL1) & ~C1_CLK_EN;
+    out_word(EMMC_CONTROL1, ctrl);
+    ctrl = (ctrl & ~C1_CLK_DIV_MASK) | ((divider & 0xff) << 8) | (((divider >> 8) & 0x3) << 6);
+    out_word(EMMC_CONTROL1, ctrl);
+    if (!wait_for(EMMC_CONTROL1, C1_CLK_STABLE, true))
+        return false;
+    out_word(EMMC_CONTROL1, ctrl | C1_CLK_EN);
+
+    return true;
+}
+
+bool init_emmc(void)
+{
+    bool v2_card;
+    uint32_t ocr = 0;
+
+    /* NOTE The firmware leaves the SD card pins routed to this controller since it boots from the card. Hence no GPIO setup here */
+    /* Reset the host controller and wait for it to come out of reset */
+    out_word(EMMC_CONTROL0, 0);
+    out_word(EMMC_CONTROL1, C1_SRST_HC);
+    if (!wait_for(EMMC_CONTROL1, C1_SRST_HC, false))
+        return false;
+    /* Enable the internal clock with the maximum data timeout and start off at the identification frequency */
+    out_word(EMMC_CONTROL1, C1_CLK_INTLEN | C1_DATA_TOUNIT_MAX);
+    if (!set_clock(SD_INIT_CLOCK))
+        return false;
+    /* Completion is polled. All flags are latched in the interrupt register without raising an interrupt */
+    out_word(EMMC_IRPT_EN, 0);
+    out_word(EMMC_IRPT_MASK, 0xffffffff);
+    out_word(EMMC_INTERRUPT, 0xffffffff);
+
+    if (!send_command(CMD_INDEX(SD_GO_IDLE_STATE) | CMD_RSPNS_NONE, 0))
+        return false;
+    /* Only version 2.00 or later cards respond to SEND_IF_COND. Older cards time out and the command line needs a reset */
+    v2_card = send_command(CMD_INDEX(SD_SEND_IF_COND) | CMD_RSPNS_48, SD_IF_COND_PATTERN);
+    if (v2_card){
+        if ((in_word(EMMC_RESP0) & 0xfff) != SD_IF_COND_PATTERN)
+            return false;
+    }
+    else{
+        out_word(EMMC_CONTROL1, in_word(EMMC_CONTROL1) | C1_SRST_CMD);
+        wait_for(EMMC_CONTROL1, C1_SRST_CMD, false);
+    }
+
+    /* Repeat the operating condition negotiation until the card reports that its power up is complete */
+    for (int i = 0; i < 100 && !(ocr & SD_OCR_READY); i++)
+    {
+        if (!send_app_command(CMD_INDEX(SD_APP_SEND_OP_COND) | CMD_RSPNS_48, SD_OCR_VOLTAGE_WINDOW | (v2_card ? SD_OCR_HCS : 0)))
+            return false;
+        ocr = in_word(EMMC_RESP0);
+        if (!(ocr & SD_OCR_READY))
+            delay(100000);
+    }
+    if (!(ocr & SD_OCR_READY))
+        return false;
+    high_capacity = (ocr & SD_OCR_HCS) != 0;
+
+    /* Move the card from identification to the transfer state */
+    if (!send_command(CMD_INDEX(SD_ALL_SEND_CID) | CMD_RSPNS_136, 0))
+        return false;
+    if (!send_command(CMD_INDEX(SD_SEND_RELATIVE_ADDR) | CMD_RSPNS_48, 0))
+        return false;
+    rca = in_word(EMMC_RESP0) >> 16;
+    if (!send_command(CMD_INDEX(SD_SELECT_CARD) | CMD_RSPNS_48_BUSY, rca << 16))
+        return false;
+    if (!set_clock(SD_TRANSFER_CLOCK))
+        return false;
+    /* High capacity cards have a fixed block length of 512 bytes */
+    if (!high_capacity && !send_command(CMD_INDEX(SD_SET_BLOCKLEN) | CMD_RSPNS_48, SD_BLOCK_SIZE))
+        return false;
+
+    printk("SD card ready (%s)\n", high_capacity ? "SDHC" : "SDSC");
+    return true;
+}
+
+bool emmc_read_blocks(uint64_t lba, uint32_t count, void* buf)
+{
+    uint32_t* data = (uint32_t*)buf;
+    uint32_t cmd;
+
+    if (count == 0)
+        return true;
+    if (count > EMMC_MAX_BLOCKS)
+        return false;
+    if (!wait_for(EMMC_STATUS, SR_DAT_INHIBIT, false))
+        return false;
+
+    out_word(EMMC_BLKSIZECNT, (count << 16) | SD_BLOCK_SIZE);
+    /* Multiple blocks are read with a single command and the controller stops the transfer with an automatic CMD12 */
+    if (count > 1)
+        cmd = CMD_INDEX(SD_READ_MULTIPLE_BLOCK) | CMD_RSPNS_48 | CMD_ISDATA | TM_DAT_DIR_READ | TM_MULTI_BLOCK | TM_BLKCNT_EN | TM_AUTO_CMD12;
+    else
+        cmd = CMD_INDEX(SD_READ_SINGLE_BLOCK) | CMD_RSPNS_48 | CMD_ISDATA | TM_DAT_DIR_READ;
+    if (!send_command(cmd, high_capacity ? (uint32_t)lba : (uint32_t)(lba * SD_BLOCK_SIZE)))
+        return false;
+
+    for (uint32_t block = 0; block < count; block++)
+    {
+        if (!wait_interrupt(INT_READ_RDY))
+            return false;
+        /* The data port is read a 32-bit word at a time */
+        for (int i = 0; i < SD_BLOCK_SIZE / sizeof(uint32_t); i++)
+        {
+            *data++ = in_word(EMMC_DATA);
+        }
+    }
+
+    return wait_interrupt(INT_DATA_DONE);
+}
@@ -0,0 +1,107 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef EMMC_H
+#define EMMC_H
+
+#include <memory/memory.h>
+#include <stdbool.h>
+
+#ifdef RPI4
+#define EMMC_BASE_ADDR      TO_VIRT(0xfe340000) /* EMMC2 controller wired to the SD card slot */
+#define EMMC_BASE_CLOCK     100000000
+#else
+#define EMMC_BASE_ADDR      TO_VIRT(0x3f300000) /* Arasan SDHCI controller (emulated by qemu with -sd) */
+#define EMMC_BASE_CLOCK     41666666
+#endif
+
+#define EMMC_ARG2           EMMC_BASE_ADDR + 0x00
+#define EMMC_BLKSIZECNT     EMMC_BASE_ADDR + 0x04 /* Block size and count register */
+#define EMMC_ARG1           EMMC_BASE_ADDR + 0x08 /* Command argument register */
+#define EMMC_CMDTM          EMMC_BASE_ADDR + 0x0c /* Command and transfer mode register */
+#define EMMC_RESP0          EMMC_BASE_ADDR + 0x10 /* Response registers */
+#define EMMC_RESP1          EMMC_BASE_ADDR + 0x14
+#define EMMC_RESP2          EMMC_BASE_ADDR + 0x18
+#define EMMC_RESP3          EMMC_BASE_ADDR + 0x1c
+#define EMMC_DATA           EMMC_BASE_ADDR + 0x20 /* Data port register */
+#define EMMC_STATUS         EMMC_BASE_ADDR + 0x24 /* Status register */
+#define EMMC_CONTROL0       EMMC_BASE_ADDR + 0x28 /* Host configuration register */
+#define EMMC_CONTROL1       EMMC_BASE_ADDR + 0x2c /* Clock and reset control register */
+#define EMMC_INTERRUPT      EMMC_BASE_ADDR + 0x30 /* Interrupt flags register */
+#define EMMC_IRPT_MASK      EMMC_BASE_ADDR + 0x34 /* Interrupt flag enable register */
+#define EMMC_IRPT_EN        EMMC_BASE_ADDR + 0x38 /* Interrupt generation enable register */
+#define EMMC_CONTROL2       EMMC_BASE_ADDR + 0x3c
+
+/* Command and transfer mode register fields */
+#define CMD_INDEX(n)        ((n) << 24)
+#define CMD_ISDATA          (1 << 21)
+#define CMD_RSPNS_NONE      (0 << 16)
+#define CMD_RSPNS_136       (1 << 16)
+#define CMD_RSPNS_48        (2 << 16)
+#define CMD_RSPNS_48_BUSY   (3 << 16)
+#define TM_MULTI_BLOCK      (1 << 5)
+#define TM_DAT_DIR_READ     (1 << 4)
+#define TM_AUTO_CMD12       (1 << 2)
+#define TM_BLKCNT_EN        (1 << 1)
+
+/* Status register flags */
+#define SR_CMD_INHIBIT      (1 << 0)
+#define SR_DAT_INHIBIT      (1 << 1)
+
+/* Interrupt register flags */
+#define INT_CMD_DONE        (1 << 0)
+#define INT_DATA_DONE       (1 << 1)
+#define INT_READ_RDY        (1 << 5)
+#define INT_ERROR_MASK      0xffff8000
+
+/* Control 1 register fields */
+#define C1_CLK_INTLEN       (1 << 0)
+#define C1_CLK_STABLE       (1 << 1)
+#define C1_CLK_EN           (1 << 2)
+#define C1_DATA_TOUNIT_MAX  (0xe << 16)
+#define C1_SRST_HC          (1 << 24)
+#define C1_SRST_CMD         (1 << 25)
+#define C1_CLK_DIV_MASK     0xffc0 /* 10-bit divider split across bits 15:8 (lower) and 7:6 (upper) */
+
+/* SD commands used by the driver */
+#define SD_GO_IDLE_STATE        0
+#define SD_ALL_SEND_CID         2
+#define SD_SEND_RELATIVE_ADDR   3
+#define SD_SELECT_CARD          7
+#define SD_SEND_IF_COND         8
+#define SD_SET_BLOCKLEN         16
+#define SD_READ_SINGLE_BLOCK    17
+#define SD_READ_MULTIPLE_BLOCK  18
+#define SD_APP_SEND_OP_COND     41
+#define SD_APP_CMD              55
+
+#define SD_IF_COND_PATTERN      0x1aa /* 2.7-3.6V with check pattern 0xaa */
+#define SD_OCR_VOLTAGE_WINDOW   0x00ff8000
+#define SD_OCR_HCS              (1 << 30) /* Host supports high capacity cards / card is high capacity */
+#define SD_OCR_READY            (1 << 31)
+
+#define SD_INIT_CLOCK       400000
+#define SD_TRANSFER_CLOCK   25000000
+#define SD_BLOCK_SIZE       512
+#define EMMC_TIMEOUT        1000000 /* Polling iterations before giving up on the controller */
+#define EMMC_MAX_BLOCKS     0xffff /* Block count field limit for a single transfer */
+
+bool init_emmc(void);
+bool emmc_read_blocks(uint64_t lba, uint32_t count, void* buf);
+
+#endif
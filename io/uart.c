@@ -43,6 +43,17 @@ void write_string(const char *str)
     }   
 }
 
+void write_buffer(const char *buf, uint32_t size)
+{
+    /* Unlike write_string, the length is explicit so that data with embedded null bytes goes out as is */
+    for (uint32_t i = 0; i < size; i++)
+    {
+        if (buf[i] == '\n')
+            write_char('\r');
+        write_char(buf[i]);
+    }
+}
+
 void uart_handler(void)
 {
     /* Check if it is a receiving UART interrupt by reading bit 4 of UART masked interrupt status register */
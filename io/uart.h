@@ -41,6 +41,7 @@
 unsigned char read_char(void);
 void write_char(unsigned char c);
 void write_string(const char *str);
+void write_buffer(const char *buf, uint32_t size);
 void init_uart(void);
 void uart_handler(void);
 
@@ -52,7 +52,6 @@
     ldp x4, x5, [sp, #(16*2)]
     ldp x6, x7, [sp, #(16*3)]
     ldp x8, x9, [sp, #(16*4)]
-    ldp x2, x3, [sp, #(16*1)]
     ldp x10, x11, [sp, #(16*5)]
     ldp x12, x13, [sp, #(16*6)]
     ldp x14, x15, [sp, #(16*7)]
@@ -89,9 +88,16 @@
 .global read_timer_freq
 .global read_timer_status
 .global set_timer_interval
+.global set_timer_deadline
+.global read_timer_count
 .global enable_irq
 .global pstart
 .global swap
+.global fp_save
+.global fp_restore
+.global set_fp_access
+.global enable_user_counter
+.global set_user_record
 .global trap_return
 
 # Align the vector table to a 2KB boundary (0x800 = 2048)
@@ -135,7 +141,7 @@ current_el_spn_serror:
 # Lower el with aarch64 handlers for EL0. These are the ones we'll use for EL0 exceptions
 .balign 0x80
 lower_el_aarch64_sync:
-    b sync_handler
+    b el0_sync_handler
 
 .balign 0x80
 lower_el_aarch64_irq:
@@ -167,6 +173,9 @@ lower_el_aarch32_serror:
     b error
 
 trap_return:
+    # Leaving the kernel. Release the kernel lock taken by the handler (or by the scheduler which switched to a new process)
+    # The registers clobbered by the call are all restored from the context frame below
+    bl unlock_kernel
     # Restore GPRs and other registers of previous context with the load pair instruction
     # NOTE We don't need to restore trap number and error code from the stack anywhere
     # However, the return address and pstate values need to restored in respective registers
@@ -182,16 +191,101 @@ sync_handler:
     mrs x0, esr_el1
     # Bits 26-31 in esr contain the exception class, thus we shift x0 right by 26 and store value in x1
     lsr x1, x0, #26
-    # If the exception class value is 0x15, it is deemed as a system call
+    # Exception ID 1 for sync exceptions unless the class says otherwise
+    mov x0, #1
+    # If the exception class value is 0x15, it is deemed as a system call (Exception ID 3)
     cmp x1, #0b010101
-    # Conditional select of value in x1 (Exception ID 1 for sync exceptions) or x3 (Exception ID 3 for system call trap) 
-    mov x1, #1
     mov x3, #3
-    # Copy x2 in x0 if comparison above is not equal, otherwise copy x3
-    csel x0, x2, x3, ne
+    csel x0, x3, x0, eq
+    # Exception class 0x7 is an access to FP/SIMD registers trapped by CPACR (Exception ID 4)
+    cmp x1, #0b000111
+    mov x3, #4
+    csel x0, x3, x0, eq
     handler_entry
     b trap_return
 
+el0_sync_handler:
+    # System calls from EL0 take the path below, which saves only the registers a syscall needs. Peek at the exception class with x0 and x1 saved to the context frame first
+    sub sp, sp, #(36*8)
+    stp x0, x1, [sp]
+    mrs x0, esr_el1
+    lsr x1, x0, #26
+    cmp x1, #0b010101
+    bne el0_sync_full
+    # An svc #2 is a register ABI syscall kept on the regular path, as a baseline to measure the lean one against
+    and x0, x0, #0xffff
+    cmp x0, #2
+    bne svc_entry
+el0_sync_full:
+    # Any other synchronous exception takes the regular path which saves the whole context
+    ldp x0, x1, [sp]
+    add sp, sp, #(36*8)
+    b sync_handler
+
+svc_entry:
+    # A syscall stub is called like any function hence the temporaries x9-x17 hold nothing the caller expects to be kept. They are not saved
+    # but their slots are zeroed, since a forked child returns through kernel_exit which loads them from a copy of this frame
+    # The arguments (x0-x7) and syscall number (x8) are needed by the handler. The callee saved registers x19-x29 are preserved by the
+    # kernel C code but still saved because a forked child and signal delivery take the user context from the frame
+    stp x2, x3, [sp, #(16*1)]
+    stp x4, x5, [sp, #(16*2)]
+    stp x6, x7, [sp, #(16*3)]
+    stp x8, xzr, [sp, #(16*4)]
+    stp xzr, xzr, [sp, #(16*5)]
+    stp xzr, xzr, [sp, #(16*6)]
+    stp xzr, xzr, [sp, #(16*7)]
+    stp xzr, xzr, [sp, #(16*8)]
+    stp x18, x19, [sp, #(16*9)]
+    stp x20, x21, [sp, #(16*10)]
+    stp x22, x23, [sp, #(16*11)]
+    stp x24, x25, [sp, #(16*12)]
+    stp x26, x27, [sp, #(16*13)]
+    stp x28, x29, [sp, #(16*14)]
+    mrs x0, sp_el0
+    stp x30, x0, [sp, #(16*15)]
+    # Exception ID 3 for system call trap along with the syndrome which holds the svc immediate telling the calling convention
+    mov x0, #3
+    mrs x1, esr_el1
+    stp x0, x1, [sp, #(16*16)]
+    mrs x0, elr_el1
+    mrs x1, spsr_el1
+    stp x0, x1, [sp, #(16*17)]
+    mov x0, sp
+    bl svc_handler
+    # A signal handler restore or an exec rewrites the whole user context in the frame, of which svc_return only loads a part
+    cbnz w0, trap_return
+
+svc_return:
+    # Return from a syscall to the process which made it on the same kernel stack. A new process or one whose context
+    # was built from scratch or restored after a signal handler returns through trap_return instead
+    bl unlock_kernel
+    ldp x0, x1, [sp, #(16*17)]
+    msr elr_el1, x0
+    msr spsr_el1, x1
+    ldp x30, x0, [sp, #(16*15)]
+    msr sp_el0, x0
+    # The return value, and the argument registers a syscall may have set in the frame
+    ldp x0, x1, [sp]
+    ldp x2, x3, [sp, #(16*1)]
+    ldp x4, x5, [sp, #(16*2)]
+    ldp x6, x7, [sp, #(16*3)]
+    ldr x8, [sp, #(16*4)]
+    # The kernel C code may use x18 as a temporary. x19-x29 come back intact from it and need not be loaded
+    ldr x18, [sp, #(16*9)]
+    # Clear the temporaries rather than load them, so that no kernel values are left in them for user mode to see
+    mov x9, xzr
+    mov x10, xzr
+    mov x11, xzr
+    mov x12, xzr
+    mov x13, xzr
+    mov x14, xzr
+    mov x15, xzr
+    mov x16, xzr
+    mov x17, xzr
+
+    add sp, sp, #(36*8)
+    eret
+
 irq_handler:
     kernel_entry
     # Exception ID 2 means hardware (asynchronous exception) interrupt
@@ -216,6 +310,17 @@ set_timer_interval:
     msr CNTP_TVAL_EL0, x0
     ret
 
+set_timer_deadline:
+    # Load CVAL (comparator value register) with the absolute system count in x0 at which the timer should fire
+    msr CNTP_CVAL_EL0, x0
+    ret
+
+read_timer_count:
+    # The instruction barrier keeps the counter from being read ahead of preceding instructions
+    isb
+    mrs x0, CNTPCT_EL0
+    ret
+
 enable_timer:
     # Save the frame pointer (x29) and return address (x30) on the stack because we have nested function calls
     # Push x29 and x30 on the stack using the store pair instruction
@@ -252,6 +357,80 @@ enable_irq:
     msr daifclr, #2
     ret
 
+fp_save:
+    # x0 => FP state. Store the 32 128-bit SIMD registers followed by the control and status registers
+    stp q0, q1, [x0, #(32*0)]
+    stp q2, q3, [x0, #(32*1)]
+    stp q4, q5, [x0, #(32*2)]
+    stp q6, q7, [x0, #(32*3)]
+    stp q8, q9, [x0, #(32*4)]
+    stp q10, q11, [x0, #(32*5)]
+    stp q12, q13, [x0, #(32*6)]
+    stp q14, q15, [x0, #(32*7)]
+    stp q16, q17, [x0, #(32*8)]
+    stp q18, q19, [x0, #(32*9)]
+    stp q20, q21, [x0, #(32*10)]
+    stp q22, q23, [x0, #(32*11)]
+    stp q24, q25, [x0, #(32*12)]
+    stp q26, q27, [x0, #(32*13)]
+    stp q28, q29, [x0, #(32*14)]
+    stp q30, q31, [x0, #(32*15)]
+    # The offset past the SIMD registers is out of range of the store pair immediate for 64-bit registers
+    add x0, x0, #(32*16)
+    mrs x1, fpcr
+    mrs x2, fpsr
+    stp x1, x2, [x0]
+    ret
+
+fp_restore:
+    # x0 => FP state. Load the registers in the layout stored by fp_save
+    ldp q0, q1, [x0, #(32*0)]
+    ldp q2, q3, [x0, #(32*1)]
+    ldp q4, q5, [x0, #(32*2)]
+    ldp q6, q7, [x0, #(32*3)]
+    ldp q8, q9, [x0, #(32*4)]
+    ldp q10, q11, [x0, #(32*5)]
+    ldp q12, q13, [x0, #(32*6)]
+    ldp q14, q15, [x0, #(32*7)]
+    ldp q16, q17, [x0, #(32*8)]
+    ldp q18, q19, [x0, #(32*9)]
+    ldp q20, q21, [x0, #(32*10)]
+    ldp q22, q23, [x0, #(32*11)]
+    ldp q24, q25, [x0, #(32*12)]
+    ldp q26, q27, [x0, #(32*13)]
+    ldp q28, q29, [x0, #(32*14)]
+    ldp q30, q31, [x0, #(32*15)]
+    add x0, x0, #(32*16)
+    ldp x1, x2, [x0]
+    msr fpcr, x1
+    msr fpsr, x2
+    ret
+
+set_fp_access:
+    # x0 => whether EL0 may use FP/SIMD registers. EL1 always may, for the kernel to save and restore them
+    # FPEN (bits 20-21) of CPACR set to 0b11 disables FP traps. 0b01 traps accesses from EL0 only
+    mov x1, #(1 << 20)
+    cbz x0, fp_access_set
+    mov x1, #(3 << 20)
+fp_access_set:
+    msr cpacr_el1, x1
+    isb
+    ret
+
+enable_user_counter:
+    # Setting EL0VCTEN (bit 1) of the kernel timer control register lets EL0 read the virtual count register CNTVCT_EL0
+    # EL0 access to the physical timer and counter and to the virtual timer registers stays trapped
+    mov x0, #(1 << 1)
+    msr cntkctl_el1, x0
+    isb
+    ret
+
+set_user_record:
+    # x0 => user address of the kernel data record of the process about to run
+    # TPIDRRO_EL0 is read-only at EL0, so user code can find its record without being able to redirect it
+    msr tpidrro_el0, x0
+    ret
+
 swap:
     # Make room for 12 GPRs on the stack. Other GPRs are saved registers hence needn't be pushed to the stack during a context switch
     sub sp, sp, #(12*8)
@@ -273,9 +452,9 @@ swap:
     # Restore the context of the new process to respective registers, which it had pushed to the stack when previously yielded
     ldp x19, x20, [sp, #(16*0)]
     ldp x21, x22, [sp, #(16*1)]
-    ldp x22, x24, [sp, #(16*2)]
-    ldp x23, x26, [sp, #(16*3)]
-    ldp x25, x28, [sp, #(16*4)]
+    ldp x23, x24, [sp, #(16*2)]
+    ldp x25, x26, [sp, #(16*3)]
+    ldp x27, x28, [sp, #(16*4)]
     ldp x29, x30, [sp, #(16*5)]
 
     # Reclaim used space on the stack
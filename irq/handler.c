@@ -23,15 +23,20 @@
 #include <io/uart.h>
 #include <irq/syscall.h>
 #include <process/process.h>
+#include <memory/memory.h>
 #include "handler.h"
 
 void enable_timer(void);
 uint32_t read_timer_status(void);
 void set_timer_interval(uint32_t value);
+void set_timer_deadline(uint64_t count);
+uint64_t read_timer_count(void);
 uint32_t read_timer_freq(void);
+void enable_user_counter(void);
 
 static uint32_t timer_interval = 0;
-static uint64_t ticks = 0;
+static uint64_t boot_count = 0; /* System counter value at which the kernel started keeping time */
+static bool tickless[MAX_CPUS]; /* Whether the periodic tick of a core is stopped while it idles */
 
 void init_interrupt_controller(void)
 {
@@ -43,25 +48,18 @@ void init_interrupt_controller(void)
        Setting 255 means that all interrupts are allowed to be processed by the CPU interface */
     out_word(ICC_PR, 0xff);
     /* The distributor priority register is 32 bits long and can hold priority levels for 4 interrupts (1 byte each)
-       Timer interrupt will use the 17th ICD register (16 * 4-byte ICD_PR = 64). Make it the highest priority interrupt (value 0) */
-    out_word(ICD_PR + TIMER_IRQ, 0);
-    /* UART interrrupt will use the 38th ICD register (38 * 4-byte ICD_PR = ~153) */
+       UART interrrupt will use the 38th ICD register (38 * 4-byte ICD_PR = ~153). The core timers are set up per core in init_cpu_timer */
     out_word(ICD_PR + ((VC_IRQ_BASE + UART_IRQ)/4) * 4, 1);
-    /* The processor target interrupt register has the same structure and calculation as ICD_PR hence offset for timer IRQ remains the same
-       This register determines which CPU core handles a given interrupt at specified offset. Timer IRQ is configured to be handled by core 0 */
-    out_word(ICD_PTR + TIMER_IRQ, 1);
-    /* Configure core 0 to habdle UART interrupt by setting lowest bit of 2nd byte in the 38th ICD register */
+    /* The processor target interrupt register has the same structure and calculation as ICD_PR
+       This register determines which CPU core handles a given interrupt at specified offset
+       Configure core 0 to habdle UART interrupt by setting lowest bit of 2nd byte in the 38th ICD register */
     out_word(ICD_PTR + ((VC_IRQ_BASE + UART_IRQ)/4) * 4, 0x100);
-    /* Interrupt config register holds sensitivity data for 16 interrupts 2-bit each. Timer IRQ's offset will fall in 4th register.
-       The secomd bit of each entry: 0 => level triggered, 1 => edge triggered, We set timer interrupt to be edge triggered */
-    out_word(ICD_ICFGR + TIMER_IRQ/4, 2);
-    /* UART IRQ will fall in the 10th register so register offset will be 9 * 4-byte ICD_ICFGR = 36
+    /* Interrupt config register holds sensitivity data for 16 interrupts 2-bit each. The secomd bit of each entry: 0 => level triggered, 1 => edge triggered
+       UART IRQ will fall in the 10th register so register offset will be 9 * 4-byte ICD_ICFGR = 36
        Write 1 to the upper bit of the 9th 2-bit block of this register ((96+57) - (16*9) = 9) to configure it as edge triggered */
     out_word(ICD_ICFGR + ((VC_IRQ_BASE + UART_IRQ)/16) * 4, 0x20000);
     /* Each bit of 4-byte interrupt set enable register determines whether an interrupt is enabled or not
-       Timer interrupt will use the 3rd ICD register hence offset will be 8 (2 * 4-byte ICD_ISENABLE = 8) */
-    out_word(ICD_ISENABLE + TIMER_IRQ/8, 1);
-    /* Calculate register offset for UART IRQ and write 1 to 25th bit in it to enable this interrupt */
+       Calculate register offset for UART IRQ and write 1 to 25th bit in it to enable this interrupt */
     out_word(ICD_ISENABLE + ((VC_IRQ_BASE + UART_IRQ)/32) * 4, (1 << 25));
     /* Enable the distributor and CPU interface */
     out_word(DISTR_CTL, 1);
@@ -77,55 +75,118 @@ void init_interrupt_controller(void)
 #endif
 }
 
-/* Tick interval = 10 ms */
+/* Tick interval = 10 ms
+   System time is read off the system counter rather than counted in timer interrupts, which idle cores stop taking */
 uint64_t get_ticks(void)
 {
-    return ticks;
+    if (timer_interval == 0)
+        return 0;
+    return (read_timer_count() - boot_count) / timer_interval;
 }
 
 void init_timer(void)
 {
-#ifdef RPI4
-    /* timer_clock = apb_clock / (pre-divider+1) => 200 MHz / (0x7d+1) = ~1.6 MHz, 200 MHz and 7d are default values of apb_clock and pre-divider */
-    out_word(TIMER_PREDIV, 0x7d);
-    /* The exact timer_clock value from the previous equation was 1587301 Hz i.e. 1587301 ticks per second
-       Dividing this by 100 will yield the value of timer_clock elapsed after every 10 ms which is the kernel's tick interval */
-    out_word(TIMER_LOAD, 15873);
-    /* With ref to BCM2711 TRM, high bit 1 => 32-bit counter, bit 5 => timer intr enabled, bit 7 => timer enabled */
-    /* The timer interrupt is configured as a recurring interrupt which is fired every 10 ms */
-    out_word(TIMER_CTL, 0b10100010);
-#else
-    /* Save the timer interval for the handler to retrigger when the interrupt is triggered for the first time */
+    /* Save the timer interval for the handler to retrigger the generic timer of a core when it fires */
     timer_interval = read_timer_freq() / 100;
-    enable_timer();
-    /* Set bit 1 (IRQ enable) of the core timer status register to enable timer interrupts */
-    out_word(CNTP_EL0, (1 << 1));
-#endif
+    boot_count = read_timer_count();
+    /* Publish the timer calibration for user programs to derive the tick count and time from the counter they can read */
+    struct KernelData* data = (struct KernelData*)get_kernel_data();
+    data->timer_freq = read_timer_freq();
+    data->boot_count = boot_count;
+    data->tick_interval = timer_interval;
+    init_cpu_timer();
 }
 
-static void timer_interrupt_handler(void)
+/* Start the timer of a core and let other cores interrupt it when they queue work on it. System time is kept by the boot core alone */
+void init_cpu_timer(void)
 {
+    enable_timer();
+    enable_user_counter();
 #ifdef RPI4
-    uint32_t status = in_word(TIMER_MSKIRQ);
+    /* The priority and enable bits of private peripheral interrupts and the CPU interface registers are banked per core
+       Software generated interrupts are always enabled on the GIC400 */
+    out_word(ICC_PR, 0xff);
+    out_word(ICD_PR + (CORE_TIMER_IRQ/4) * 4, 0);
+    out_word(ICD_ISENABLE, (1 << CORE_TIMER_IRQ));
+    out_word(CPUIF_CTL, 1);
 #else
-    uint32_t status = read_timer_status();
+    out_word(CORE_TIMER_CTL(get_cpu_id()), (1 << 1));
+    /* Bit 0 enables the interrupt of mailbox 0 which other cores write to */
+    out_word(CORE_MBOX_CTL(get_cpu_id()), 1);
 #endif
+}
+
+/* Program the timer of an idle core to fire only at the next sleep deadline, if ever. Deadlines are served by the boot core */
+static void set_idle_timer(int cpu)
+{
+    uint64_t deadline = cpu == 0 ? next_deadline() : UINT64_MAX;
+
+    if (deadline >= (UINT64_MAX - boot_count) / timer_interval)
+        set_timer_deadline(UINT64_MAX);
+    else
+        set_timer_deadline(boot_count + deadline * timer_interval);
+}
+
+/* Switch the timer of the core between the periodic tick, which drives preemption, and the one shot idle mode */
+void set_tick_mode(bool idle)
+{
+    int cpu = get_cpu_id();
+
+    if (!idle && !tickless[cpu])
+        return;
+    tickless[cpu] = idle;
+    if (idle)
+        set_idle_timer(cpu);
+    else
+        set_timer_interval(timer_interval);
+}
+
+/* Interrupt another core to have it run the scheduler, since an idle core takes no ticks to notice work queued on it */
+void kick_cpu(int cpu)
+{
 #ifdef RPI4
-    /* If bit 0 of mask register is set, timer interrupt is asserted */
-    if (status & 1)
+    /* Bits 16-23 of the software interrupt register select the target cores */
+    out_word(ICD_SGIR, (1 << (16 + cpu)) | KICK_IRQ);
 #else
-    /* If bit 2 is set, it means the timer has fired. Reset the timer with the same interval */
-    if (status & (1 << 2))
+    out_word(CORE_MBOX_SET(cpu), 1);
 #endif
-    {
-        ticks++;
-        wake_up(SLEEP_SYSCALL);
-#ifdef RPI4
-        /* Acknowledge the interrupt by clearing the pending bit of the timer ack register */
-        out_word(TIMER_ACK, 1);
-#else
-        set_timer_interval(timer_interval);
+}
+
+static void kick_handler(void)
+{
+    int cpu = get_cpu_id();
+#ifndef RPI4
+    out_word(CORE_MBOX_CLR(cpu), 0xffffffff);
 #endif
+    /* The boot core may have been kicked for a sleep deadline earlier than the one its timer is set to */
+    if (tickless[cpu])
+        set_idle_timer(cpu);
+}
+
+static void timer_interrupt_handler(void)
+{
+    int cpu = get_cpu_id();
+    /* If bit 2 of the generic timer control register is set, it means the timer has fired */
+    if ((read_timer_status() >> 2) & 1)
+    {
+        /* Only the boot core wakes up processes whose sleep has run out and samples the load averages */
+        if (cpu == 0){
+            uint64_t now = get_ticks();
+            wake_expired(now);
+            calc_load(now);
+        }
+        /* Charge the tick to the process which was interrupted and count down its time slice */
+        struct Process* process = get_curr_process();
+        if (process != NULL){
+            process->cpu_ticks++;
+            if (process->slice > 0)
+                process->slice--;
+        }
+        /* Reset the timer with the same interval, or to the next deadline if the core is idle */
+        if (tickless[cpu])
+            set_idle_timer(cpu);
+        else
+            set_timer_interval(timer_interval);
     }
 }
 
@@ -146,7 +207,12 @@ void handler(struct ContextFrame* ctx)
     uint32_t irq;
     /* Whether the exception occured because of a userspace process */
     bool user_except = ((ctx->spsr & PSTATE_MODE_MASK) == 0);
-    struct Process* curr_proc = get_curr_process();
+    struct Process* curr_proc;
+
+    account_entry(ctx);
+    /* Released in trap_return on the way out of the kernel */
+    lock_kernel();
+    curr_proc = get_curr_process();
 
     /* Save register context for idle process from the kernel stack */
     if (curr_proc->pid == 0)
@@ -169,10 +235,10 @@ void handler(struct ContextFrame* ctx)
     case 2:
 #ifdef RPI4
         irq = get_irq_number();
-        if (irq == TIMER_IRQ)
+        if ((irq & IRQ_ID_MASK) == CORE_TIMER_IRQ)
 #else
-        /* Read the interrupt source register to check what kind of hardware interrupt it is */
-        irq = in_word(CNTP_STATUS_EL0);
+        /* Read the interrupt source register of this core to check what kind of hardware interrupt it is */
+        irq = in_word(CORE_IRQ_SOURCE(get_cpu_id()));
         /* High bit 1 indicates timer interrupt */
         if (irq & (1 << 1))
 #endif
@@ -180,6 +246,16 @@ void handler(struct ContextFrame* ctx)
             timer_interrupt_handler();
             schedule = true;
         }
+#ifdef RPI4
+        else if ((irq & IRQ_ID_MASK) == KICK_IRQ)
+#else
+        /* Bit 4 indicates a write to mailbox 0 by another core */
+        else if (irq & (1 << 4))
+#endif
+        {
+            kick_handler();
+            schedule = true;
+        }
         else{
 #ifdef RPI4
             if (irq == (VC_IRQ_BASE + UART_IRQ))
@@ -188,7 +264,11 @@ void handler(struct ContextFrame* ctx)
             /* Bit 19 of the interrupt pending register is for IRQ 57 i.e. UART interrupt */
             if (irq & (1 << 19))
 #endif
+            {
                 uart_handler();
+                /* Let a process woken up by the input preempt the current one if it has higher priority */
+                schedule = true;
+            }
             else{
                 printk("Unknown hardware interrupt\r\n");
                 while(1);
@@ -203,6 +283,15 @@ void handler(struct ContextFrame* ctx)
     case 3:
         system_call(ctx);
         break;
+    /* First FP/SIMD access of a process since it was scheduled. The instruction is run again on return with the registers loaded */
+    case 4:
+        if (user_except)
+            fp_trap(curr_proc);
+        else{
+            printk("FP access in kernel at %x: %x\r\n", ctx->elr, ctx->esr);
+            while(1);
+        }
+        break;
     default:
         if (user_except){
             printk("%x: Process (PID %d) resulted in an unknown exception. Terminating\n", ctx->elr, curr_proc->pid);
@@ -217,4 +306,19 @@ void handler(struct ContextFrame* ctx)
 
     if (schedule)
         trigger_scheduler();
+    deliver_signals(ctx);
+    account_exit(ctx);
+}
+
+/* Entry of system calls from EL0 which skip the exception classification of the handler above */
+/* Returns whether the frame has to be loaded in full on the way out, which svc_entry does through trap_return */
+bool svc_handler(struct ContextFrame* ctx)
+{
+    account_entry(ctx);
+    /* Released in svc_return or trap_return on the way out of the kernel */
+    lock_kernel();
+    bool full_exit = system_call(ctx);
+    deliver_signals(ctx);
+    account_exit(ctx);
+    return full_exit;
 }
\ No newline at end of file
@@ -20,6 +20,7 @@
 #define HANDLER_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 struct ContextFrame
 {
@@ -64,8 +65,11 @@ struct ContextFrame
 #define PSTATE_MODE_MASK 0xF /* The mode field bitmask (EL0, EL1 etc.) of pstate register */
 
 void init_timer(void);
+void init_cpu_timer(void);
 void enable_irq(void);
 void init_interrupt_controller(void);
 uint64_t get_ticks(void);
+void set_tick_mode(bool idle);
+void kick_cpu(int cpu);
 
 #endif
\ No newline at end of file
@@ -23,7 +23,6 @@
 
 #ifdef RPI4
 #define GIC_BASE            TO_VIRT(0xff840000) /* GIC400 interrupt controller base register */
-#define BASE_ADDR           TO_VIRT(0xfe000000) /* Timer base register */
 #else
 #define BASE_ADDR           TO_VIRT(0x3f000000) /* Interrupt controller base register */
 #endif
@@ -39,6 +38,7 @@
 #define ICD_PTR             DISTR_CTL + 0x800   /* Processor target interrupt */
 #define ICD_GROUP           DISTR_CTL + 0x80
 #define ICD_ICFGR           DISTR_CTL + 0xc00   /* Interrupt config register */
+#define ICD_SGIR            DISTR_CTL + 0xf00   /* Software generated interrupt register */
 
 #define CPUIF_CTL           GIC_BASE + 0x2000   /* CPU interface control register */
 #define ICC_PR              CPUIF_CTL + 0x4     /* CPU interface interrupt priority register */
@@ -57,15 +57,17 @@
 #define UART_IRQ            57                      /* UART IRQ */
 #ifdef RPI4
 #define VC_IRQ_BASE         96                      /* VC peripheral IRQs base SPI IDs 96-159 */
-#define TIMER_IRQ           64                      /* ARM timer part of ARMC peripheral IRQs SPI IDs 64-79 */
-#define TIMER_LOAD          (BASE_ADDR + 0xB400)    /* Timer value load register */
-#define TIMER_CTL           (BASE_ADDR + 0xB408)    /* Timer control register */
-#define TIMER_ACK           (BASE_ADDR + 0xB40C)    /* Timer acknowledge register */
-#define TIMER_MSKIRQ        (BASE_ADDR + 0xB414)    /* Timer mask register */
-#define TIMER_PREDIV        (BASE_ADDR + 0xB41c)    /* Timer pre-divider register */
+#define CORE_TIMER_IRQ      30                      /* Non secure physical timer of each core. Private peripheral interrupt banked per core */
+#define KICK_IRQ            0                       /* Software generated interrupt one core sends another to have it reschedule */
+#define IRQ_ID_MASK         0x3ff                   /* Interrupt ID field of the acknowledge register. Upper bits hold the sender of a software interrupt */
 #else
 #define CNTP_EL0        TO_VIRT(0x40000040) /* Core 0 interrupt timer control register */ 
 #define CNTP_STATUS_EL0 TO_VIRT(0x40000060) /* Core 0 interrupt source register */
+#define CORE_TIMER_CTL(cpu)     (CNTP_EL0 + (cpu) * 4)          /* Per core copies of the registers above, 4 bytes apart */
+#define CORE_IRQ_SOURCE(cpu)    (CNTP_STATUS_EL0 + (cpu) * 4)
+#define CORE_MBOX_CTL(cpu)      (TO_VIRT(0x40000050) + (cpu) * 4)   /* Mailbox interrupt control register of a core */
+#define CORE_MBOX_SET(cpu)      (TO_VIRT(0x40000080) + (cpu) * 16)  /* Write set register of mailbox 0 of a core */
+#define CORE_MBOX_CLR(cpu)      (TO_VIRT(0x400000c0) + (cpu) * 16)  /* Write clear register of mailbox 0 of a core */
 #endif
 
 #endif
\ No newline at end of file
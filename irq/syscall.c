@@ -24,15 +24,22 @@
 #include <stddef.h>
 #include <process/process.h>
 #include <fs/file.h>
+#include <fs/pipe.h>
 
 static SYSTEMCALL syscall_list[TOTAL_SYSCALL_FUNCTIONS];
 
+/* Threads share the file descriptor table of the process they belong to */
+static struct Process* file_owner(void)
+{
+    return get_group_leader(get_curr_process());
+}
+
 static int64_t sys_write(int64_t *argv)
 {
-    /* Pass the first argument on the stack which contains the pointer to the char array */
-    write_string((char*)argv[0]);
-    /* Return the count of characters printed to the console */
-    return (int)argv[1];
+    /* Write the number of bytes passed in the second argument to the console, or wherever standard output is redirected */
+    uint32_t size = write_out(file_owner(), STDOUT_FILENO, (void*)argv[0], argv[1]);
+    /* Return the count of characters written */
+    return size == UINT32_MAX ? -1 : (int)size;
 }
 
 static int64_t sys_sleep(int64_t* argv)
@@ -42,10 +49,10 @@ static int64_t sys_sleep(int64_t* argv)
 
     uint64_t target_ticks = ticks + sleep_ticks;
 
-    /* Put the process to sleep at every tick until the sleep duration has elapsed */
+    /* Sleep until the deadline. The loop only repeats if a signal woke the process up early */
     while (ticks < target_ticks)
     {
-        sleep(SLEEP_SYSCALL);
+        sleep_until(target_ticks);
         ticks = get_ticks();
     }
 
@@ -65,23 +72,65 @@ static int64_t sys_wait(int64_t* argv)
 
 static int64_t sys_open_file(int64_t* argv)
 {
-    return open_file(get_curr_process(), (char*)argv[0]);
+    return open_file(file_owner(), (char*)argv[0]);
 }
 
 static int64_t sys_close_file(int64_t* argv)
 {
-    close_file(get_curr_process(), argv[0]);
+    close_file(file_owner(), argv[0]);
     return 0;
 }
 
 static int64_t sys_file_size(int64_t* argv)
 {
-    return get_file_size(get_curr_process(), argv[0]);
+    return get_file_size(file_owner(), argv[0]);
 }
 
 static int64_t sys_read_file(int64_t* argv)
 {
-    return read_file(get_curr_process(), argv[0], (void*)argv[1], argv[2]);
+    return read_file(file_owner(), argv[0], (void*)argv[1], argv[2]);
+}
+
+static int64_t sys_create_file(int64_t* argv)
+{
+    return create_file(file_owner(), (char*)argv[0]);
+}
+
+static int64_t sys_write_file(int64_t* argv)
+{
+    return write_file(file_owner(), argv[0], (void*)argv[1], argv[2]);
+}
+
+static int64_t sys_remove_file(int64_t* argv)
+{
+    return remove_file((char*)argv[0]);
+}
+
+static int64_t sys_pipe(int64_t* argv)
+{
+    return create_pipe(file_owner(), (int*)argv[0]);
+}
+
+static int64_t sys_dup2(int64_t* argv)
+{
+    return dup_file(file_owner(), argv[0], argv[1]);
+}
+
+static int64_t sys_sendfile(int64_t* argv)
+{
+    return send_file(file_owner(), argv[0], argv[1], (uint32_t*)argv[2], argv[3]);
+}
+
+static int64_t sys_readv(int64_t* argv)
+{
+    uint32_t size = read_vec(file_owner(), argv[0], (struct IoVec*)argv[1], argv[2]);
+    return size == UINT32_MAX ? -1 : (int64_t)size;
+}
+
+static int64_t sys_writev(int64_t* argv)
+{
+    uint32_t size = write_vec(file_owner(), argv[0], (struct IoVec*)argv[1], argv[2]);
+    return size == UINT32_MAX ? -1 : (int64_t)size;
 }
 
 static int64_t sys_fork(int64_t* argv)
@@ -94,9 +143,31 @@ static int64_t sys_exec(int64_t* argv)
     return exec(get_curr_process(), (char*)argv[0], (const char**)argv[1]);
 }
 
+static int64_t sys_spawn(int64_t* argv)
+{
+    return spawn(file_owner(), (char*)argv[0], (const char**)argv[1], (const char**)argv[2], (const struct SpawnActions*)argv[3]);
+}
+
+static int64_t sys_thread_create(int64_t* argv)
+{
+    return clone_thread(get_curr_process(), argv[0], argv[1], argv[2], (int*)argv[3]);
+}
+
+static int64_t sys_futex(int64_t* argv)
+{
+    return futex(get_curr_process(), (uint32_t*)argv[0], argv[1], argv[2]);
+}
+
 static int64_t sys_keyboard_read(int64_t* argv)
 {
     struct Process* curr_process = get_curr_process();
+    char ch;
+    /* Read from the file or pipe the standard input is redirected to instead of the keyboard. Return 0 at end of file */
+    if (file_owner()->fd_table[STDIN_FILENO] != NULL){
+        if (read_file(file_owner(), STDIN_FILENO, &ch, 1) != 1)
+            return 0;
+        return ch;
+    }
     /* If the process waiting for keyboard input is not a foreground process, put it to sleep */
     if (curr_process->daemon)
         sleep(DAEMON_INPUT);
@@ -127,7 +198,8 @@ static int64_t sys_read_root_dir(int64_t* argv)
 
 static int64_t sys_get_ppid(int64_t* argv)
 {
-    return get_curr_process()->ppid;
+    /* Threads are not kept in step when the process they belong to changes parent */
+    return get_group_leader(get_curr_process())->ppid;
 }
 
 static int64_t sys_active_procs(int64_t* argv)
@@ -150,6 +222,40 @@ static int64_t sys_proc_data(int64_t* argv)
     return get_proc_data(argv[0], (int*)argv[1], (int*)argv[2], (int*)argv[3], (char*)argv[4], (char*)argv[5]);
 }
 
+static int64_t sys_proc_snapshot(int64_t* argv)
+{
+    /* Selection of processes is the same as the active process ID list */
+    struct Process* process = NULL;
+    if (argv[2] == 0)
+        process = get_process(get_curr_process()->ppid);
+    else if (argv[2] == 2)
+        process = get_curr_process();
+    if (process == NULL && argv[2] != 1)
+        return -1;
+    return get_proc_snapshot(process, (struct ProcInfo*)argv[0], argv[1], argv[2] > 1 ? 0 : argv[2]);
+}
+
+static int64_t sys_sched_yield(int64_t* argv)
+{
+    yield();
+    return 0;
+}
+
+static int64_t sys_getpriority(int64_t* argv)
+{
+    /* Only process priorities are supported. Process groups and users have none */
+    if (argv[0] != PRIO_PROCESS)
+        return INT32_MAX;
+    return get_priority(get_curr_process(), argv[1]);
+}
+
+static int64_t sys_setpriority(int64_t* argv)
+{
+    if (argv[0] != PRIO_PROCESS)
+        return -1;
+    return set_priority(get_curr_process(), argv[1], argv[2]);
+}
+
 static int64_t sys_pctrl(int64_t* argv)
 {
     struct Process* process = find_job(argv[0], get_curr_process()->ppid);
@@ -171,6 +277,11 @@ static int64_t sys_kill(int64_t* argv)
     return kill(get_curr_process(), argv[0], argv[1]);
 }
 
+static int64_t sys_sigprocmask(int64_t* argv)
+{
+    return sigprocmask(get_curr_process(), argv[0], (const uint32_t*)argv[1], (uint32_t*)argv[2]);
+}
+
 static int64_t sys_signal(int64_t* argv)
 {
     register_handler(get_curr_process(), argv[0], (SIGHANDLER)argv[1]);
@@ -243,19 +354,161 @@ static int64_t sys_switchpenv(int64_t* argv)
     return 0;
 }
 
+/* Whether a buffer lies entirely in the user page holding the program, its stack and heap */
+static bool user_buffer(uint64_t addr, uint64_t size)
+{
+    return addr >= USERSPACE_BASE && size <= PAGE_SIZE && addr <= USERSPACE_BASE + PAGE_SIZE - size && (addr & 7) == 0;
+}
+
+static bool ring_valid(uint32_t entries, uint64_t sqes, uint64_t cqes)
+{
+    if (entries == 0 || entries > RING_ENTRIES_MAX || (entries & (entries - 1)) != 0)
+        return false;
+    return user_buffer(sqes, entries * sizeof(struct RingSubmission)) && user_buffer(cqes, entries * sizeof(struct RingCompletion));
+}
+
+/* Calls which don't return to the caller, or replace or duplicate its memory, can't be run from a ring */
+static bool ring_op_allowed(int64_t op)
+{
+    if (op < 0 || op > TOTAL_SYSCALL_FUNCTIONS-1)
+        return false;
+    switch (op)
+    {
+    case 2: /* exit */
+    case 8: /* fork */
+    case 9: /* exec */
+    case 39: /* thread_create */
+    case 41: /* ring_setup */
+    case 42: /* ring_enter */
+        return false;
+    default:
+        return true;
+    }
+}
+
+static int64_t sys_ring_setup(int64_t* argv)
+{
+    struct Process* process = get_curr_process();
+    struct SyscallRing* ring = (struct SyscallRing*)argv[0];
+
+    /* A null ring unregisters the current one */
+    if (ring == NULL){
+        process->ring = 0;
+        return 0;
+    }
+    if (!user_buffer((uint64_t)ring, sizeof(struct SyscallRing)) || !ring_valid(ring->entries, ring->sqes, ring->cqes))
+        return -1;
+    process->ring = (uint64_t)ring;
+    return 0;
+}
+
+static int64_t sys_ring_enter(int64_t* argv)
+{
+    struct Process* process = get_curr_process();
+    struct SyscallRing* ring = (struct SyscallRing*)process->ring;
+    uint32_t to_submit = argv[0];
+    uint32_t submitted = 0;
+    struct RingSubmission* sqe;
+    struct RingCompletion* cqe;
+    int64_t op;
+
+    if (ring == NULL)
+        return -1;
+    /* The ring is in user memory, so its geometry is read once and checked again in case the process changed it */
+    uint32_t entries = ring->entries;
+    uint64_t sqes = ring->sqes;
+    uint64_t cqes = ring->cqes;
+    if (!ring_valid(entries, sqes, cqes))
+        return -1;
+
+    /* Run queued entries in order while there is room for their completions. A to_submit of 0 runs all of them */
+    while (ring->sq_head != ring->sq_tail && (to_submit == 0 || submitted < to_submit))
+    {
+        if (ring->cq_tail - ring->cq_head >= entries)
+            break;
+        sqe = (struct RingSubmission*)sqes + (ring->sq_head & (entries - 1));
+        cqe = (struct RingCompletion*)cqes + (ring->cq_tail & (entries - 1));
+        cqe->user_data = sqe->user_data;
+        /* The op is read once since threads sharing the memory may rewrite the entry. The arguments are read from the entry
+           in user memory as the argument array of the older calling convention is */
+        op = sqe->op;
+        cqe->result = ring_op_allowed(op) ? syscall_list[op](sqe->args) : -1;
+        ring->sq_head++;
+        ring->cq_tail++;
+        submitted++;
+        /* An op may have slept. Return early for a signal which arrived meanwhile to be delivered. The rest stay queued */
+        if (process->signals || process->state == KILLED)
+            break;
+    }
+
+    return submitted;
+}
+
+static int64_t sys_getrusage(int64_t* argv)
+{
+    if (!user_buffer(argv[1], sizeof(struct Rusage)))
+        return -1;
+    return get_rusage(get_curr_process(), argv[0], (struct Rusage*)argv[1]);
+}
+
+/* Load averages over 1, 5 and 15 minutes in hundredths */
+static int64_t sys_getloadavg(int64_t* argv)
+{
+    if (!user_buffer(argv[0], 3 * sizeof(uint64_t)))
+        return -1;
+    get_load_avg((uint64_t*)argv[0]);
+    return 0;
+}
+
+static void dispatch(struct ContextFrame* ctx, int abi)
+{
+    /* Get the index number of the systemcall from x8 */
+    int64_t index = ctx->x8;
+    int64_t* argv;
+
+    /* If not a valid syscall, return an error code -1 */
+    if (index < 0 || index > TOTAL_SYSCALL_FUNCTIONS-1){
+        ctx->x0 = -1;
+        return;
+    }
+    if (abi == SVC_REGISTER_ABI || abi == SVC_FULL_ENTRY_ABI){
+        /* The saved x0-x5 lie in order at the start of the context frame and serve as the argument array as they are
+           Nothing is read from user memory */
+        argv = &ctx->x0;
+    }
+    else{
+        /* Get the argument count from x0 and the pointer to arguments passed to the function in user memory from x1 */
+        if (ctx->x0 < 0){
+            ctx->x0 = -1;
+            return;
+        }
+        argv = (int64_t*)ctx->x1;
+    }
+
+    /* Call the system function associated with the index provided from the user program.
+       Save the return value in register x0 position in the context frame on the stack, keeping the x0 it replaces for a restart */
+    get_curr_process()->syscall_x0 = ctx->x0;
+    ctx->x0 = syscall_list[index](argv);
+}
+
 static void sigproxy_restore(struct ContextFrame *ctx)
 {
     struct Process* process = get_curr_process();
-    int64_t* sp0 = (int64_t*)ctx->sp0;
-    /* Restore the overwritten values in registers x1 and x8, and previous EL0 program counter */
-    ctx->x1 = sp0[0];
-    ctx->x8 = sp0[1];
+    int64_t* regs = (int64_t*)ctx->sp0;
+    int64_t* sp0 = regs + SIGNAL_CONTEXT_SIZE / 8;
+    /* The context may have been interrupted anywhere rather than at a syscall, hence all GPRs saved by the proxy handler are restored
+       along with the previous EL0 program counter */
+    memcpy(&ctx->x0, regs, 31 * sizeof(int64_t));
     ctx->elr = sp0[2];
+    /* The FP/SIMD registers of the interrupted context if it had used them, else the handler's are dropped */
+    fp_restore_signal(process, sp0[5] ? (struct FpState*)(sp0 + SIGNAL_FRAME_SIZE / 8) : NULL);
     /* Reclaim space on the stack used to save proxy handler and proxy restore arguments */
-    ctx->sp0 += 24;
-    /* Restart the interrupted syscall */
-    if (process->event != NONE)
-        system_call(ctx);
+    ctx->sp0 += SIGNAL_CONTEXT_SIZE + SIGNAL_FRAME_SIZE + (sp0[5] ? sizeof(struct FpState) : 0);
+    /* Restart the interrupted syscall with the x0 it was made with, in the calling convention it was made in */
+    if (process->event != NONE){
+        ctx->x0 = sp0[3];
+        dispatch(ctx, sp0[4] & SVC_IMM_MASK);
+    }
 }
 
 void init_system_call(void)
@@ -286,29 +539,37 @@ void init_system_call(void)
     syscall_list[23] = sys_unsetenv;
     syscall_list[24] = sys_getfullenv;
     syscall_list[25] = sys_switchpenv;
+    syscall_list[26] = sys_create_file;
+    syscall_list[27] = sys_write_file;
+    syscall_list[28] = sys_remove_file;
+    syscall_list[29] = sys_pipe;
+    syscall_list[30] = sys_dup2;
+    syscall_list[31] = sys_sendfile;
+    syscall_list[32] = sys_readv;
+    syscall_list[33] = sys_writev;
+    syscall_list[34] = sys_proc_snapshot;
+    syscall_list[35] = sys_sched_yield;
+    syscall_list[36] = sys_getpriority;
+    syscall_list[37] = sys_setpriority;
+    syscall_list[38] = sys_spawn;
+    syscall_list[39] = sys_thread_create;
+    syscall_list[40] = sys_futex;
+    syscall_list[41] = sys_ring_setup;
+    syscall_list[42] = sys_ring_enter;
+    syscall_list[43] = sys_sigprocmask;
+    syscall_list[44] = sys_getrusage;
+    syscall_list[45] = sys_getloadavg;
 }
 
-void system_call(struct ContextFrame *ctx)
+/* Returns whether the syscall rewrote the whole user context in the frame, as a signal handler restore and an exec do */
+bool system_call(struct ContextFrame *ctx)
 {
-    /* Retrieve data from the stack in user mode */
-    /* Get the index number of the systemcall from the stack */
-    int64_t index = ctx->x8;
-    /* Get the argument count from x0 on the stack */
-    int64_t argc = ctx->x0;
-    /* Get the pointer to arguments passed to the function */
-    int64_t* argv = (int64_t*)ctx->x1;
-
-    if (index == SIG_PROXY_REQUEST){
+    if (ctx->x8 == SIG_PROXY_REQUEST){
         sigproxy_restore(ctx);
-        return;
+        return true;
     }
-    /* If not a valid syscall, return an error code -1 */
-    if (argc < 0 || (index < 0 || index > TOTAL_SYSCALL_FUNCTIONS-1)){
-        ctx->x0 = -1;
-        return;
-    }
-
-    /* Call the system function associated with the index provided from the user program.
-       Save the return value in register x0 position in the context frame on the stack */
-    ctx->x0 = syscall_list[index](argv);
+    bool new_image = ctx->x8 == 9; /* exec */
+    /* The svc immediate tells the calling convention. Programs built against the older library trap with svc #0 */
+    dispatch(ctx, ctx->esr & SVC_IMM_MASK);
+    return new_image;
 }
@@ -23,9 +23,49 @@
 
 typedef int64_t (*SYSTEMCALL)(int64_t *argv);
 void init_system_call(void);
-void system_call(struct ContextFrame* ctx);
+bool system_call(struct ContextFrame* ctx);
+bool svc_handler(struct ContextFrame* ctx);
 
-#define TOTAL_SYSCALL_FUNCTIONS 26
+#define TOTAL_SYSCALL_FUNCTIONS 46
+
+/* Calling conventions told apart by the svc immediate, found in the lower 16 bits of the exception syndrome
+   The register ABI passes up to 6 arguments in x0-x5. The older one passes the argument count in x0 and a pointer to the arguments in x1 */
+#define SVC_IMM_MASK            0xffff
+#define SVC_ARGV_ABI            0
+#define SVC_REGISTER_ABI        1
+/* The register ABI taken through the full kernel entry and exit rather than the lean SVC path */
+#define SVC_FULL_ENTRY_ABI      2
+
+#define RING_ENTRIES_MAX        256
+
+/* Batched syscall ring in the memory of a process. Layout matches struct sys_ring in the user library
+   The process fills submission entries and advances sq_tail. ring_enter runs the queued entries in order, advancing sq_head,
+   and posts a completion for each at cq_tail which the process consumes by advancing cq_head. Both queues hold entries (a power of 2) slots */
+struct SyscallRing
+{
+    uint32_t sq_head;
+    uint32_t sq_tail;
+    uint32_t cq_head;
+    uint32_t cq_tail;
+    uint32_t entries;
+    uint32_t reserved;
+    uint64_t sqes; /* User address of the submission entries */
+    uint64_t cqes; /* User address of the completion entries */
+};
+
+/* A syscall queued on the ring. The op is the syscall number and args are passed as they would be in x0-x5 */
+struct RingSubmission
+{
+    int64_t op;
+    int64_t args[6];
+    uint64_t user_data; /* Copied to the completion to tell it apart */
+};
+
+struct RingCompletion
+{
+    uint64_t user_data;
+    int64_t result; /* Return value of the syscall. -1 for an op which can't be run from a ring */
+};
 
 /* Special request codes. DO NOT map these to regular syscall numbers */
 #define SIG_PROXY_REQUEST       101
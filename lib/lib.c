@@ -245,6 +245,37 @@ bool empty(const struct List *list)
     return list->head == NULL;
 }
 
+void link_append(struct Link *head, struct Link *node)
+{
+    if (head->next == NULL){
+        head->prev = head;
+        head->next = head;
+    }
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+void link_remove(struct Link *node)
+{
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    /* Clear the links so that the node reads as not being on any list */
+    node->prev = NULL;
+    node->next = NULL;
+}
+
+bool link_empty(const struct Link *head)
+{
+    return head->next == NULL || head->next == head;
+}
+
+bool link_linked(const struct Link *node)
+{
+    return node->next != NULL;
+}
+
 #ifdef DEBUG
 void print_list(const struct List* list, const char* name)
 {
@@ -272,3 +303,36 @@ int strlen(const char *str)
     }
     return len;
 }
+
+void spin_lock(struct Spinlock *lock)
+{
+    int cpu = get_cpu_id();
+    uint32_t ticket = 0;
+
+    /* Take a ticket one higher than any ticket held by the other cores */
+    lock->choosing[cpu] = true;
+    memory_barrier();
+    for (int i = 0; i < MAX_CPUS; i++)
+    {
+        if (lock->number[i] > ticket)
+            ticket = lock->number[i];
+    }
+    lock->number[cpu] = ticket + 1;
+    memory_barrier();
+    lock->choosing[cpu] = false;
+    memory_barrier();
+
+    /* Wait for every core holding a lower ticket to go first. Equal tickets are ordered by core number */
+    for (int i = 0; i < MAX_CPUS; i++)
+    {
+        while (lock->choosing[i]);
+        while (lock->number[i] != 0 && (lock->number[i] < lock->number[cpu] || (lock->number[i] == lock->number[cpu] && i < cpu)));
+    }
+    memory_barrier();
+}
+
+void spin_unlock(struct Spinlock *lock)
+{
+    memory_barrier();
+    lock->number[get_cpu_id()] = 0;
+}
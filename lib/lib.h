@@ -26,6 +26,7 @@
 #define MAX_KEY_LEN 64
 #define MAX_VAL_LEN 128
 #define HASH_TABLE_SIZE 101
+#define MAX_CPUS 4
 
 struct Node
 {
@@ -38,6 +39,14 @@ struct List
     struct Node* tail;
 };
 
+/* Node of an intrusive circular doubly linked list. A list head is a node of its own which is linked to itself when empty
+   A zeroed head also reads as empty, so that heads in statically allocated or cleared structures need no set up */
+struct Link
+{
+    struct Link* prev;
+    struct Link* next;
+};
+
 struct MapEntry
 {
     char key[MAX_KEY_LEN];
@@ -50,7 +59,18 @@ struct Map
     struct MapEntry table[HASH_TABLE_SIZE];
 };
 
+/* Lamport's bakery lock. It only relies on ordinary loads and stores ordered by barriers
+   The kernel runs with the data cache disabled, where the exclusive load and store instructions are not reliable on real hardware */
+struct Spinlock
+{
+    volatile bool choosing[MAX_CPUS];
+    volatile uint32_t number[MAX_CPUS]; /* Ticket of each core. 0 means the core is not contending */
+};
+
 unsigned char get_el(void);
+int get_cpu_id(void);
+void memory_barrier(void);
+int first_set_bit(uint64_t value);
 void delay(uint64_t value);
 void out_word(uint64_t addr, uint32_t value);
 uint32_t in_word(uint64_t addr);
@@ -68,10 +88,17 @@ struct Node* back(const struct List* list);
 bool contains(const struct List* list, const struct Node* node);
 struct Node *find(const struct Node *head, const struct Node *node);
 bool empty(const struct List* list);
+void link_append(struct Link* head, struct Link* node);
+void link_remove(struct Link* node);
+bool link_empty(const struct Link* head);
+bool link_linked(const struct Link* node);
 #ifdef DEBUG
 void print_list(const struct List* list, const char* name);
 #endif
 
+void spin_lock(struct Spinlock* lock);
+void spin_unlock(struct Spinlock* lock);
+
 /* Special functions for managing the process queues based on event occurence */
 struct Node* remove_evt(struct List* list, struct Node** const from, int event);
 struct Node* find_evt(const struct Node* head, int event);
@@ -24,6 +24,9 @@
 .global memmove
 .global memcmp
 .global get_el
+.global get_cpu_id
+.global memory_barrier
+.global first_set_bit
 
 get_el:
     # Read the currentel system register for current exception level (ELO-EL3) and save it in x0 register
@@ -32,6 +35,24 @@ get_el:
     lsr x0, x0, #2
     ret
 
+get_cpu_id:
+    # The lower 2 bits of the multiprocessor affinity register hold the number of the core (0-3) in the cluster
+    mrs x0, mpidr_el1
+    and x0, x0, #3
+    ret
+
+memory_barrier:
+    # (Data memory barrier) Memory accesses before this instruction are observed by all cores before those after it
+    dmb sy
+    ret
+
+first_set_bit:
+    # x0 => non zero value. Returns the index of its lowest set bit
+    # Reverse the bits so that counting the leading zeros yields the count of trailing zeros of the original value
+    rbit x0, x0
+    clz x0, x0
+    ret
+
 delay:
     # First arg will be present in register x0 which will be subtracted till it becomes 0
     subs x0, x0, #1
@@ -34,6 +34,48 @@
    Thus, the position of FAT16 image start and kernel end on disk (disk_img_end) can be correctly determined  */
 int dummy_glob = 30;
 
+/* Kernel stack tops of the secondary cores indexed by core number. Read by each core in boot.s before it can use a stack
+   All of them are set before the first core is released, so that a core coming up late still finds its own */
+uint64_t cpu_stacks[MAX_CPUS];
+static volatile int cpus_online = 1;
+
+void start_cpu(int cpu, uint64_t entry);
+void secondary_entry(void);
+
+void secondary_main(void)
+{
+    lock_kernel();
+    init_cpu_process();
+    init_cpu_timer();
+    /* The core starts out idle and takes no ticks until work is queued on it */
+    set_tick_mode(true);
+    printk("CPU%d online\n", get_cpu_id());
+    cpus_online++;
+    unlock_kernel();
+    enable_irq();
+}
+
+/* Release the secondary cores parked in the spin table one at a time. Each one runs on its share of a single page for a stack */
+static void init_smp(void)
+{
+    uint64_t stacks = (uint64_t)kalloc();
+    ASSERT(stacks != 0);
+
+    for (int cpu = 1; cpu < MAX_CPUS; cpu++)
+        cpu_stacks[cpu] = stacks + (cpu * PAGE_SIZE / MAX_CPUS);
+    memory_barrier();
+    for (int cpu = 1; cpu < MAX_CPUS; cpu++)
+    {
+        int online = cpus_online;
+        start_cpu(cpu, TO_PHY(secondary_entry));
+        /* Give up on the core if it doesn't come up in time e.g. the firmware didn't park it in the spin table */
+        for (int wait = 0; wait < 100 && cpus_online == online; wait++)
+            delay(100000);
+        if (cpus_online == online)
+            printk("CPU%d failed to start\n", cpu);
+    }
+}
+
 void kmain(void)
 {
     printk("\nStarting kernel ...\n");
@@ -43,8 +85,9 @@ void kmain(void)
     init_system_call();
     init_timer();
     init_interrupt_controller();
-    enable_irq();
     init_process();
+    init_smp();
+    enable_irq();
 }
 
 void shutdown_banner(void)
@@ -26,6 +26,11 @@
 static struct Page free_mem_head = {
     .next = NULL
 };
+static uint64_t free_pages;
+static uint64_t total_pages;
+static uint64_t kernel_data; /* Page of data published to user mode. See struct KernelData */
+/* Guards the free page list which all cores allocate from */
+static struct Spinlock kmem_lock;
 /* The symbol used in linker script whose address will mark the end of kernel in the virt address space */
 extern char kern_end;
 void load_gdt(uint64_t map);
@@ -42,8 +47,10 @@ static void free_region(uint64_t start, uint64_t end)
 
 void *kalloc(void)
 {
-    struct Page* page = free_mem_head.next;
-    
+    struct Page* page;
+
+    spin_lock(&kmem_lock);
+    page = free_mem_head.next;
     if (page != NULL){
         /* Assert that the virtual address is page aligned */
         ASSERT((uint64_t)page % PAGE_SIZE == 0);
@@ -53,7 +60,9 @@ void *kalloc(void)
         ASSERT((uint64_t)page + PAGE_SIZE <= MEMORY_END);
 
         free_mem_head.next = page->next;
+        free_pages--;
     }
+    spin_unlock(&kmem_lock);
     
     return page;
 }
@@ -92,8 +101,21 @@ void kfree(uint64_t addr)
 
     /* Add the page to the linked list of free pages just after the head */
     struct Page* page_addr = (struct Page*)addr;
+    spin_lock(&kmem_lock);
     page_addr->next = free_mem_head.next;
     free_mem_head.next = page_addr;
+    free_pages++;
+    spin_unlock(&kmem_lock);
+}
+
+uint64_t get_free_pages(void)
+{
+    return free_pages;
+}
+
+uint64_t get_total_pages(void)
+{
+    return total_pages;
 }
 
 static uint64_t* find_gdt_entry(uint64_t map, uint64_t virt_addr, int alloc_new, uint64_t attr)
@@ -203,6 +225,23 @@ static void free_tables(uint64_t map)
     kfree(map);
 }
 
+/* Count the pages in use by a process. The page holding its page tables and kernel stack plus the mapped user pages */
+uint64_t get_resident_pages(uint64_t map)
+{
+    uint64_t pages = 1;
+    uint64_t regions[] = {USERSPACE_BASE, USERSPACE_EXT};
+    uint64_t* mdt_table;
+
+    for (int i = 0; i < sizeof(regions)/sizeof(regions[0]); i++)
+    {
+        mdt_table = find_udt_entry(map, regions[i], 0, 0);
+        if (mdt_table != NULL && (mdt_table[(regions[i] >> 21) & 0x1ff] & ENTRY_VALID))
+            pages++;
+    }
+
+    return pages;
+}
+
 /* Function to free user space memory */
 void free_uvm(uint64_t map)
 {
@@ -232,16 +271,19 @@ bool setup_uvm(struct Process* process, char* program_filename)
             /* Map extended page to userspace virtual address space */
             if (!map_page(map, USERSPACE_EXT, TO_PHY(process->env), ENTRY_VALID | USER_MODE | NORMAL_MEMORY | ENTRY_ACCESSED))
                 goto out;
+            if (!map_page(map, USERSPACE_DATA, TO_PHY(kernel_data), ENTRY_VALID | USER_MODE | READ_ONLY | NORMAL_MEMORY | ENTRY_ACCESSED))
+                goto out;
             /* Save the mapped userspace extended virtual address to process table. The TTBR0_EL1 register will take care of translation */
             process->env = USERSPACE_EXT;
             return true;
         }
         kfree((uint64_t)proc_page);
-        return false;
     }
 
 out:
-    free_uvm(map);
+    /* The page tables are released on any failure. The environment page stays with the caller, which allocated it */
+    free_page(map, USERSPACE_BASE);
+    free_tables(map);
     return false;
 }
 
@@ -278,6 +320,8 @@ bool copy_uvm(struct Process* process, uint64_t src_map, char* src_program_filen
             /* Map extended page to userspace virtual address space */
             if (!map_page(process->page_map, USERSPACE_EXT, TO_PHY(process->env), ENTRY_VALID | USER_MODE | NORMAL_MEMORY | ENTRY_ACCESSED))
                 goto out;
+            if (!map_page(process->page_map, USERSPACE_DATA, TO_PHY(kernel_data), ENTRY_VALID | USER_MODE | READ_ONLY | NORMAL_MEMORY | ENTRY_ACCESSED))
+                goto out;
             return true;
         }
         kfree((uint64_t)proc_page);
@@ -295,9 +339,19 @@ void switch_vm(uint64_t map)
     load_gdt(TO_PHY(map));
 }
 
+/* Kernel virtual address of the data page mapped read-only into every process. It is shared, hence never freed with a process */
+uint64_t get_kernel_data(void)
+{
+    return kernel_data;
+}
+
 void init_mem(void)
 {
     /* Free region from end of the kernel to allocated memory end for the kernel */
     free_region((uint64_t)&kern_end, MEMORY_END);
+    total_pages = free_pages;
+    kernel_data = (uint64_t)kalloc();
+    ASSERT(kernel_data != 0);
+    memset((void*)kernel_data, 0, PAGE_SIZE);
     //checkmem();
 }
\ No newline at end of file
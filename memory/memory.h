@@ -31,6 +31,7 @@ struct Page
 #define KERNEL_BASE     0xffff000000000000  /* Kernel base virtual address */
 #define USERSPACE_BASE  0x0000000000400000  /* Userspace base virtual address */
 #define USERSPACE_EXT   0x0000000000600000  /* Userspace extended virtual address base */
+#define USERSPACE_DATA  0x0000000000800000  /* Userspace virtual address of the read-only kernel data page */
 
 #define TO_VIRT(physical_addr)  ((uint64_t)physical_addr + KERNEL_BASE)
 #define TO_PHY(virt_addr)       ((uint64_t)virt_addr - KERNEL_BASE)
@@ -61,16 +62,21 @@ struct Page
 #define NORMAL_MEMORY   (1 << 2)
 #define DEVICE_MEMORY   (0 << 2)
 #define USER_MODE       (1 << 6)
+#define READ_ONLY       (1 << 7)
 
 struct Process;
 
 void* kalloc(void);
 void kfree(uint64_t addr);
+uint64_t get_free_pages(void);
+uint64_t get_total_pages(void);
+uint64_t get_resident_pages(uint64_t map);
 void init_mem(void);
 void free_uvm(uint64_t map);
 bool setup_uvm(struct Process* process, char* program_filename);
 bool copy_uvm(struct Process* process, uint64_t src_map, char* src_program_filename);
 void switch_vm(uint64_t map);
+uint64_t get_kernel_data(void);
 uint64_t read_gdt(void);
 
 #endif
\ No newline at end of file
@@ -69,6 +69,8 @@ enable_mmu:
     ret
 
 setup_vm:
+    # x0 => physical end of the memory holding the kernel and the filesystem. Saved in x5 as x0 is reused below
+    mov x5, x0
 setup_kvm:
     # Save the kernel global and upper directory page tables
     adr x0, pgd_ttbr1
@@ -86,8 +88,8 @@ setup_kvm:
     # Save address of middle directory table to upper directory entry
     str x1, [x0]
 
-    # Save the memory end to x2 which includes the kernel and filesystem (0x30000000 - 0x34000000) on physical memory
-    mov x2, #0x34000000
+    # Save the memory end to x2 which includes the kernel and filesystem (0x30000000 onwards, sized by the disk image) on physical memory
+    mov x2, x5
     adr x1, pmd_ttbr1
     # Kernel space is mapped to virtual address space with upper 16 bits set to high (0xFFFF000000000000)
     # This is being mapped to physical address 0
@@ -21,53 +21,216 @@
 #include <debug/debug.h>
 #include <stddef.h>
 #include <io/print.h>
+#include <kernel.h>
+
+uint64_t read_timer_count(void);
 
 static struct Process process_table[PROC_TABLE_SIZE];
-static int pid_num = 1;
+/* The first process table slot holds the idle process of the boot core. Secondary cores keep theirs outside the table
+   so that table walks, which skip the first slot, never come across them */
+static struct Process secondary_idle[MAX_CPUS-1];
+/* Free slots of the process table stacked for constant time allocation */
+static struct Process* free_slots[PROC_TABLE_SIZE];
+static int free_count = 0;
+/* Bitmap of PIDs in use. A PID stays taken until its table slot is released, zombie or not */
+static uint64_t pid_map[PID_MAX / 64];
+static int next_pid = 1;
+/* Indexes of the process table by PID and by parent and job specification */
+static struct Process* pid_hash[PID_HASH_SIZE];
+static struct Process* job_hash[PID_HASH_SIZE];
 static struct ProcessControl pc;
+/* Wait queues of the scheduler events starting at SLEEP_SYSCALL. Child state changes and pipes have queues of their own */
+static struct WaitQueue event_queues[FG_PAUSED - NONE];
+/* Processes in a timed sleep kept as a binary min-heap on their deadline, so that a tick only looks at the earliest one */
+static struct Process* timer_heap[PROC_TABLE_SIZE];
+static int timer_count = 0;
+/* Futex waiters hashed on the page map and user address of the futex. Threads of a process share the page map hence the futex */
+static struct WaitQueue futex_queues[FUTEX_HASH_SIZE];
+/* FP/SIMD registers of the processes in the table, valid for those which have used them */
+static struct FpState fp_states[PROC_TABLE_SIZE];
 static bool shutdown = false;
+/* Fixed point averages of the count of runnable processes over 1, 5 and 15 minutes, and the tick of the next sample */
+static uint64_t load_avg[3];
+static const uint64_t load_exp[3] = {LOAD_EXP_1, LOAD_EXP_5, LOAD_EXP_15};
+static uint64_t next_load_tick = LOAD_FREQ;
 
-static struct Process* find_unused_slot(void)
+static struct Cpu* this_cpu(void)
 {
-    struct Process* process = NULL;
-    /* The first process slot is reserved only for the idle process */
-    for (int i = 1; i < PROC_TABLE_SIZE; i++)
+    return pc.cpus + get_cpu_id();
+}
+
+/* Take the first free PID after the last one handed out, wrapping around at PID_MAX. Fully used words of the bitmap are skipped whole */
+static int alloc_pid(void)
+{
+    int pid = next_pid;
+    uint64_t free_bits;
+
+    for (int scanned = 0; scanned < PID_MAX + 64; scanned += 64 - pid % 64, pid = (pid & ~63) + 64)
     {
-        if (process_table[i].state == UNUSED){
-            process = process_table + i;
-            memset(process, 0, sizeof(struct Process));
-            break;
+        if (pid >= PID_MAX)
+            pid = 0;
+        free_bits = ~pid_map[pid / 64] & (~0UL << (pid % 64));
+        if (free_bits != 0){
+            pid = (pid & ~63) + first_set_bit(free_bits);
+            pid_map[pid / 64] |= (1UL << (pid % 64));
+            next_pid = pid + 1;
+            return pid;
         }
     }
-    
+    return -1;
+}
+
+static struct Process** pid_bucket(int pid)
+{
+    return pid_hash + (pid & (PID_HASH_SIZE - 1));
+}
+
+static struct Process** job_bucket(int ppid, int job_spec)
+{
+    return job_hash + ((ppid * 31 + job_spec) & (PID_HASH_SIZE - 1));
+}
+
+/* Unlink a process from a hash bucket chained through the member at the given offset */
+static void unhash(struct Process** bucket, struct Process* process, size_t next_offset)
+{
+    struct Process** link = bucket;
+
+    while (*link != NULL && *link != process)
+        link = (struct Process**)((char*)*link + next_offset);
+    if (*link != NULL)
+        *link = *(struct Process**)((char*)process + next_offset);
+}
+
+static void add_usage(struct CpuUsage* total, const struct CpuUsage* usage)
+{
+    total->utime += usage->utime;
+    total->stime += usage->stime;
+    total->wait_time += usage->wait_time;
+    total->nvcsw += usage->nvcsw;
+    total->nivcsw += usage->nivcsw;
+}
+
+/* Convert system counter increments to microseconds. Whole seconds are split off first to keep the product from overflowing */
+static uint64_t to_usec(uint64_t count)
+{
+    uint64_t freq = ((struct KernelData*)get_kernel_data())->timer_freq;
+
+    if (freq == 0)
+        return 0;
+    return (count / freq) * 1000000 + (count % freq) * 1000000 / freq;
+}
+
+/* Refresh the record of a process on the kernel data page and return its user address. Idle processes run only in the kernel and have no record */
+static uint64_t publish_record(struct Process* process)
+{
+    struct KernelData* data = (struct KernelData*)get_kernel_data();
+    int slot = process - process_table;
+
+    if (process <= process_table || process >= process_table + PROC_TABLE_SIZE)
+        return 0;
+    data->records[slot].pid = process->pid;
+    data->records[slot].ppid = get_group_leader(process)->ppid;
+    return USERSPACE_DATA + offsetof(struct KernelData, records) + slot * sizeof(struct ProcRecord);
+}
+
+/* Put a process on the children or zombies list of its parent, taking it off that of the previous one */
+static void link_child(struct Process* process)
+{
+    struct Process* parent;
+
+    if (link_linked(&process->sibling))
+        link_remove(&process->sibling);
+    if (process->tgid != process->pid)
+        return;
+    parent = get_process(process->ppid);
+    if (parent != NULL)
+        link_append(process->zombie ? &parent->zombies : &parent->children, &process->sibling);
+}
+
+/* Change the parent or job specification of a process, keeping the job index and the child lists in step. Only processes with a job specification are indexed */
+static void set_job(struct Process* process, int ppid, int job_spec)
+{
+    struct Process** bucket;
+    bool new_parent = process->ppid != ppid;
+
+    if (process->job_spec)
+        unhash(job_bucket(process->ppid, process->job_spec), process, offsetof(struct Process, job_next));
+    process->ppid = ppid;
+    if (new_parent)
+        link_child(process);
+    process->job_spec = job_spec;
+    if (job_spec){
+        bucket = job_bucket(ppid, job_spec);
+        process->job_next = *bucket;
+        *bucket = process;
+    }
+    publish_record(process);
+}
+
+void assign_job(struct Process* parent, struct Process* process)
+{
+    parent->jobs++;
+    set_job(process, process->ppid, parent->jobs);
+}
+
+static struct Process* find_unused_slot(void)
+{
+    struct Process* process;
+
+    /* The first process slot is reserved only for the idle process and never enters the free list */
+    if (free_count == 0)
+        return NULL;
+    process = free_slots[--free_count];
+    /* A released slot has all its files closed, which leaves the file descriptor table cleared already */
+    memset(process, 0, offsetof(struct Process, fd_table));
+    memset(&process->reg_context, 0, sizeof(struct Process) - offsetof(struct Process, reg_context));
+
     return process;
 }
 
-static struct Process* alloc_new_process(void)
+/* Return a process table slot to the free list along with its PID */
+static void free_slot(struct Process* process)
+{
+    unhash(pid_bucket(process->pid), process, offsetof(struct Process, pid_next));
+    if (process->job_spec)
+        unhash(job_bucket(process->ppid, process->job_spec), process, offsetof(struct Process, job_next));
+    pid_map[process->pid / 64] &= ~(1UL << (process->pid % 64));
+    if (link_linked(&process->sibling))
+        link_remove(&process->sibling);
+    process->state = UNUSED;
+    free_slots[free_count++] = process;
+}
+
+static struct Process* alloc_slot(void)
 {
     struct Process* process;
 
     process = find_unused_slot();
     if (process == NULL)
         return NULL;
-
+    /* Assign a PID and index the process by it. Processes may share the same table slot but never the same PID number at a time */
+    process->pid = alloc_pid();
+    if (process->pid < 0){
+        free_slots[free_count++] = process;
+        return NULL;
+    }
+    process->pid_next = *pid_bucket(process->pid);
+    *pid_bucket(process->pid) = process;
+    process->tgid = process->pid;
     memset(process->name, 0, sizeof(process->name));
-    /* Allocate memory for the process page table, kernel stack and heap */
-    process->page_map = (uint64_t)kalloc();
-    ASSERT(process->page_map != 0);
-    memset((void*)process->page_map, 0, PAGE_TABLE_SIZE);
+
+    return process;
+}
+
+/* Lay out the kernel stack and heap at the top of the given page and prepare the first return to user mode */
+static void init_kernel_stack(struct Process* process, uint64_t page)
+{
     /* The kernel stack will reside at the top of the allocated page. Heap starts after the stack */
-    process->stack = (uint64_t)(process->page_map + PAGE_SIZE - STACK_SIZE);
-    process->heap = (uint64_t)(process->page_map + PAGE_SIZE - STACK_SIZE - HEAP_SIZE);
-    /* Allocate extended memory for holding the process environment, heap and shared memory */
-    process->env = (uint64_t)kalloc();
-    ASSERT(process->env != 0);
-    memset((void*)process->env, 0, sizeof(struct Map));
+    process->stack = (uint64_t)(page + PAGE_SIZE - STACK_SIZE);
+    process->heap = (uint64_t)(page + PAGE_SIZE - STACK_SIZE - HEAP_SIZE);
 
     process->state = INIT;
     process->event = NONE;
-    /* Assign a PID and increment the global PID counter. Processes may share the same table slot but never the same PID number */
-    process->pid = pid_num++;
     /* Get the context frame which is located at the top of the kernel stack */
     process->reg_context = (struct ContextFrame*)(process->stack + STACK_SIZE - sizeof(struct ContextFrame));
     /* Set the stack pointer to 12 GPRs below the context frame where the userspace context is saved */
@@ -84,23 +247,44 @@ static struct Process* alloc_new_process(void)
     process->reg_context->sp0 = USERSPACE_BASE + PAGE_SIZE;
     /* Set pstate mode field to 0 (EL0) and DAIF bits to 0 which means no masking of interrupts i.e. interrupts enabled */
     process->reg_context->spsr = 0;
+}
+
+static struct Process* alloc_new_process(void)
+{
+    struct Process* process;
+
+    process = alloc_slot();
+    if (process == NULL)
+        return NULL;
+    /* Allocate memory for the process page table, kernel stack and heap */
+    process->page_map = (uint64_t)kalloc();
+    ASSERT(process->page_map != 0);
+    memset((void*)process->page_map, 0, PAGE_TABLE_SIZE);
+    init_kernel_stack(process, process->page_map);
+    /* Allocate extended memory for holding the process environment, heap and shared memory */
+    process->env = (uint64_t)kalloc();
+    ASSERT(process->env != 0);
+    memset((void*)process->env, 0, sizeof(struct Map));
 
     return process;
 }
 
-static void init_idle_process(void)
+static void init_idle_process(int cpu)
 {
+    struct Cpu* core = pc.cpus + cpu;
     struct Process* process;
-    /* Allocate the first slot in the process table */
-    process = process_table;
-    ASSERT(process != NULL);
+    /* The boot core allocates the first slot in the process table */
+    process = cpu == 0 ? process_table : secondary_idle + cpu - 1;
 
     process->state = RUNNING;
     process->pid = 0;
     process->daemon = true;
-    /* Since this is the first process of the system, page map is initialized with current val of TTBR0 register */
+    process->cpu = cpu;
+    /* The idle process runs on the kernel identity map hence the page map is initialized with current val of TTBR0 register */
     process->page_map = TO_VIRT(read_gdt());
-    pc.curr_process = process;
+    core->idle = process;
+    core->curr_process = process;
+    core->online = true;
 }
 
 static void init_user_process(void)
@@ -118,22 +302,236 @@ static void init_user_process(void)
     process->daemon = true;
     /* Initialize signal handlers for the init process */
     init_handlers(process);
-    push_back(&pc.ready_que, (struct Node*)process);
+    ready_push(process);
     printk("Started init process.\n");
 }
 
 void init_process(void)
 {
-    pc.ready_que.head = pc.ready_que.tail = NULL;
-    init_idle_process();
+    /* Stack the free slots so that the lowest one is handed out first, which makes init take the second slot
+       PID 0 belongs to the idle processes */
+    for (int i = PROC_TABLE_SIZE - 1; i > 0; i--)
+        free_slots[free_count++] = process_table + i;
+    pid_map[0] = 1;
+    for (int i = 0; i < MAX_CPUS; i++)
+    {
+        pc.cpus[i].active = pc.cpus[i].arrays;
+        pc.cpus[i].expired = pc.cpus[i].arrays + 1;
+    }
+    init_idle_process(0);
     init_def_handlers(&pc);
     init_user_process();
 }
 
+void init_cpu_process(void)
+{
+    init_idle_process(get_cpu_id());
+}
+
+/* The kernel lock serializes kernel execution across cores. It is taken on every exception entry and dropped in trap_return (svc_return for syscalls)
+   It belongs to the core rather than the process because a process may sleep and switch stacks inside the kernel while holding it */
+void lock_kernel(void)
+{
+    spin_lock(&pc.lock);
+}
+
+void unlock_kernel(void)
+{
+    spin_unlock(&pc.lock);
+}
+
+/* Length of a time slice in timer ticks. Ranges from 1 tick at NICE_MAX to 5 ticks at NICE_MIN */
+static int time_slice(int nice)
+{
+    return (NICE_MAX - nice) / 8 + 1;
+}
+
+/* Ready queue level of a process. Level 0 is picked first */
+static int effective_prio(struct Process* process)
+{
+    int prio = process->nice - NICE_MIN - process->boost;
+    return prio < 0 ? 0 : prio;
+}
+
+static void enqueue(struct PrioArray* array, struct Process* process)
+{
+    process->prio = effective_prio(process);
+    push_back(&array->queue[process->prio], (struct Node*)process);
+    array->bitmap |= (1UL << process->prio);
+    process->array = array;
+}
+
+static void dequeue(struct Process* process)
+{
+    struct PrioArray* array = process->array;
+
+    remove(&array->queue[process->prio], (struct Node*)process);
+    if (empty(&array->queue[process->prio]))
+        array->bitmap &= ~(1UL << process->prio);
+    process->array = NULL;
+}
+
+/* Get the next process to run on a core without removing it. The lowest set bit of the bitmap gives the highest priority queue in constant time
+   Once the active array drains, the expired array holding the processes that used up their slice takes its place */
+static struct Process* ready_peek(struct Cpu* core)
+{
+    if (core->active->bitmap == 0){
+        struct PrioArray* array = core->active;
+        core->active = core->expired;
+        core->expired = array;
+    }
+    if (core->active->bitmap == 0)
+        return NULL;
+    return (struct Process*)front(&core->active->queue[first_set_bit(core->active->bitmap)]);
+}
+
+static void enqueue_ready(struct Process* process, bool expired)
+{
+    struct Cpu* target = pc.cpus + process->cpu;
+
+    /* Stay with the previous core unless another online core has a shorter queue */
+    for (int i = 0; i < MAX_CPUS; i++)
+    {
+        if (pc.cpus[i].online && pc.cpus[i].ready_count < target->ready_count)
+            target = pc.cpus + i;
+    }
+    process->cpu = target - pc.cpus;
+    if (process->slice <= 0)
+        process->slice = time_slice(process->nice);
+    enqueue(expired ? target->expired : target->active, process);
+    target->ready_count++;
+    process->ready_since = read_timer_count();
+    /* An idle core has its tick stopped and has to be told about the work */
+    if (target != this_cpu() && target->curr_process == target->idle)
+        kick_cpu(target - pc.cpus);
+}
+
+void ready_push(struct Process* process)
+{
+    enqueue_ready(process, false);
+}
+
+bool ready_remove(struct Process* process)
+{
+    if (process->array == NULL)
+        return false;
+    dequeue(process);
+    pc.cpus[process->cpu].ready_count--;
+    return true;
+}
+
+bool ready_contains(struct Process* process)
+{
+    return process->array != NULL;
+}
+
+/* Pull the next process of the busiest other core when this core has run out of work */
+static void balance(struct Cpu* core)
+{
+    struct Cpu* busiest = NULL;
+    struct Process* process;
+
+    if (core->ready_count > 0)
+        return;
+    for (int i = 0; i < MAX_CPUS; i++)
+    {
+        if (pc.cpus + i != core && pc.cpus[i].ready_count > 0 && (busiest == NULL || pc.cpus[i].ready_count > busiest->ready_count))
+            busiest = pc.cpus + i;
+    }
+    if (busiest == NULL)
+        return;
+
+    process = ready_peek(busiest);
+    ready_remove(process);
+    process->cpu = core - pc.cpus;
+    enqueue(core->active, process);
+    core->ready_count++;
+}
+
+/* Whether all cores other than the given one are running their idle process with nothing queued */
+static bool others_idle(struct Cpu* core)
+{
+    for (int i = 0; i < MAX_CPUS; i++)
+    {
+        if (pc.cpus + i == core || !pc.cpus[i].online)
+            continue;
+        if (pc.cpus[i].ready_count > 0 || pc.cpus[i].curr_process != pc.cpus[i].idle)
+            return false;
+    }
+    return true;
+}
+
+static struct FpState* fp_state(struct Process* process)
+{
+    return fp_states + (process - process_table);
+}
+
+/* FP/SIMD registers are switched lazily. A process only gets them loaded when its first FP instruction after being scheduled traps
+   Hence only a process which did use them in the slice it ran has them saved when switched out. They are never left live on a core
+   across a switch since the process may be picked up by another core next */
+static void fp_switch_out(struct Cpu* core, struct Process* process)
+{
+    if (core->fp_owner == NULL)
+        return;
+    fp_save(fp_state(process));
+    core->fp_owner = NULL;
+    set_fp_access(false);
+}
+
+void fp_trap(struct Process* process)
+{
+    struct Cpu* core = this_cpu();
+
+    /* A process starts off with all FP registers cleared */
+    if (!process->fp_used){
+        memset(fp_state(process), 0, sizeof(struct FpState));
+        process->fp_used = true;
+    }
+    set_fp_access(true);
+    fp_restore(fp_state(process));
+    core->fp_owner = process;
+}
+
+/* A signal handler may use the FP/SIMD registers of the context it interrupts. They are copied to the signal frame on delivery,
+   taken from the core if they are live on it */
+void fp_save_signal(struct Process* process, struct FpState* state)
+{
+    if (this_cpu()->fp_owner == process)
+        fp_save(fp_state(process));
+    memcpy(state, fp_state(process), sizeof(struct FpState));
+}
+
+/* Bring back the registers saved by fp_save_signal once the handler returns. A NULL state means the process had not used them
+   when the signal was delivered, so any the handler used are dropped */
+void fp_restore_signal(struct Process* process, struct FpState* state)
+{
+    struct Cpu* core = this_cpu();
+
+    if (state == NULL){
+        if (core->fp_owner == process){
+            core->fp_owner = NULL;
+            set_fp_access(false);
+        }
+        process->fp_used = false;
+        return;
+    }
+    memcpy(fp_state(process), state, sizeof(struct FpState));
+    process->fp_used = true;
+    if (core->fp_owner == process)
+        fp_restore(fp_state(process));
+}
+
 static void switch_process(struct Process* existing, struct Process* new)
 {
+    uint64_t now = read_timer_count();
+
+    /* Charge the kernel time up to the switch to the outgoing process and start the clock of the incoming one */
+    existing->usage.stime += now - existing->mark;
+    new->mark = now;
     /* Switch the page tables to point to the new user process memory */
     switch_vm(new->page_map);
+    /* Point the process to its record on the kernel data page. A parent change while it runs elsewhere is published by set_job */
+    set_user_record(publish_record(new));
     /* Swap the currently running process with the new process chosen by the scheduler */
     swap(&existing->sp, new->sp);
     /* The new process in previous context will resume execution here once swapped in unless it's the first time it's running
@@ -151,48 +549,84 @@ static void switch_process(struct Process* existing, struct Process* new)
 
 static void schedule(void)
 {
-    struct Process* old_process = pc.curr_process;
+    struct Cpu* core = this_cpu();
+    struct Process* old_process = core->curr_process;
     struct Process* new_process = NULL;
-
-    /* Check for pending signals on suspended processes */
-    struct Process* sjob = (struct Process*)front(&pc.suspended);
+    struct Process* sjob;
     struct Process* next_sjob = NULL;
-    while (sjob != NULL)
-    {
-        /* Save the next job so that we do not lose track if the check_pending_signals function removes current job */
-        next_sjob = (struct Process*)sjob->next;
-        check_pending_signals(sjob);
-        sjob = next_sjob;
+
+    /* Release the kernel stack of a thread which exited on this core, unless the core is still running on it */
+    if (core->dead_stack != 0 && core->dead_stack != old_process->kpage){
+        kfree(core->dead_stack);
+        core->dead_stack = 0;
+    }
+    /* Act on signals sent to suspended processes, which only go through the list if one of them was sent a signal it reacts to */
+    if (pc.suspended_signalled){
+        pc.suspended_signalled = false;
+        sjob = (struct Process*)front(&pc.suspended);
+        while (sjob != NULL)
+        {
+            /* Save the next job so that we do not lose track if the check_pending_signals function removes current job */
+            next_sjob = (struct Process*)sjob->next;
+            if (signal_pending(sjob))
+                check_pending_signals(sjob);
+            sjob = next_sjob;
+        }
     }
-    /* While returning to user mode from kernel mode, check for any pending signals on the process about to be scheduled */
-    while (!empty(&pc.ready_que))
+    balance(core);
+    /* Act on the kernel handled signals of the process about to be scheduled, for instance one woken up to be terminated
+       Caught signals are delivered once it returns to user mode */
+    while ((new_process = ready_peek(core)) != NULL)
     {
-        new_process = (struct Process*)front(&pc.ready_que);
+        if (!signal_pending(new_process)){
+            ready_remove(new_process);
+            break;
+        }
         if (process_table->signals & (1 << SIGTERM))
             printk("Stopping process %s (%d)\n", new_process->name, new_process->pid);
         check_pending_signals(new_process);
         /* If the checked process is still present at the head of the queue, proceed to scheduling it */
-        if ((uint64_t)new_process == (uint64_t)front(&pc.ready_que)){
-            pop_front(&pc.ready_que);
+        if (new_process == ready_peek(core)){
+            ready_remove(new_process);
             break;
         }
         /* Reset the pointer to accomodate the next process at the head of the queue */
         new_process = NULL;
     }
-    /* If no other process is ready to run and the queue is empty, schedule the idle process (with below exception)
-       Halt the system if the ready and wait queues are both empty and a termination signal has been issued to the idle process */
-    if (empty(&pc.ready_que) && !new_process){
-        if (empty(&pc.wait_list)){
+    /* If no other process is ready to run and the queue is empty, schedule the idle process of the core (with below exception)
+       Halt the system if the ready and wait queues are all empty and a termination signal has been issued to the idle process */
+    if (new_process == NULL){
+        if (pc.sleepers == 0 && others_idle(core)){
             if (process_table->signals & (1 << SIGTERM)){
                 shutdown = true;
                 printk("Stopping kernel ...\n");
+                /* Idle cores take no ticks. Interrupt them to notice the shutdown */
+                for (int i = 0; i < MAX_CPUS; i++)
+                {
+                    if (pc.cpus + i != core && pc.cpus[i].online)
+                        kick_cpu(i);
+                }
             }
         }
-        new_process = process_table;
+        new_process = core->idle;
+    }
+    else
+        new_process->usage.wait_time += read_timer_count() - new_process->ready_since;
+    /* A process switched out while it could still run was preempted or yielded. Otherwise it gave up the core to sleep, stop or exit */
+    if (new_process != old_process && old_process->pid != 0){
+        if (old_process->state == READY)
+            old_process->usage.nivcsw++;
+        else
+            old_process->usage.nvcsw++;
     }
 
     new_process->state = RUNNING;
-    pc.curr_process = new_process;
+    new_process->cpu = core - pc.cpus;
+    core->curr_process = new_process;
+    /* Stop the periodic tick while the core idles and restart it once there is a process to preempt */
+    set_tick_mode(new_process == core->idle);
+    if (new_process != old_process)
+        fp_switch_out(core, old_process);
     /* Set scheduled process as current foreground process if it identifies itself as one and no other process is assuming one */
     if (!new_process->daemon && pc.fg_process == NULL)
         pc.fg_process = new_process;
@@ -202,25 +636,88 @@ static void schedule(void)
 
 void trigger_scheduler(void)
 {
-    struct Process* process;
-
-    /* Return and continue running the same process if the ready queue is empty */
-    if (empty(&pc.ready_que))
+    struct Cpu* core = this_cpu();
+    struct Process* process = core->curr_process;
+    struct Process* next;
+
+    /* Notify the idle process of a core other than the one which started the shutdown */
+    if (shutdown && process->pid == 0 && process->reg_context != NULL)
+        process->reg_context->x5 = 1;
+    /* Continue running the same process if there is nothing to run, not even work to take from other cores
+       A running process is only preempted before its time slice ends by one of higher priority */
+    balance(core);
+    next = ready_peek(core);
+    if (next == NULL)
+        return;
+    if (process->pid != 0 && process->slice > 0 && next->prio >= process->prio)
         return;
     /* The current process state needs to be changed from running to ready */
-    process = pc.curr_process;
     process->state = READY;
 
-    /* The idle process (PID 0) is run by default and is also not appended to the ready queue */
-    if (process->pid != 0)
-        push_back(&pc.ready_que, (struct Node*)process);
+    /* The idle process (PID 0) is run by default and is also not appended to the ready queue
+       A process which used up its slice loses its wakeup boost and waits in the expired array for the next round */
+    if (process->pid != 0){
+        if (process->slice <= 0){
+            process->boost = 0;
+            enqueue_ready(process, true);
+        }
+        else
+            ready_push(process);
+    }
+
+    schedule();
+}
+
+void yield(void)
+{
+    struct Cpu* core = this_cpu();
+    struct Process* process = core->curr_process;
 
+    /* Keep running if there is nothing else to run */
+    balance(core);
+    if (ready_peek(core) == NULL)
+        return;
+    /* Go to the back of the queue at the same priority level, keeping what is left of the time slice */
+    process->state = READY;
+    ready_push(process);
     schedule();
 }
 
+int get_priority(struct Process* process, int pid)
+{
+    struct Process* target = pid == 0 ? process : get_process(pid);
+    return target != NULL ? target->nice : INT32_MAX;
+}
+
+int set_priority(struct Process* process, int pid, int nice)
+{
+    struct Process* target = pid == 0 ? process : get_process(pid);
+
+    if (target == NULL || target->state == KILLED)
+        return -1;
+    /* Only a process itself or its parent may change its priority */
+    if (target != process && target->ppid != process->pid)
+        return -1;
+    if (nice < NICE_MIN)
+        nice = NICE_MIN;
+    if (nice > NICE_MAX)
+        nice = NICE_MAX;
+    /* Raising the priority i.e. lowering the nice value is reserved for the init process, which stands in for a privileged user */
+    if (nice < target->nice && get_group_leader(process)->pid != 1)
+        return -1;
+    target->nice = nice;
+    /* Move a waiting process to the queue of its new level */
+    if (ready_remove(target))
+        ready_push(target);
+    else
+        target->prio = effective_prio(target);
+
+    return 0;
+}
+
 struct Process *get_curr_process(void)
 {
-    return pc.curr_process;
+    return this_cpu()->curr_process;
 }
 
 struct Process *get_fg_process(void)
@@ -234,31 +731,71 @@ struct Process *get_fg_process(void)
 
 struct Process *get_process(int pid)
 {
-    struct Process* process = NULL;
+    struct Process* process = *pid_bucket(pid);
+
+    while (process != NULL && (process->pid != pid || process->state == UNUSED))
+        process = process->pid_next;
+    return process;
+}
+
+/* Fill in a record for every active process in a single pass over the process table
+   The selection is the same as get_active_pids. Returns the count of processes selected, which may exceed max */
+int get_proc_snapshot(struct Process* process, struct ProcInfo* info, int max, int all)
+{
+    int count = 0;
 
     for (int i = 1; i < PROC_TABLE_SIZE; i++)
     {
-        if (process_table[i].state != UNUSED && process_table[i].pid == pid){
-            process = &process_table[i];
-            break;
+        struct Process* proc = process_table + i;
+        if (proc->state == UNUSED)
+            continue;
+        if (!all && proc->ppid != process->pid && proc->pid != process->pid)
+            continue;
+        if (info != NULL && count < max){
+            struct ProcInfo* rec = info + count;
+            char* arg = (char*)proc->args;
+            int arg_len;
+
+            memset(rec, 0, sizeof(struct ProcInfo));
+            rec->pid = proc->pid;
+            rec->ppid = proc->ppid;
+            rec->state = proc->state;
+            rec->job_spec = proc->job_spec;
+            rec->nice = proc->nice;
+            memcpy(rec->name, proc->name, MAX_FILENAME_BYTES);
+            /* Copy as many whole arguments as fit in the summary */
+            for (uint32_t j = 0; j < proc->argc; j++)
+            {
+                arg_len = strlen(arg);
+                if (rec->args_size + arg_len + 1 > PROC_ARGS_SUMMARY)
+                    break;
+                memcpy(rec->args + rec->args_size, arg, arg_len + 1);
+                rec->args_size += arg_len + 1;
+                arg += arg_len + 1;
+            }
+            rec->cpu_ticks = proc->cpu_ticks;
+            rec->rss = get_resident_pages(proc->page_map) * (PAGE_SIZE / 1024);
+            rec->utime = to_usec(proc->usage.utime);
+            rec->stime = to_usec(proc->usage.stime);
+            rec->wait_time = to_usec(proc->usage.wait_time);
+            rec->nvcsw = proc->usage.nvcsw;
+            rec->nivcsw = proc->usage.nivcsw;
         }
+        count++;
     }
-    return process;
+
+    return count;
 }
 
 struct Process* find_job(int job_spec, int ppid)
 {
-    struct Process* process = NULL;
+    struct Process* process;
     if (job_spec <= 0)
         return NULL;
     
-    for(int i = 1; i < PROC_TABLE_SIZE; i++)
-    {
-        if (process_table[i].state != UNUSED && process_table[i].ppid == ppid && process_table[i].job_spec == job_spec){
-            process = &process_table[i];
-            break;
-        }
-    }
+    process = *job_bucket(ppid, job_spec);
+    while (process != NULL && (process->ppid != ppid || process->job_spec != job_spec || process->state == UNUSED))
+        process = process->job_next;
     return process;
 }
 
@@ -273,12 +810,12 @@ void move_to_fore(struct Process* process)
         if (process->event == DAEMON_INPUT)
             process->event = KEYBOARD_INPUT;
         if (process->state == SLEEP){
-            remove(&pc.wait_list, (struct Node*)process);
+            wait_dequeue(process);
             process->state = READY;
         }
         pc.fg_process = process;
-        if (!contains(&pc.ready_que, (struct Node*)process))
-            push_back(&pc.ready_que, (struct Node*)process);
+        if (!ready_contains(process))
+            ready_push(process);
     }
 }
 
@@ -302,35 +839,32 @@ int get_status(int pid)
 int get_proc_data(int pid, int *ppid, int *state, int* job_spec, char *name, char* args_buf)
 {
     int args_size = 0;
+    struct Process* process = get_process(pid);
 
-    for (int i = 1; i < PROC_TABLE_SIZE; i++)
+    if (process == NULL)
+        return 0;
+    if (ppid != NULL)
+        *ppid = process->ppid;
+    if (state != NULL)
+        *state = process->state;
+    if (job_spec != NULL)
+        *job_spec = process->job_spec;
+    if (name != NULL){
+        int namelen = strlen(process->name);
+        memcpy(name, process->name, namelen);
+        name[namelen] = 0;
+    }
+    /* Retrieve the program arguments from the args member */
+    char* arg = (char*)process->args;
+    int arg_len;
+    for(int j = 0; j < process->argc; j++)
     {
-        if (process_table[i].state != UNUSED && process_table[i].pid == pid){
-            if (ppid != NULL)
-                *ppid = process_table[i].ppid;
-            if (state != NULL)
-                *state = process_table[i].state;
-            if (job_spec != NULL)
-                *job_spec = process_table[i].job_spec;
-            if (name != NULL){
-                int namelen = strlen(process_table[i].name);
-                memcpy(name, process_table[i].name, namelen);
-                name[namelen] = 0;
-            }
-            /* Retrieve the program arguments from the args member */
-            char* arg = (char*)process_table[i].args;
-            int arg_len;
-            for(int j = 0; j < process_table[i].argc; j++)
-            {
-                arg_len = strlen(arg+args_size);
-                if (args_buf != NULL){
-                    memcpy(args_buf+args_size, arg+args_size, arg_len);
-                    *(args_buf+args_size+arg_len) = 0;
-                }
-                args_size += (arg_len+1);
-            }
-            break;
+        arg_len = strlen(arg+args_size);
+        if (args_buf != NULL){
+            memcpy(args_buf+args_size, arg+args_size, arg_len);
+            *(args_buf+args_size+arg_len) = 0;
         }
+        args_size += (arg_len+1);
     }
 
     return args_size;
@@ -362,68 +896,241 @@ int get_active_pids(struct Process* process, int* pid_list, int all)
     return count;
 }
 
-void switch_parent(int curr_ppid, int new_ppid, bool transfer_jobs)
+/* Move the children of a process from one list to a new parent, handing over running jobs if asked to */
+static void move_children(struct Link* list, struct Process* parent, bool transfer_jobs)
 {
-    struct Process* parent = get_process(new_ppid);
-    if (!parent || parent->state == KILLED)
-        return;
-    
-    for(int i = 1; i < PROC_TABLE_SIZE; i++)
+    struct Process* child;
+
+    while (!link_empty(list))
     {
-        /* Reassign parent for all children which have current parent with curr_ppid */
-        if (process_table[i].state != UNUSED && process_table[i].ppid == curr_ppid){
-            process_table[i].ppid = new_ppid;
-            /* Handover running jobs to new parent */
-            if (transfer_jobs && process_table[i].job_spec && process_table[i].state != STOPPED){
-                parent->jobs++;
-                process_table[i].job_spec = parent->jobs;
-            }
-        }
+        child = container_of(list->next, struct Process, sibling);
+        /* Setting the parent takes the child off the list */
+        set_job(child, parent->pid, child->job_spec);
+        /* Handover running jobs to new parent */
+        if (transfer_jobs && child->job_spec && child->state != STOPPED)
+            assign_job(parent, child);
     }
 }
 
-void sleep(int event)
+void switch_parent(int curr_ppid, int new_ppid, bool transfer_jobs)
 {
-    struct Process* process;
-
-    process = pc.curr_process;
-    process->state = SLEEP;
-    /* Save the reason of wait which can used in wake_up to selectively wake up processes based on occurred events */
-    process->event = event;
+    struct Process* parent = get_process(new_ppid);
+    struct Process* curr_parent = get_process(curr_ppid);
+    bool zombies;
 
-    /* Enqueue the process on the wait list so that it cannot be rescheduled until woken up and placed on ready queue */
-    push_back(&pc.wait_list, (struct Node*)process);
-    /* Call the scheduler to replace the current process (which just slept) with other process on the ready queue */
-    schedule();
+    if (!parent || parent->state == KILLED || !curr_parent || curr_parent == parent)
+        return;
+    zombies = !link_empty(&curr_parent->zombies);
+    move_children(&curr_parent->children, parent, transfer_jobs);
+    move_children(&curr_parent->zombies, parent, transfer_jobs);
+    /* The new parent may be waiting already and has zombies to reap now */
+    if (zombies)
+        wake_up_queue(&parent->child_wait);
 }
 
-void wake_up(int event)
+/* Queue a process waits on for an event. A parent waits for its children on its own queue, which its threads share
+   and an object specific event such as that of a pipe keeps the queue the process was put on */
+static struct WaitQueue* event_queue(struct Process* process, int event)
 {
-    struct Process* process, *next_node = NULL;
-    
-    /* remove first process waiting on event from the wait list */
-    process = (struct Process*)remove_evt(&pc.wait_list, (struct Node**)&next_node, event);
-    /* Place it on the ready queue and check if any other processes waiting on the same event
-       If they're sleeping, remove from wait list and place them on the ready queue as well */
-    while (process != NULL)
+    if (event == STATE_CHANGE)
+        return &get_group_leader(process)->child_wait;
+    if (event > NONE && event <= FG_PAUSED)
+        return event_queues + (event - NONE - 1);
+    return process->wait_queue;
+}
+
+static bool timer_before(int i, int j)
+{
+    return timer_heap[i]->deadline < timer_heap[j]->deadline;
+}
+
+static void timer_swap(int i, int j)
+{
+    struct Process* process = timer_heap[i];
+
+    timer_heap[i] = timer_heap[j];
+    timer_heap[j] = process;
+    timer_heap[i]->timer_index = i + 1;
+    timer_heap[j]->timer_index = j + 1;
+}
+
+static void timer_sift_up(int i)
+{
+    while (i > 0 && timer_before(i, (i - 1) / 2))
     {
-        if (!contains(&pc.ready_que, (struct Node*)process)){
-            process->event = NONE;
-            process->state = READY;
-            push_back(&pc.ready_que, (struct Node*)process);
-        }
-        process = (struct Process*)remove_evt(&pc.wait_list, (struct Node**)&next_node, event);
+        timer_swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void timer_sift_down(int i)
+{
+    int child;
+
+    while ((child = 2 * i + 1) < timer_count)
+    {
+        if (child + 1 < timer_count && timer_before(child + 1, child))
+            child++;
+        if (!timer_before(child, i))
+            break;
+        timer_swap(i, child);
+        i = child;
     }
 }
 
+static void timer_insert(struct Process* process)
+{
+    timer_heap[timer_count] = process;
+    process->timer_index = ++timer_count;
+    timer_sift_up(timer_count - 1);
+    /* The boot core serves deadlines and may be idle with its timer set to a later one */
+    if (process->timer_index == 1 && get_cpu_id() != 0 && pc.cpus[0].curr_process == pc.cpus[0].idle)
+        kick_cpu(0);
+}
+
+static void timer_delete(struct Process* process)
+{
+    int i = process->timer_index - 1;
+
+    timer_count--;
+    if (i != timer_count){
+        timer_swap(i, timer_count);
+        timer_sift_up(i);
+        timer_sift_down(i);
+    }
+    process->timer_index = 0;
+}
+
+uint64_t next_deadline(void)
+{
+    return timer_count > 0 ? timer_heap[0]->deadline : UINT64_MAX;
+}
+
+static void wait_enqueue(struct WaitQueue* queue, struct Process* process)
+{
+    process->wait_queue = queue;
+    link_append(&queue->waiters, &process->wait_link);
+    pc.sleepers++;
+    if (process->event == SLEEP_SYSCALL)
+        timer_insert(process);
+}
+
+void wait_dequeue(struct Process* process)
+{
+    if (!link_linked(&process->wait_link))
+        return;
+    link_remove(&process->wait_link);
+    pc.sleepers--;
+    if (process->timer_index != 0)
+        timer_delete(process);
+}
+
+void wait_requeue(struct Process* process)
+{
+    /* A process may already be asleep on another queue, which it can be only on one at a time */
+    wait_dequeue(process);
+    process->state = SLEEP;
+    wait_enqueue(event_queue(process, process->event), process);
+}
+
+void sleep(int event)
+{
+    struct Process* process = get_curr_process();
+    sleep_on(event_queue(process, event), event);
+}
+
+void sleep_on(struct WaitQueue* queue, int event)
+{
+    struct Process* process;
+
+    process = get_curr_process();
+    process->state = SLEEP;
+    /* Save the reason of wait which tells a process interrupted by a signal that it was blocked in a syscall */
+    process->event = event;
+
+    /* Enqueue the process on the wait queue so that it cannot be rescheduled until woken up and placed on ready queue */
+    wait_enqueue(queue, process);
+    /* Call the scheduler to replace the current process (which just slept) with other process on the ready queue */
+    schedule();
+}
+
+void sleep_until(uint64_t deadline)
+{
+    get_curr_process()->deadline = deadline;
+    sleep(SLEEP_SYSCALL);
+}
+
+void wake_up(int event)
+{
+    /* Only scheduler events have a global queue. Children and pipes are woken through their own queues */
+    if (event <= NONE || event > FG_PAUSED || event == STATE_CHANGE)
+        return;
+    wake_up_queue(event_queues + (event - NONE - 1));
+}
+
+static void wake_process(struct Process* process)
+{
+    wait_dequeue(process);
+    /* Input and pipe waits (pipe events are numbered below NONE) mark the process as interactive */
+    if (process->event == KEYBOARD_INPUT || process->event == DAEMON_INPUT || process->event < NONE)
+        process->boost = WAKEUP_BOOST;
+    process->event = NONE;
+    process->wait_queue = NULL;
+    process->state = READY;
+    ready_push(process);
+}
+
+void wake_up_queue(struct WaitQueue* queue)
+{
+    /* Move every waiter to the ready queue. Only the woken processes are visited */
+    while (!link_empty(&queue->waiters))
+        wake_process(container_of(queue->waiters.next, struct Process, wait_link));
+}
+
+void wake_expired(uint64_t now)
+{
+    while (timer_count > 0 && timer_heap[0]->deadline <= now)
+        wake_process(timer_heap[0]);
+}
+
+void wake_parent(struct Process* process)
+{
+    struct Process* parent = get_process(process->ppid);
+
+    if (parent != NULL)
+        wake_up_queue(&parent->child_wait);
+}
+
+/* Queue an exited process on the zombies list of its parent and wake the parent up to reap it
+   A zombie is left to init if its parent is gone, or if the parent waits for one child in particular or hasn't waited for any */
+void make_zombie(struct Process* process)
+{
+    struct Process* parent = get_process(process->ppid);
+
+    if (process->ppid != 1 && (parent == NULL || parent->state == KILLED || (parent->wpid >= 0 && parent->wpid != process->pid)))
+        set_job(process, 1, process->job_spec);
+    process->zombie = true;
+    link_child(process);
+    wake_parent(process);
+}
+
 void exit(struct Process* process, int status, bool sig_handler_req)
 {
     if (process == NULL || process->state == UNUSED || process->state == KILLED)
         return;
+    /* A thread ends alone. The process it belongs to carries on until it exits itself */
+    if (process->tgid != process->pid){
+        exit_thread(process);
+        if (!sig_handler_req)
+            schedule();
+        return;
+    }
     process->status = sig_handler_req ? status : ((status & 0xff) << 8);
     /* Set the state to killed and event to PID for the wait function to sweep it later */
     process->state = KILLED;
     process->event = process->pid;
+    /* Close files right away rather than when the zombie is reaped so that the other end of a pipe sees the hang up */
+    close_all_files(process);
     /* Inform the parent about death of child and pass its exit status */
     struct Process* parent = get_process(process->ppid);
     if (parent != NULL && parent->state != KILLED){
@@ -431,21 +1138,22 @@ void exit(struct Process* process, int status, bool sig_handler_req)
         parent->status = process->status;
     }
     else /* Orphan process. Make init a foster parent */
-        process->ppid = 1;
-    /* Terminate stopped jobs and recursively kill their children */
-    struct Process* sjob = (struct Process*)front(&pc.suspended);
-    struct Process* next_sjob;
-    while (sjob != NULL)
+        set_job(process, 1, process->job_spec);
+    /* Terminate stopped jobs and recursively kill their children. Only the children of the process are visited */
+    struct Link* link = process->children.next;
+    struct Process* sjob;
+    while (link != NULL && link != &process->children)
     {
-        next_sjob = (struct Process*)sjob->next;
-        if (sjob->ppid == process->pid && sjob->state == STOPPED){
+        sjob = container_of(link, struct Process, sibling);
+        /* Save the next child since a terminated job moves to the zombies list */
+        link = link->next;
+        if (sjob->state == STOPPED){
             sjob->state = KILLED;
             sjob->event = sjob->pid;
             kill(sjob, 0, SIGTERM);
             remove(&pc.suspended, (struct Node*)sjob);
-            push_back(&pc.zombies, (struct Node*)sjob);
+            make_zombie(sjob);
         }
-        sjob = next_sjob;
     }
     /* Handover potential orphan children if any to the init process */
     switch_parent(process->pid, 1, true);
@@ -457,10 +1165,11 @@ void exit(struct Process* process, int status, bool sig_handler_req)
     /* Wake up processes that might be paused while this one was running in the foreground */
     if (!process->daemon)
         wake_up(FG_PAUSED);
-    push_back(&pc.zombies, (struct Node*)process);
-
+    /* The memory of the process stays in use until its last thread is gone, which is when it becomes a zombie */
+    kill_threads(process);
     /* Wake up the process sleeping in wait to clean up this zombie process */
-    wake_up(STATE_CHANGE);
+    if (process->threads == 0)
+        make_zombie(process);
 
     /* Put off scheduling if invoked by a signal handler because it will have work to do */
     if (!sig_handler_req)
@@ -470,19 +1179,21 @@ void exit(struct Process* process, int status, bool sig_handler_req)
 int wait(int pid, int* wstatus, int options)
 {
     int wpid;
+    /* Threads wait for the children of the process they belong to */
+    struct Process* curr_process = get_group_leader(get_curr_process());
+    struct Process* wproc;
     if (pid == 0 || pid < -1)
         return -1;
-    pc.curr_process->wpid = pid;
+    curr_process->wpid = pid;
     
     while (1)
     {
         wpid = pid;
-        bool has_child = false;
         /* Acknowledge a stopped process */
-        if (pc.curr_process->wpid > 1){
-            struct Process* process = get_process(pc.curr_process->wpid);
+        if (curr_process->wpid > 1){
+            struct Process* process = get_process(curr_process->wpid);
             if (process && process->state == STOPPED && contains(&pc.suspended, (struct Node*)process)){
-                pc.curr_process->wpid = pid;
+                curr_process->wpid = pid;
                 if (options & WUNTRACED){ /* Return with PID of stopped process */
                     wpid = process->pid;
                     if (wstatus != NULL)
@@ -491,61 +1202,30 @@ int wait(int pid, int* wstatus, int options)
                 }
             }
         }
-        /* Make init a foster parent of abandoned zombies */
-        if (pc.curr_process->pid == 1){
-            struct Process* process = (struct Process*)front(&pc.zombies);
-            while (process != NULL)
-            {
-                if (process->ppid != 1){
-                    struct Process* parent = get_process(process->ppid);
-                    if (!parent || (parent->wpid >= 0 && process->pid != parent->wpid))
-                        process->ppid = 1;
-                }
-                process = (struct Process*)process->next;
-            }
-        }
-        /* Search for first available zombie child */
+        /* Take the first zombie child, if any. If the current process doesn't have any children, there's no need to wait */
         if (pid == -1){
-            for(int i = 1; i < PROC_TABLE_SIZE; i++)
-            {
-                if (process_table[i].state != UNUSED && process_table[i].ppid == pc.curr_process->pid){
-                    has_child = true;
-                    if (contains(&pc.zombies, (struct Node*)&process_table[i])){
-                        wpid = process_table[i].pid;
-                        break;
-                    }
-                }
-            }
+            if (link_empty(&curr_process->children) && link_empty(&curr_process->zombies))
+                return -1;
+            wproc = link_empty(&curr_process->zombies) ? NULL : container_of(curr_process->zombies.next, struct Process, sibling);
         }
         else{ /* Verify if the PID the current process is waiting for is a valid child process */
-            struct Process* process = get_process(wpid);
-            if (process != NULL && process->ppid == pc.curr_process->pid)
-                has_child = true;
+            wproc = get_process(wpid);
+            if (wproc == NULL || wproc->ppid != curr_process->pid || wproc->tgid != wproc->pid)
+                return -1;
+            if (!wproc->zombie)
+                wproc = NULL;
         }
-        /* If the current process doesn't have any children, there's no need to wait */
-        if (!has_child)
-            return -1;
 
-        struct Process* wproc = (struct Process*)remove_evt(&pc.zombies, NULL, wpid);
         if (wproc != NULL){
-            /* There's a chance some process or handler already cleaned up this zombie */
-            if (wproc->state != KILLED)
-                break;
+            wpid = wproc->pid;
             free_uvm(wproc->page_map);
-            /* Decrement ref counts of all files left open by the zombie */
-            for(int i = 0; i < MAX_OPEN_FILES; i++)
-            {
-                if (wproc->fd_table[i] != NULL){
-                    wproc->fd_table[i]->ref_count--;
-                    wproc->fd_table[i]->inode->ref_count--;
-                    /* Note that we can't release the inode based on only the file entry ref count because other file entries could be pointing to it
-                        Hence the in core inode should be released (entry set to NULL) only if the inode ref count is zero */
-                    if (wproc->fd_table[i]->inode->ref_count == 0)
-                        wproc->fd_table[i]->inode = NULL;
-                }
-            }
-            /* Mark process table slot free so that a new process can utilize it */
-            wproc->state = UNUSED;
+            /* Close all files left open by the zombie which releases file table entries and inodes no longer referred to */
+            close_all_files(wproc);
+            /* The child's usage and that of the children it reaped count towards the reaped children of the current process */
+            add_usage(&curr_process->child_usage, &wproc->usage);
+            add_usage(&curr_process->child_usage, &wproc->child_usage);
+            /* Mark process table slot free so that a new process can utilize it. This takes it off the zombies list too */
+            free_slot(wproc);
             /* Return the wait status to the caller */
             if (wstatus != NULL)
                 *wstatus = wproc->status;
@@ -562,6 +1242,9 @@ int wait(int pid, int* wstatus, int options)
 int fork(void)
 {
     struct Process* process;
+    struct Process* curr_process = get_curr_process();
+    /* A child forked by a thread belongs to the process and shares its open files */
+    struct Process* leader = get_group_leader(curr_process);
 
     /* Allocate a new child process */
     process = alloc_new_process();
@@ -569,57 +1252,61 @@ int fork(void)
         return -1;
     
     /* Copy the process name and set parent process ID */
-    memcpy(process->name, pc.curr_process->name, sizeof(process->name));
-    process->ppid = pc.curr_process->pid;
+    memcpy(process->name, curr_process->name, sizeof(process->name));
+    set_job(process, leader->pid, 0);
+    /* The child inherits the priority of the parent */
+    process->nice = curr_process->nice;
     /* Yield current system foreground process status if holding one, which will allow the child to claim it if required */
     if (pc.fg_process != NULL){
-        if (pc.curr_process->pid == pc.fg_process->pid)
+        if (curr_process->pid == pc.fg_process->pid)
             pc.fg_process = NULL;
     }
     /* Copy the text, data, stack and other regions of the parent to the child process' memory */
     char currproc_filename[MAX_FILENAME_BYTES+MAX_EXTNAME_BYTES+2];
-    memcpy(currproc_filename, pc.curr_process->name, strlen(pc.curr_process->name));
-    memcpy(currproc_filename+strlen(pc.curr_process->name), ".BIN", 5);
-    if (!copy_uvm(process, pc.curr_process->page_map, currproc_filename))
+    memcpy(currproc_filename, curr_process->name, strlen(curr_process->name));
+    memcpy(currproc_filename+strlen(curr_process->name), ".BIN", 5);
+    if (!copy_uvm(process, curr_process->page_map, currproc_filename))
         return -1;
 
     /* Replicate the parent file descriptor table for the child since it shares all open files with the parent 
        Increment the global file table entry ref count of open files. The inode ref count will be incremented as usual */
-    memcpy(process->fd_table, pc.curr_process->fd_table, MAX_OPEN_FILES * sizeof(struct FileEntry*));
+    memcpy(process->fd_table, leader->fd_table, MAX_OPEN_FILES * sizeof(struct FileEntry*));
     for(int i = 0; i < MAX_OPEN_FILES; i++)
     {
-        if (process->fd_table[i] != NULL){
-            process->fd_table[i]->ref_count++;
-            process->fd_table[i]->inode->ref_count++;
-        }
+        if (process->fd_table[i] != NULL)
+            file_get(process->fd_table[i]);
     }
 
+    /* The child starts off with the FP registers of the parent, which are live on this core if it used them in its current slice */
+    if (curr_process->fp_used){
+        if (this_cpu()->fp_owner == curr_process)
+            fp_save(fp_state(curr_process));
+        memcpy(fp_state(process), fp_state(curr_process), sizeof(struct FpState));
+        process->fp_used = true;
+    }
     /* Copy the context frame so that the child process also resumes at the point after the fork call */
-    memcpy(process->reg_context, pc.curr_process->reg_context, sizeof(struct ContextFrame));
+    memcpy(process->reg_context, curr_process->reg_context, sizeof(struct ContextFrame));
     /* Transfer the parent environment to the child */
-    memcpy((void*)process->env, (void*)pc.curr_process->env, sizeof(struct Map));
-    /* Initialize signal handlers for the child process */
+    memcpy((void*)process->env, (void*)curr_process->env, sizeof(struct Map));
+    /* Initialize signal handlers for the child process. The blocked signals are inherited */
     init_handlers(process);
+    process->blocked = curr_process->blocked;
     /* Set the return value for child process to 0 */
     process->reg_context->x0 = 0;
     process->state = READY;
-    push_back(&pc.ready_que, (struct Node*)process);
+    ready_push(process);
 
     /* The parent process which called fork will be returned the child process PID */
     return process->pid;
 }
 
-int exec(struct Process* process, char* name, const char* args[])
+/* Copy the program arguments to the kernel heap of the process where they survive the user image being replaced
+   A trailing "&" is not passed on but makes the program a background job. Returns the size taken by the arguments */
+static int copy_args(struct Process* process, const char* args[])
 {
-    int fd;
-    uint32_t size;
-
-    fd = open_file(process, name);
-    if (fd == -1)
-        return -1;
-
-    /* Get the size and count of passed arguments for the new program */
     int arg_size = 0;
+
+    process->argc = 0;
     if (args != NULL){
         int new_arg_size;
         while (args[process->argc] != NULL)
@@ -627,10 +1314,8 @@ int exec(struct Process* process, char* name, const char* args[])
             new_arg_size = strlen(args[process->argc]);
             if (new_arg_size == 1 && args[process->argc][0] == '&'){
                 struct Process* parent = get_process(process->ppid);
-                if (parent != NULL && parent->state != KILLED){
-                    parent->jobs++;
-                    process->job_spec = parent->jobs;
-                }
+                if (parent != NULL && parent->state != KILLED)
+                    assign_job(parent, process);
                 process->daemon = true;
                 /* Yield the foreground status if inherited from the parent during a forking event */
                 if (pc.fg_process != NULL){
@@ -646,28 +1331,25 @@ int exec(struct Process* process, char* name, const char* args[])
     /* Copy the program arguments to the kernel heap */
     process->args = process->heap;
     char* arg_val_kh = (char*)process->args;
-    int arg_len[process->argc];
+    int arg_len;
     for(int i = 0; i < process->argc; i++)
     {
-        arg_len[i] = strlen(args[i]);
-        memcpy(arg_val_kh, (char*)args[i], arg_len[i]);
-        arg_val_kh[arg_len[i]] = 0;
-        arg_val_kh += (arg_len[i]+1);
+        arg_len = strlen(args[i]);
+        memcpy(arg_val_kh, (char*)args[i], arg_len);
+        arg_val_kh[arg_len] = 0;
+        arg_val_kh += (arg_len+1);
     }
-    /* Set new name in the process table entry. NOTE Parent process ID would remain the same */
-    int namelen = strlen(name);
-    memset(process->name, 0, sizeof(process->name));
-    memcpy(process->name, name, namelen-(MAX_EXTNAME_BYTES+1));
-    /* In exec call, the regions of the current process are overwritten with the regions of the new process and PID remains the same.
-       Hence there's no need to allocate new memory for the new program */
-    size = get_file_size(process, fd);
-    /* We use the userspace virt address as buffer because memory was previously allocated for the process which called exec */
-    size = read_file(process, fd, (void*)USERSPACE_BASE, size);
-    /* Here if the exec operation fails, only option is to exit because we've cleared the regions of original process */
-    if (size == UINT32_MAX)
-        exit(process, 1, false);
 
-    close_file(process, fd);
+    return arg_size;
+}
+
+/* Set up a program of given size loaded at the userspace base to run from its entry point with the arguments in the kernel heap
+   Accesses go through the userspace addresses hence the page map of the process has to be the active one */
+static void start_program(struct Process* process, uint32_t size, int arg_size)
+{
+    /* Length of the program file name which is passed as the first argument */
+    int namelen = strlen(process->name) + MAX_EXTNAME_BYTES + 1;
+
     /* Initialize bss segment */
     memset((void*)(USERSPACE_BASE+size), 0, DEF_BSS_SIZE);
     /* Clear any previously set custom handlers and initialize default signal handlers for the new process */
@@ -691,7 +1373,8 @@ int exec(struct Process* process, char* name, const char* args[])
 
     /* Copy program arguments from the kernel heap to user stack for the process to access */
     char* arg_val = (char*)process->reg_context->sp0;
-    arg_val_kh = (char*)process->args;
+    char* arg_val_kh = (char*)process->args;
+    int arg_len;
 
     memcpy(arg_val, process->name, namelen-(MAX_EXTNAME_BYTES+1));
     memcpy(arg_val+namelen-(MAX_EXTNAME_BYTES+1), ".BIN", MAX_EXTNAME_BYTES+2);
@@ -701,20 +1384,469 @@ int exec(struct Process* process, char* name, const char* args[])
     *(arg_val-1) = 0;
     for(int i = 0; i < process->argc; i++)
     {
-        memcpy(arg_val, arg_val_kh, arg_len[i]);
+        arg_len = strlen(arg_val_kh);
+        memcpy(arg_val, arg_val_kh, arg_len);
         *arg_ptr = (int64_t)arg_val;
         arg_ptr++;
-        arg_val += (arg_len[i]+1);
+        arg_val += (arg_len+1);
         *(arg_val-1) = 0;
-        arg_val_kh += (arg_len[i]+1);
+        arg_val_kh += (arg_len+1);
     }
 
     /* Save the argument addresses location on the stack to x1 to be used as second argument to main */
     process->reg_context->x1 = (int64_t)arg_ptr - (process->argc+1)*8;
+}
+
+/* Set the process name from the program file name by dropping the extension */
+static void set_name(struct Process* process, char* name)
+{
+    int namelen = strlen(name);
+    memset(process->name, 0, sizeof(process->name));
+    memcpy(process->name, name, namelen-(MAX_EXTNAME_BYTES+1));
+}
+
+int exec(struct Process* process, char* name, const char* args[])
+{
+    int fd;
+    uint32_t size;
+    int arg_size;
+
+    /* Replacing the image under running threads would pull the memory from under them */
+    if (process->tgid != process->pid || process->threads > 0)
+        return -1;
+    fd = open_file(process, name);
+    if (fd == -1)
+        return -1;
+
+    /* Get the size and count of passed arguments for the new program */
+    arg_size = copy_args(process, args);
+    /* Set new name in the process table entry. NOTE Parent process ID would remain the same */
+    set_name(process, name);
+    /* In exec call, the regions of the current process are overwritten with the regions of the new process and PID remains the same.
+       Hence there's no need to allocate new memory for the new program */
+    size = get_file_size(process, fd);
+    /* We use the userspace virt address as buffer because memory was previously allocated for the process which called exec */
+    size = read_file(process, fd, (void*)USERSPACE_BASE, size);
+    /* Here if the exec operation fails, only option is to exit because we've cleared the regions of original process */
+    if (size == UINT32_MAX)
+        exit(process, 1, false);
+
+    close_file(process, fd);
+    /* The new program starts off with cleared FP registers. Drop those of the old one if loaded */
+    if (this_cpu()->fp_owner == process){
+        this_cpu()->fp_owner = NULL;
+        set_fp_access(false);
+    }
+    process->fp_used = false;
+    /* A registered syscall ring was part of the replaced image */
+    process->ring = 0;
+    start_program(process, size, arg_size);
 
     return 0;
 }
 
+int spawn(struct Process* parent, char* name, const char* args[], const char* envs[], const struct SpawnActions* actions)
+{
+    struct Process* process;
+    char filename[MAX_FILENAME_BYTES+MAX_EXTNAME_BYTES+2];
+    uint64_t env;
+    uint32_t size;
+    int fd, arg_size;
+
+    /* Keep a copy of the file name since the user memory of the parent is out of reach once the page map of the child is active */
+    if (name == NULL || strlen(name) >= sizeof(filename) || (actions != NULL && (actions->count < 0 || actions->count > MAX_SPAWN_ACTIONS)))
+        return -1;
+    memcpy(filename, name, strlen(name)+1);
+    /* Fail before allocating anything if the program does not exist */
+    fd = open_file(parent, filename);
+    if (fd == -1)
+        return -1;
+    size = get_file_size(parent, fd);
+    close_file(parent, fd);
+
+    process = alloc_new_process();
+    if (process == NULL)
+        return -1;
+    /* Load the program straight into fresh memory of the child like for init. Nothing of the parent image is copied */
+    env = process->env;
+    if (!setup_uvm(process, filename)){
+        /* setup_uvm has released the page map already */
+        kfree(env);
+        free_slot(process);
+        return -1;
+    }
+    /* Keep the kernel address of the environment like a forked child */
+    process->env = env;
+    set_job(process, parent->pid, 0);
+    process->nice = parent->nice;
+    set_name(process, filename);
+
+    /* Pass on the parent environment unless the caller gives one as KEY=VALUE strings */
+    if (envs == NULL){
+        if (parent->env != 0)
+            memcpy((void*)process->env, (void*)parent->env, sizeof(struct Map));
+    }
+    else{
+        char key[MAX_KEY_LEN];
+        for (int i = 0; envs[i] != NULL; i++)
+        {
+            int sep = 0;
+            while (envs[i][sep] != 0 && envs[i][sep] != '=')
+                sep++;
+            if (envs[i][sep] != '=' || sep == 0 || sep >= MAX_KEY_LEN)
+                continue;
+            memcpy(key, (char*)envs[i], sep);
+            key[sep] = 0;
+            insert((struct Map*)process->env, key, envs[i]+sep+1);
+        }
+    }
+    /* Share the open files of the parent as a forked child would and then apply the requested changes to the child's table alone */
+    memcpy(process->fd_table, parent->fd_table, MAX_OPEN_FILES * sizeof(struct FileEntry*));
+    for(int i = 0; i < MAX_OPEN_FILES; i++)
+    {
+        if (process->fd_table[i] != NULL)
+            file_get(process->fd_table[i]);
+    }
+    for (int i = 0; actions != NULL && i < actions->count; i++)
+    {
+        if (actions->list[i].type == SPAWN_DUP2)
+            dup_file(process, actions->list[i].fd, actions->list[i].new_fd);
+        else if (actions->list[i].type == SPAWN_CLOSE)
+            close_file(process, actions->list[i].fd);
+    }
+    /* Yield current system foreground process status if holding one, which will allow the child to claim it if required */
+    if (pc.fg_process != NULL){
+        if (parent->pid == pc.fg_process->pid)
+            pc.fg_process = NULL;
+    }
+    arg_size = copy_args(process, args);
+
+    /* The arguments go on the user stack of the child, which is reached through its page map */
+    switch_vm(process->page_map);
+    start_program(process, size, arg_size);
+    switch_vm(parent->page_map);
+
+    process->state = READY;
+    ready_push(process);
+
+    return process->pid;
+}
+
+struct Process* get_group_leader(struct Process* process)
+{
+    struct Process* leader;
+
+    if (process->tgid == process->pid)
+        return process;
+    leader = get_process(process->tgid);
+    return leader != NULL ? leader : process;
+}
+
+/* Start a thread of the process at the given user entry point and stack. The argument is passed in x0
+   The thread ID is stored at the given user address, which is cleared and woken as a futex when the thread exits */
+int clone_thread(struct Process* process, uint64_t entry, uint64_t stack, uint64_t arg, int* tid)
+{
+    struct Process* leader = get_group_leader(process);
+    struct Process* thread;
+    uint64_t kpage;
+
+    if (leader->state == KILLED)
+        return -1;
+    /* The entry point and stack must lie in the user page shared with the process */
+    if (entry < USERSPACE_BASE || entry >= USERSPACE_BASE + PAGE_SIZE || stack <= USERSPACE_BASE || stack > USERSPACE_BASE + PAGE_SIZE)
+        return -1;
+    thread = alloc_slot();
+    if (thread == NULL)
+        return -1;
+    /* The thread has a page of its own only for the kernel stack and heap. The page map page belongs to the process */
+    kpage = (uint64_t)kalloc();
+    if (kpage == 0){
+        free_slot(thread);
+        return -1;
+    }
+    thread->kpage = kpage;
+    init_kernel_stack(thread, kpage);
+    thread->page_map = leader->page_map;
+    thread->env = leader->env;
+    thread->tgid = leader->pid;
+    thread->ppid = leader->ppid;
+    memcpy(thread->name, leader->name, sizeof(thread->name));
+    thread->nice = leader->nice;
+    thread->daemon = leader->daemon;
+    memcpy(thread->handlers, leader->handlers, sizeof(thread->handlers));
+    thread->blocked = process->blocked;
+
+    thread->reg_context->elr = entry;
+    /* The stack pointer at EL0 must be 16 byte aligned */
+    thread->reg_context->sp0 = stack & ~15UL;
+    thread->reg_context->x0 = arg;
+    if (tid != NULL){
+        *tid = thread->pid;
+        thread->clear_tid = (uint64_t)tid;
+    }
+    leader->threads++;
+    thread->state = READY;
+    ready_push(thread);
+
+    return thread->pid;
+}
+
+static struct WaitQueue* futex_queue(uint64_t map, uint64_t addr)
+{
+    return futex_queues + (((map ^ addr) >> 2) & (FUTEX_HASH_SIZE - 1));
+}
+
+/* Wake up to count waiters on the futex. Other futexes hashed to the same queue are left asleep */
+static int futex_wake(uint64_t map, uint64_t addr, int count)
+{
+    struct WaitQueue* queue = futex_queue(map, addr);
+    struct Link* link = queue->waiters.next;
+    struct Link* next;
+    struct Process* process;
+    int woken = 0;
+
+    if (link_empty(&queue->waiters))
+        return 0;
+    while (link != &queue->waiters && woken < count)
+    {
+        next = link->next;
+        process = container_of(link, struct Process, wait_link);
+        if (process->page_map == map && process->futex == addr){
+            wake_process(process);
+            woken++;
+        }
+        link = next;
+    }
+
+    return woken;
+}
+
+static void futex_sleep(struct Process* process, uint64_t addr)
+{
+    process->futex = addr;
+    sleep_on(futex_queue(process->page_map, addr), FUTEX_WAIT_EVENT);
+    process->futex = 0;
+}
+
+/* Kill the threads of a process. They are told through a signal since they may be running on other cores */
+void kill_threads(struct Process* process)
+{
+    for (int i = 1; i < PROC_TABLE_SIZE; i++)
+    {
+        if (process_table[i].state != UNUSED && process_table[i].tgid == process->pid && process_table + i != process)
+            kill(process, process_table[i].pid, SIGKILL);
+    }
+}
+
+void exit_thread(struct Process* thread)
+{
+    struct Cpu* core = this_cpu();
+    struct Process* leader = get_process(thread->tgid);
+    uint64_t map;
+
+    if (!ready_remove(thread))
+        wait_dequeue(thread);
+    if (thread->state == STOPPED)
+        remove(&pc.suspended, (struct Node*)thread);
+    /* Clear the thread ID and wake whoever joins the thread. The page map in use may be that of another process */
+    if (thread->clear_tid != 0){
+        map = TO_VIRT(read_gdt());
+        switch_vm(thread->page_map);
+        *(int*)thread->clear_tid = 0;
+        switch_vm(map);
+        futex_wake(thread->page_map, thread->clear_tid, INT32_MAX);
+    }
+    if (pc.fg_process == thread)
+        pc.fg_process = NULL;
+    if (!thread->daemon)
+        wake_up(FG_PAUSED);
+    /* The last thread of an exited process turns it into a zombie for its parent to reap */
+    if (leader != NULL){
+        add_usage(&leader->usage, &thread->usage);
+        leader->threads--;
+        if (leader->state == KILLED && leader->threads == 0)
+            make_zombie(leader);
+    }
+    free_slot(thread);
+    /* A thread cannot free the stack it runs on. The core frees it after switching to another process */
+    if (thread == core->curr_process){
+        if (core->dead_stack != 0)
+            kfree(core->dead_stack);
+        core->dead_stack = thread->kpage;
+    }
+    else
+        kfree(thread->kpage);
+}
+
+int futex(struct Process* process, uint32_t* addr, int op, uint32_t val)
+{
+    uint64_t uaddr = (uint64_t)addr;
+
+    /* The futex word must be aligned and lie in the user page of the process */
+    if (uaddr % sizeof(uint32_t) != 0 || uaddr < USERSPACE_BASE || uaddr >= USERSPACE_BASE + PAGE_SIZE)
+        return -1;
+    switch (op)
+    {
+    case FUTEX_WAIT:
+        /* The word is checked under the kernel lock so a wake up issued after the caller read it is not missed */
+        if (*addr != val)
+            return -1;
+        futex_sleep(process, uaddr);
+        return 0;
+    case FUTEX_WAKE:
+        return futex_wake(process->page_map, uaddr, val);
+    case FUTEX_LOCK:
+        /* Caches are disabled which makes exclusive loads and stores unreliable in user mode
+           The kernel lock serializes the test and set of a mutex instead */
+        while (*addr != 0){
+            futex_sleep(process, uaddr);
+            /* The event is retained if a caught signal woke the process. Bail out and let the syscall be restarted */
+            if (process->event != NONE)
+                return -1;
+        }
+        *addr = 1;
+        return 0;
+    case FUTEX_UNLOCK:
+        *addr = 0;
+        futex_wake(process->page_map, uaddr, 1);
+        return 0;
+    default:
+        break;
+    }
+
+    return -1;
+}
+
+/* Called on every return from an exception with the context frame to return to. If it is that of a user process with signals
+   to act on, they are delivered here where its own page tables are in place for a user handler to be set up on its stack */
+void deliver_signals(struct ContextFrame* ctx)
+{
+    struct Process* process = get_curr_process();
+
+    if ((ctx->spsr & PSTATE_MODE_MASK) != 0 || process->pid == 0 || !signal_pending(process))
+        return;
+    check_pending_signals(process);
+    /* A default action may have stopped or ended the process. Run something else until it is continued, if ever */
+    if (process->state != RUNNING)
+        schedule();
+}
+
+/* Charge the time since the last mark to the user or system time of the running process */
+static void charge_time(struct Process* process, bool user)
+{
+    uint64_t now = read_timer_count();
+
+    if (user)
+        process->usage.utime += now - process->mark;
+    else
+        process->usage.stime += now - process->mark;
+    process->mark = now;
+}
+
+/* Called on every entry to the kernel before the kernel lock is taken. The time up to a trap from user mode was spent running there */
+void account_entry(struct ContextFrame* ctx)
+{
+    if ((ctx->spsr & PSTATE_MODE_MASK) == 0)
+        charge_time(get_curr_process(), true);
+}
+
+/* Called last on every return from an exception. The time since the entry, or since the process was switched in, was spent in the kernel */
+void account_exit(struct ContextFrame* ctx)
+{
+    if ((ctx->spsr & PSTATE_MODE_MASK) == 0)
+        charge_time(get_curr_process(), false);
+}
+
+/* Fold the count of running and ready processes into the load averages once per LOAD_FREQ ticks. Called on the ticks of the boot core
+   The boot core takes no ticks while it idles, so samples missed meanwhile are caught up with the count at hand like a tickless Linux does */
+void calc_load(uint64_t ticks)
+{
+    uint64_t active = 0;
+
+    if (ticks < next_load_tick)
+        return;
+    for (int i = 0; i < MAX_CPUS; i++)
+    {
+        if (pc.cpus[i].online)
+            active += pc.cpus[i].ready_count + (pc.cpus[i].curr_process != pc.cpus[i].idle);
+    }
+    active *= FIXED_1;
+    while (ticks >= next_load_tick)
+    {
+        for (int i = 0; i < 3; i++)
+            load_avg[i] = (load_avg[i] * load_exp[i] + active * (FIXED_1 - load_exp[i])) >> FSHIFT;
+        next_load_tick += LOAD_FREQ;
+    }
+}
+
+/* Fill in the 1, 5 and 15 minute load averages in hundredths */
+void get_load_avg(uint64_t* loads)
+{
+    for (int i = 0; i < 3; i++)
+        loads[i] = (load_avg[i] * 100 + FIXED_1 / 2) >> FSHIFT;
+}
+
+/* Report the CPU usage of the process a thread belongs to, summed over its live threads, or that of its reaped children */
+int get_rusage(struct Process* process, int who, struct Rusage* usage)
+{
+    struct Process* leader = get_group_leader(process);
+    struct CpuUsage total;
+
+    if (who == RUSAGE_CHILDREN)
+        memcpy(&total, &leader->child_usage, sizeof(total));
+    else if (who == RUSAGE_SELF){
+        memcpy(&total, &leader->usage, sizeof(total));
+        for (int i = 1; leader->threads > 0 && i < PROC_TABLE_SIZE; i++)
+        {
+            if (process_table[i].state != UNUSED && process_table[i].tgid == leader->pid && process_table + i != leader)
+                add_usage(&total, &process_table[i].usage);
+        }
+    }
+    else
+        return -1;
+
+    usage->utime = to_usec(total.utime);
+    usage->stime = to_usec(total.stime);
+    usage->wait_time = to_usec(total.wait_time);
+    usage->nvcsw = total.nvcsw;
+    usage->nivcsw = total.nivcsw;
+    return 0;
+}
+
+/* Mark a signal pending on a process and get it acted on. A running process takes it on its way back to user mode
+   A sleeping one is woken up, which lets a syscall it is blocked in return or be acted on by the scheduler */
+static void post_signal(struct Process* process, int signal)
+{
+    /* Discard pending continue signal on reception of the stop signal and vice versa */
+    if (signal == SIGSTOP || signal == SIGTSTP)
+        process->signals &= ~(1 << SIGCONT);
+    else if (signal == SIGCONT)
+        process->signals &= ~((1 << SIGSTOP) | (1 << SIGTSTP));
+    process->signals |= (1 << signal);
+    /* A blocked signal stays pending until it is unblocked, after which the process delivers it to itself */
+    if (process->blocked & (1 << signal))
+        return;
+    switch (process->state)
+    {
+    case SLEEP:
+        wait_dequeue(process);
+        process->state = READY;
+        ready_push(process);
+        break;
+    case STOPPED:
+        if (signal == SIGKILL || signal == SIGCONT)
+            pc.suspended_signalled = true;
+        break;
+    case RUNNING:
+        /* A process running on another core may not trap for a whole tick, or at all if it is tickless */
+        if (pc.cpus + process->cpu != this_cpu())
+            kick_cpu(process->cpu);
+        break;
+    default:
+        break;
+    }
+}
+
 int kill(struct Process* process, int pid, int signal)
 {
     if (signal < 0 || signal > TOTAL_SIGNALS-1)
@@ -725,37 +1857,16 @@ int kill(struct Process* process, int pid, int signal)
             /* The signal is not meant for the process which sent it */
             if (process_table[i].pid == process->pid)
                 continue;
-            if (!(process_table[i].state == UNUSED || process_table[i].state == KILLED)){
-                /* Discard pending continue signal on reception of the stop signal and vice versa */
-                if (signal == SIGSTOP || signal == SIGTSTP)
-                    process_table[i].signals &= ~(1 << SIGCONT);
-                else if (signal == SIGCONT)
-                    process_table[i].signals &= ~((1 << SIGSTOP) | (1 << SIGTSTP));
-                process_table[i].signals |= (1 << signal);
-                /* Wake up sleeping processes to act on the broadcast signal */
-                if (process_table[i].state == SLEEP){
-                    remove(&pc.wait_list, (struct Node*)&process_table[i]);
-                    process_table[i].state = READY;
-                    push_back(&pc.ready_que, (struct Node*)&process_table[i]);
-                }
-            }
+            if (!(process_table[i].state == UNUSED || process_table[i].state == KILLED))
+                post_signal(&process_table[i], signal);
             else if (process_table[i].state == KILLED && signal == SIGHUP){
-                if (process_table[i].ppid != 1){ /* Release rogue or unattended zombie not owned by init */
+                /* A killed process with threads left is not a zombie yet and its memory is still in use */
+                if (process_table[i].ppid != 1 && process_table[i].threads == 0){ /* Release rogue or unattended zombie not owned by init */
                     free_uvm(process_table[i].page_map);
-                    /* Decrement ref counts of all files left open by the zombie */
-                    for(int i = 0; i < MAX_OPEN_FILES; i++)
-                    {
-                        if (process_table[i].fd_table[i] != NULL){
-                            process_table[i].fd_table[i]->ref_count--;
-                            process_table[i].fd_table[i]->inode->ref_count--;
-                            /* Note that we can't release the inode based on only the file entry ref count because other file entries could be pointing to it
-                            Hence the in core inode should be released (entry set to NULL) only if the inode ref count is zero */
-                            if (process_table[i].fd_table[i]->inode->ref_count == 0)
-                                process_table[i].fd_table[i]->inode = NULL;
-                        }
-                    }
-                    process_table[i].state = UNUSED;
-                    process_table[i].daemon = false;
+                    /* Close all files left open by the zombie */
+                    close_all_files(&process_table[i]);
+                    /* The slot goes straight back to the free list, which also takes it off the zombies list of its parent */
+                    free_slot(&process_table[i]);
                 }
             }
         }
@@ -764,9 +1875,9 @@ int kill(struct Process* process, int pid, int signal)
             (process_table+1)->signals |= (1 << signal);
             process_table->signals |= (1 << signal);
         }
-        /* Reset the PID counter on a system wide hang up signal which suggests user log out */
+        /* Start handing out PIDs from the bottom again on a system wide hang up signal which suggests user log out */
         if (signal == SIGHUP)
-            pid_num = 2;
+            next_pid = 2;
         return 0;
     }
     if (pid == 0){ /* Send signal to all children */
@@ -776,38 +1887,15 @@ int kill(struct Process* process, int pid, int signal)
             if (process_table[i].pid == process->pid)
                 continue;
             if (!(process_table[i].state == UNUSED || process_table[i].state == KILLED) && 
-                process->pid == process_table[i].ppid){
-                /* Discard pending continue signal on reception of the stop signal and vice versa */
-                if (signal == SIGSTOP || signal == SIGTSTP)
-                    process_table[i].signals &= ~(1 << SIGCONT);
-                else if (signal == SIGCONT)
-                    process_table[i].signals &= ~((1 << SIGSTOP) | (1 << SIGTSTP));
-                process_table[i].signals |= (1 << signal);
-                /* Wake up sleeping processes to act on the group signal */
-                if (process_table[i].state == SLEEP){
-                    remove(&pc.wait_list, (struct Node*)&process_table[i]);
-                    process_table[i].state = READY;
-                    push_back(&pc.ready_que, (struct Node*)&process_table[i]);
-                }
-            }
+                process->pid == process_table[i].ppid)
+                post_signal(&process_table[i], signal);
         }
         return 0;
     }
     struct Process* target_proc = get_process(pid);
     if (!target_proc)
         return -1;
-    /* Discard pending continue signal on reception of the stop signal and vice versa */
-    if (signal == SIGSTOP || signal == SIGTSTP)
-        target_proc->signals &= ~(1 << SIGCONT);
-    else if (signal == SIGCONT)
-        target_proc->signals &= ~((1 << SIGSTOP) | (1 << SIGTSTP));
-    target_proc->signals |= (1 << signal);
-    /* Wake up the process if sleeping and place it on the ready queue, for it to act on the received signal */
-    if (target_proc->state == SLEEP){
-        remove(&pc.wait_list, (struct Node*)target_proc);
-        target_proc->state = READY;
-        push_back(&pc.ready_que, (struct Node*)target_proc);
-    }
+    post_signal(target_proc, signal);
 
     return 0;
 }
@@ -24,6 +24,32 @@
 #include <lib/lib.h>
 #include "signal.h"
 
+struct PrioArray;
+
+/* FP/SIMD registers of a process in the layout stored by fp_save */
+struct FpState
+{
+    __uint128_t v[32];
+    uint64_t fpcr;
+    uint64_t fpsr;
+};
+
+/* Processes sleeping on a common condition, linked through their wait_link member */
+struct WaitQueue
+{
+    struct Link waiters;
+};
+
+/* CPU usage of a process. Times are in system counter increments */
+struct CpuUsage
+{
+    uint64_t utime; /* Time running in user mode */
+    uint64_t stime; /* Time running in the kernel on behalf of the process */
+    uint64_t wait_time; /* Time ready to run but waiting for a core */
+    uint64_t nvcsw; /* Context switches away from the process because it slept, stopped or exited */
+    uint64_t nivcsw; /* Context switches away from the process while it could still run i.e. preempted or yielded */
+};
+
 struct Process
 {
     struct Node* next; /* Member needed for the scheduler to maintain a linked list of processes */
@@ -32,41 +58,147 @@ struct Process
     uint32_t argc;
     int pid;
     int ppid;
+    int tgid; /* Thread group ID i.e. PID of the process a thread belongs to. Same as the PID for the process itself */
+    int threads; /* Live threads of a process other than the process itself */
     int wpid; /* PID a process is waiting on */
     int state;
     int status; /* Exit status of the process */
     bool daemon; /* Whether the process runs in the background as daemon */
     int jobs; /* Jobs created as a parent */
     int job_spec; /* Job specification as a child */
+    struct Process* pid_next; /* Next process in the same PID hash bucket */
+    struct Process* job_next; /* Next job in the same job hash bucket */
     int event; /* Event a process is waiting on */
+    struct Link wait_link; /* Node on the wait queue of the event. Unlinked if the process is not sleeping */
+    struct WaitQueue* wait_queue; /* Queue of the event, kept while the event is pending so that a syscall interrupted by a signal can sleep again */
+    struct WaitQueue child_wait; /* The process sleeps here in wait until a child changes state */
+    struct Link children; /* Children which have not exited yet, linked through their sibling member. Threads are no one's children */
+    struct Link zombies; /* Children which exited and await being reaped in wait */
+    struct Link sibling; /* Node on the children or zombies list of the parent */
+    bool zombie; /* Whether the process is on the zombies list of its parent */
+    uint64_t deadline; /* Tick at which a timed sleep ends */
+    int timer_index; /* Position on the sleep timer heap plus one. 0 if the process is not on it */
     uint64_t env; /* Process environment */
     uint64_t sp; /* Process kernel stack pointer */
     uint64_t page_map;
     uint64_t stack; /* Process kernel stack address */
     uint64_t heap; /* Process kernel heap address */
+    uint64_t kpage; /* Page holding the kernel stack of a thread. 0 for a process whose kernel stack is in its page map page */
+    uint64_t clear_tid; /* User address of the thread ID which is cleared and woken as a futex when the thread exits */
+    uint64_t futex; /* User address of the futex the process is waiting on */
+    uint64_t ring; /* User address of the syscall ring registered with ring_setup. 0 if none */
     uint32_t signals; /* Pending signals bit map */
+    uint32_t blocked; /* Signals held pending by sigprocmask */
+    int64_t syscall_x0; /* x0 of the last syscall, for restarting it after a signal handler since x0 is overwritten by the return value */
+    uint64_t cpu_ticks; /* Timer ticks during which the process was running */
+    struct CpuUsage usage; /* CPU usage of the process. That of exited threads is added to the process they belong to */
+    struct CpuUsage child_usage; /* CPU usage of reaped children, including that of the children they reaped */
+    uint64_t mark; /* System counter value up to which the running process has been charged time */
+    uint64_t ready_since; /* System counter value at which the process was last queued to run */
+    int cpu; /* Core whose run queue the process was last placed on */
+    int nice; /* Static priority from NICE_MIN (highest) to NICE_MAX (lowest) */
+    int boost; /* Levels the process is moved up by after waking from an input or pipe wait. Dropped once it uses up a time slice */
+    int prio; /* Run queue level the process is placed on */
+    int slice; /* Timer ticks left in the current time slice */
+    struct PrioArray* array; /* Priority array the process is queued on. NULL if it is not on a ready queue */
+    bool fp_used; /* Whether the process has used FP/SIMD registers. Only then are they saved and restored */
     struct FileEntry* fd_table[100]; /* A user file desc table which contains pointers to global file table entries */
     struct ContextFrame* reg_context;
     SIGHANDLER handlers[TOTAL_SIGNALS];
 };
 
-struct ProcessControl
+#define PROC_ARGS_SUMMARY 64
+
+/* Fixed size record of a process in a bulk snapshot. Layout matches struct procinfo in the user library */
+struct ProcInfo
+{
+    int pid;
+    int ppid;
+    int state;
+    int job_spec;
+    int nice;
+    char name[MAX_FILENAME_BYTES+1];
+    char args[PROC_ARGS_SUMMARY]; /* Null separated program arguments, truncated at an argument boundary */
+    uint32_t args_size; /* Bytes of args in use */
+    uint64_t cpu_ticks;
+    uint64_t rss; /* Resident memory in kB */
+    uint64_t utime; /* User time in microseconds */
+    uint64_t stime; /* System time in microseconds */
+    uint64_t wait_time; /* Run queue wait time in microseconds */
+    uint64_t nvcsw;
+    uint64_t nivcsw;
+};
+
+#define RUSAGE_SELF 0
+#define RUSAGE_CHILDREN -1
+
+/* Resource usage reported by getrusage with times in microseconds. Layout matches struct rusage in the user library */
+struct Rusage
+{
+    uint64_t utime;
+    uint64_t stime;
+    uint64_t wait_time;
+    uint64_t nvcsw;
+    uint64_t nivcsw;
+};
+
+/* Load averages are sampled every LOAD_FREQ ticks (5 seconds) and kept in fixed point with FSHIFT fraction bits
+   LOAD_EXP_n is FIXED_1/exp(5s/n min), the decay of the previous average over one sample */
+#define LOAD_FREQ 500
+#define FSHIFT 11
+#define FIXED_1 (1 << FSHIFT)
+#define LOAD_EXP_1 1884
+#define LOAD_EXP_5 2014
+#define LOAD_EXP_15 2037
+
+#define NICE_MIN -20
+#define NICE_MAX 19
+#define PRIO_LEVELS (NICE_MAX - NICE_MIN + 1) /* One ready queue per nice value */
+#define WAKEUP_BOOST 10
+#define PRIO_PROCESS 0
+
+/* Ready queues of a core indexed by priority level. Bit n of the bitmap is set if queue n is non empty */
+struct PrioArray
+{
+    uint64_t bitmap;
+    struct List queue[PRIO_LEVELS];
+};
+
+/* Per core scheduler state */
+struct Cpu
 {
+    bool online;
     struct Process* curr_process;
+    struct Process* idle; /* Idle process (PID 0) of the core */
+    struct PrioArray arrays[2];
+    struct PrioArray* active; /* Processes with time left in their slice */
+    struct PrioArray* expired; /* Processes which used up their slice. Swapped with the active array once that drains */
+    int ready_count; /* Processes on both arrays, used for load balancing */
+    uint64_t dead_stack; /* Kernel stack page of a thread which exited on this core. Freed once the core has switched off it */
+    struct Process* fp_owner; /* Process whose FP/SIMD registers are loaded on this core. NULL if EL0 access traps */
+};
+
+struct ProcessControl
+{
+    struct Spinlock lock; /* Kernel lock. See lock_kernel */
+    struct Cpu cpus[MAX_CPUS];
     struct Process* fg_process; /* Current foreground process. This is not the same as current process */
-    struct List ready_que;
-    struct List wait_list;
+    int sleepers; /* Processes on wait queues */
     struct List suspended;
-    struct List zombies; /* Processes that have exited and awaiting resource cleanup */
+    bool suspended_signalled; /* A stopped process was sent a signal it acts on. Only then are the suspended processes checked */
 };
 
 #define STACK_SIZE 0x21000 /* 132K */
 #define HEAP_SIZE 0x80000 /* 512K */
 #define DEF_BSS_SIZE 0x400 /* 1K */
 #define PROC_TABLE_SIZE 100
+#define PID_MAX 32768 /* PIDs are handed out below this and wrap around */
+#define PID_HASH_SIZE 128 /* Buckets of the PID and job indexes. Must be a power of 2 */
+#define FUTEX_HASH_SIZE 64 /* Buckets of futex wait queues. Must be a power of 2 */
 #define USERSPACE_CONTEXT_SIZE (12*8) /* 12 GPRs saved on the stack when context switch done by scheduler (see swap function) */
 #define REGISTER_POSITION(addr, n) ((uint64_t)(addr) + (n*8)) /* Position of nth 8-byte register from current address */
 #define MAX_OPEN_FILES 100
+#define MAX_SPAWN_ACTIONS 8
 #define WNOHANG 1
 #define WUNTRACED 2
 
@@ -77,7 +209,53 @@ enum En_SleepEvent
     STATE_CHANGE,
     KEYBOARD_INPUT,
     DAEMON_INPUT,
-    FG_PAUSED
+    FG_PAUSED,
+    FUTEX_WAIT_EVENT
+};
+
+enum En_FutexOp
+{
+    FUTEX_WAIT = 0,
+    FUTEX_WAKE,
+    FUTEX_LOCK,
+    FUTEX_UNLOCK
+};
+
+enum En_SpawnAction
+{
+    SPAWN_CLOSE = 1,
+    SPAWN_DUP2
+};
+
+/* File descriptor changes applied to a spawned child in order. Layout matches struct spawn_actions in the user library */
+struct SpawnAction
+{
+    int type;
+    int fd;
+    int new_fd; /* Target of a dup2 action */
+};
+
+struct SpawnActions
+{
+    int count;
+    struct SpawnAction list[MAX_SPAWN_ACTIONS];
+};
+
+/* Identity of a process published to user mode. Layout matches struct proc_record in the user library */
+struct ProcRecord
+{
+    int pid;
+    int ppid;
+};
+
+/* Contents of the page mapped read-only at USERSPACE_DATA in every process. Layout matches struct kernel_data in the user library
+   User programs read the time and their own identity from it without a system call */
+struct KernelData
+{
+    uint64_t timer_freq; /* Frequency of the system counter in Hz */
+    uint64_t boot_count; /* Counter value at which the kernel started keeping time */
+    uint64_t tick_interval; /* Counter increments per timer tick */
+    struct ProcRecord records[PROC_TABLE_SIZE]; /* Indexed by process table slot. TPIDRRO_EL0 points a running process to its own */
 };
 
 enum En_ProcessState
@@ -92,8 +270,30 @@ enum En_ProcessState
 };
 
 void init_process(void);
+void init_cpu_process(void);
+void lock_kernel(void);
+void unlock_kernel(void);
+void ready_push(struct Process* process);
+bool ready_remove(struct Process* process);
+bool ready_contains(struct Process* process);
+void yield(void);
+int get_priority(struct Process* process, int pid);
+int set_priority(struct Process* process, int pid, int nice);
 void trigger_scheduler(void);
 void swap(uint64_t* prev_sp_addr, uint64_t curr_sp);
+void fp_save(struct FpState* state);
+void fp_restore(const struct FpState* state);
+void set_fp_access(bool el0);
+void set_user_record(uint64_t addr);
+void deliver_signals(struct ContextFrame* ctx);
+void account_entry(struct ContextFrame* ctx);
+void account_exit(struct ContextFrame* ctx);
+void calc_load(uint64_t ticks);
+void get_load_avg(uint64_t* loads);
+int get_rusage(struct Process* process, int who, struct Rusage* usage);
+void fp_trap(struct Process* process);
+void fp_save_signal(struct Process* process, struct FpState* state);
+void fp_restore_signal(struct Process* process, struct FpState* state);
 void trap_return(void);
 struct Process* get_curr_process(void);
 struct Process *get_fg_process(void);
@@ -101,16 +301,33 @@ struct Process* get_process(int pid);
 int get_status(int pid);
 int get_proc_data(int pid, int* ppid, int* state, int* job_spec, char* name, char* args_buf);
 int get_active_pids(struct Process* process, int* pid_list, int all);
+int get_proc_snapshot(struct Process* process, struct ProcInfo* info, int max, int all);
 struct Process* find_job(int job_spec, int ppid);
+void assign_job(struct Process* parent, struct Process* process);
 void move_to_fore(struct Process* process);
 void move_to_back(struct Process* process);
 void switch_parent(int curr_ppid, int new_ppid, bool transfer_jobs);
 void sleep(int event);
+void sleep_on(struct WaitQueue* queue, int event);
+void sleep_until(uint64_t deadline);
+void wake_expired(uint64_t now);
+uint64_t next_deadline(void);
 void wake_up(int event);
+void wake_up_queue(struct WaitQueue* queue);
+void wake_parent(struct Process* process);
+void make_zombie(struct Process* process);
+void wait_dequeue(struct Process* process);
+void wait_requeue(struct Process* process);
 void exit(struct Process* process, int status, bool sig_handler_req);
 int wait(int pid, int* wstatus, int options);
 int fork(void);
 int exec(struct Process* process, char* name, const char* args[]);
+int clone_thread(struct Process* process, uint64_t entry, uint64_t stack, uint64_t arg, int* tid);
+void exit_thread(struct Process* thread);
+void kill_threads(struct Process* process);
+struct Process* get_group_leader(struct Process* process);
+int futex(struct Process* process, uint32_t* addr, int op, uint32_t val);
+int spawn(struct Process* parent, char* name, const char* args[], const char* envs[], const struct SpawnActions* actions);
 int kill(struct Process* process, int pid, int signal);
 
 #endif
\ No newline at end of file
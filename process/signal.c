@@ -19,6 +19,7 @@
 #include <memory/memory.h>
 #include "signal.h"
 #include "process.h"
+#include <fs/file.h>
 
 /* Maintain a table of default handlers to replace custom handler after single invokation */
 static SIGHANDLER def_handlers[TOTAL_SIGNALS];
@@ -31,56 +32,92 @@ static SIGHANDLER_PROXY proxy_handler = NULL;
 
 void def_handler_entry(int signal);
 
+/* Whether a signal is caught by a handler in the user program, which has to run in user mode on the process' own stack */
+bool signal_caught(struct Process* process, int signal)
+{
+    return process->handlers[signal] != NULL && !((uint64_t)(process->handlers[signal]) & KERNEL_BASE);
+}
+
+/* Signals which can be acted on. A stopped process only reacts to being killed or continued */
+static uint32_t deliverable_signals(struct Process* process)
+{
+    uint32_t pending = process->signals & ~process->blocked;
+
+    if (process->state == STOPPED)
+        pending &= (1 << SIGKILL) | (1 << SIGCONT);
+    return pending;
+}
+
+bool signal_pending(struct Process* process)
+{
+    return deliverable_signals(process) != 0;
+}
+
+/* Act on the pending signals of a process. The running process has them delivered on its way back to user mode (see deliver_signals)
+   where a user handler is set up on its own stack. Any other process only has its kernel handled signals acted on
+   and its caught signals are left pending for it to pick up once it runs, which saves switching page tables to reach its stack */
 void check_pending_signals(struct Process* process)
 {
-    if (process != NULL && process->signals > 0){
-        for(int i = 0; i < TOTAL_SIGNALS; i++)
-        {
-            /* Whether the process is still alive to check for precence of other signals */
-            if (process->state == UNUSED || process->state == KILLED)
-                break;
-            if (process->signals & (1 << i)){
-                bool user_handler = false;
-                if (process->state == STOPPED && !(i == SIGKILL || i == SIGCONT))
-                    continue;
-                if (process->handlers[i] != NULL){
-                    /* Custom handlers should be invoked in user mode only which can be deduced from the handler address */
-                    if (user_handler = !((uint64_t)(process->handlers[i]) & KERNEL_BASE)){
-                        switch_vm(process->page_map);
-                        int64_t el0_addr = process->reg_context->elr;
-                        /* Enable the proxy handler to run on eret which will invoke custom handler and restore previous context */
-                        process->reg_context->elr = (int64_t)proxy_handler;
-                        /* Save data required for proxy handler on user stack since proxy handler will run in user mode
-                           We avoid saving data in registers because redirection to proxy handler is not known to the process
-                           Thus, there is a substantial chance of data corruption if the kernel modifies any of the GPRs */
-                        process->reg_context->sp0 -= 24;
-                        int64_t* sp0 = (int64_t*)process->reg_context->sp0;
-                        sp0[0] = i;
-                        sp0[1] = (int64_t)process->handlers[i];
-                        sp0[2] = el0_addr;
-                        /* A SIGCONT should always cause a process to be continued regardless of whether it is caught or ignored */
-                        if (i == SIGCONT && !target_proc){
-                            target_proc = process;
-                            def_handler_entry(i);
-                        }
-                        /* Reset handler in process table entry to default */
-                        process->handlers[i] = def_handlers[i];
-                    }
-                    else{ /* Run default handler in kernel context */
-                        target_proc = process;
-                        process->handlers[i](i);
-                    }
+    bool running = process == get_curr_process();
+    uint32_t skipped = 0;
+    uint32_t pending;
+    int i;
+
+    if (process == NULL)
+        return;
+    /* Take the lowest pending signal off the bitmap each round rather than testing every signal number in turn */
+    while ((pending = deliverable_signals(process) & ~skipped) != 0)
+    {
+        /* Whether the process is still alive to check for precence of other signals */
+        if (process->state == UNUSED || process->state == KILLED)
+            break;
+        i = __builtin_ctz(pending);
+        bool user_handler = false;
+        if (process->handlers[i] != NULL){
+            /* Custom handlers should be invoked in user mode only which can be deduced from the handler address */
+            if (user_handler = signal_caught(process, i)){
+                /* A SIGCONT should always cause a process to be continued regardless of whether it is caught or ignored */
+                if (i == SIGCONT && process->state == STOPPED){
+                    target_proc = process;
+                    def_handler_entry(i);
                     target_proc = NULL;
                 }
-                /* Clear the signal by XORing specific bit, now that it is addressed */
-                process->signals ^= (1 << i);
-                /* Restore process state if it was interrupted during a syscall */
-                if (contains(&pc->ready_que, (struct Node*)process) && (process->event != NONE && !user_handler)){
-                    remove(&pc->ready_que, (struct Node*)process);
-                    process->state = SLEEP;
-                    push_back(&pc->wait_list, (struct Node*)process);
+                if (!running){
+                    skipped |= (1 << i);
+                    continue;
                 }
+                int64_t el0_addr = process->reg_context->elr;
+                /* Enable the proxy handler to run on eret which will invoke custom handler and restore previous context */
+                process->reg_context->elr = (int64_t)proxy_handler;
+                /* Save data required for proxy handler on user stack since proxy handler will run in user mode
+                   We avoid saving data in registers because redirection to proxy handler is not known to the process
+                   Thus, there is a substantial chance of data corruption if the kernel modifies any of the GPRs */
+                process->reg_context->sp0 -= SIGNAL_FRAME_SIZE + (process->fp_used ? sizeof(struct FpState) : 0);
+                int64_t* sp0 = (int64_t*)process->reg_context->sp0;
+                sp0[0] = i;
+                sp0[1] = (int64_t)process->handlers[i];
+                sp0[2] = el0_addr;
+                /* A syscall restarted after the handler needs the x0 it was made with, which is overwritten by the return value, and its calling convention */
+                sp0[3] = process->syscall_x0;
+                sp0[4] = process->reg_context->esr;
+                sp0[5] = process->fp_used;
+                if (process->fp_used)
+                    fp_save_signal(process, (struct FpState*)(sp0 + SIGNAL_FRAME_SIZE / 8));
+                /* Reset handler in process table entry to default */
+                process->handlers[i] = def_handlers[i];
             }
+            else{ /* Run default handler in kernel context */
+                target_proc = process;
+                process->handlers[i](i);
+            }
+            target_proc = NULL;
+        }
+        /* Clear the signal now that it is addressed */
+        process->signals &= ~(1 << i);
+        /* Restore process state if it was interrupted during a syscall */
+        if (ready_contains(process) && (process->event != NONE && !user_handler)){
+            ready_remove(process);
+            wait_requeue(process);
         }
     }
 }
@@ -94,10 +131,8 @@ void def_handler_entry(int signal)
     case SIGABRT:
     case SIGTERM: { /* Graceful termination where orphans are reassigned, parent informed and memory cleaned */
         /* Remove the process from applicable active queue */
-        if (contains(&pc->ready_que, (struct Node*)target_proc))
-            remove(&pc->ready_que, (struct Node*)target_proc);
-        else if (contains(&pc->wait_list, (struct Node*)target_proc))
-            remove(&pc->wait_list, (struct Node*)target_proc);
+        if (!ready_remove(target_proc))
+            wait_dequeue(target_proc);
         /* Invoke exit to do the rest */
         exit(target_proc, (1 << 8) | signal, true);
         break;
@@ -106,6 +141,11 @@ void def_handler_entry(int signal)
         /* Ignore kill request for idle and init process */
         if (target_proc->pid == 0 || target_proc->pid == 1)
             return;
+        /* A thread has no children or files of its own to hand over */
+        if (target_proc->tgid != target_proc->pid){
+            exit_thread(target_proc);
+            break;
+        }
         target_proc->status = 1 << 8;
         target_proc->status |= signal & 0x7f;
         /* Inform the parent and pass the child's exit status */
@@ -118,10 +158,8 @@ void def_handler_entry(int signal)
             remove(&pc->suspended, (struct Node*)target_proc);
         else{
             /* Remove the process from applicable active queue */
-            if (contains(&pc->ready_que, (struct Node*)target_proc))
-                remove(&pc->ready_que, (struct Node*)target_proc);
-            else if (contains(&pc->wait_list, (struct Node*)target_proc))
-                remove(&pc->wait_list, (struct Node*)target_proc);
+            if (!ready_remove(target_proc))
+                wait_dequeue(target_proc);
             /* Yield the current foreground status if holding one, for other processes to claim */
             if (pc->fg_process != NULL){
                 if (target_proc->pid == pc->fg_process->pid)
@@ -138,9 +176,12 @@ void def_handler_entry(int signal)
         target_proc->state = KILLED;
         target_proc->event = target_proc->pid;
         target_proc->daemon = false;
-        push_back(&pc->zombies, (struct Node*)target_proc);
+        close_all_files(target_proc);
+        /* The process becomes a zombie once the last of its threads is gone */
+        kill_threads(target_proc);
         /* Unblock the parent if it is waiting */
-        wake_up(STATE_CHANGE);
+        if (target_proc->threads == 0)
+            make_zombie(target_proc);
         break;
     }
     case SIGTSTP:
@@ -151,10 +192,8 @@ void def_handler_entry(int signal)
         if (target_proc->state == STOPPED)
             return;
         /* Remove the process from applicable active queue */
-        if (contains(&pc->ready_que, (struct Node*)target_proc))
-            remove(&pc->ready_que, (struct Node*)target_proc);
-        else if (contains(&pc->wait_list, (struct Node*)target_proc))
-            remove(&pc->wait_list, (struct Node*)target_proc);
+        if (!ready_remove(target_proc))
+            wait_dequeue(target_proc);
         target_proc->status |= 0x7f;
         /* Inform the parent and create job */
         struct Process* parent = get_process(target_proc->ppid);
@@ -162,10 +201,8 @@ void def_handler_entry(int signal)
             parent->signals |= (1 << SIGCHLD);
             parent->status = target_proc->status;
             parent->wpid = target_proc->pid;
-            if (!target_proc->job_spec){ /* Preserve job if already defined */
-                parent->jobs++;
-                target_proc->job_spec = parent->jobs;
-            }
+            if (!target_proc->job_spec) /* Preserve job if already defined */
+                assign_job(parent, target_proc);
         }
         /* Yield the current foreground status if holding one, for other processes to claim */
         if (pc->fg_process != NULL){
@@ -178,7 +215,7 @@ void def_handler_entry(int signal)
         target_proc->state = STOPPED;
         push_back(&pc->suspended, (struct Node*)target_proc);
         /* Unblock the parent if it is waiting */
-        wake_up(STATE_CHANGE);
+        wake_parent(target_proc);
         break;
     }
     case SIGCONT: {
@@ -191,23 +228,20 @@ void def_handler_entry(int signal)
             /* Restore the process' state based on the event field */
             if (target_proc->event == NONE){
                 target_proc->state = READY;
-                push_back(&pc->ready_que, (struct Node*)target_proc);
+                ready_push(target_proc);
             }
             else{
                 /* Convert input event if foreground process */
                 if (!target_proc->daemon && target_proc->event == DAEMON_INPUT)
                     target_proc->event = KEYBOARD_INPUT;
-                target_proc->state = SLEEP;
-                push_back(&pc->wait_list, (struct Node*)target_proc);
+                wait_requeue(target_proc);
             }
             /* Pause the current foreground process if signal is being handled for a foreground process */
             if (!target_proc->daemon){
                 if (pc->fg_process){
-                    pc->fg_process->state = SLEEP;
                     pc->fg_process->event = FG_PAUSED;
-                    if (contains(&pc->ready_que, (struct Node*)pc->fg_process))
-                        remove(&pc->ready_que, (struct Node*)pc->fg_process);
-                    push_back(&pc->wait_list, (struct Node*)pc->fg_process);
+                    ready_remove(pc->fg_process);
+                    wait_requeue(pc->fg_process);
                 }
                 pc->fg_process = target_proc;
             }
@@ -239,6 +273,33 @@ void register_handler(struct Process* process, int signal, SIGHANDLER new_handle
     }
 }
 
+int sigprocmask(struct Process* process, int how, const uint32_t* set, uint32_t* oldset)
+{
+    /* SIGKILL and SIGSTOP cannot be blocked, just like they cannot be caught or ignored */
+    uint32_t mask = set != NULL ? *set & ~((1 << SIGKILL) | (1 << SIGSTOP)) : 0;
+
+    if (oldset != NULL)
+        *oldset = process->blocked;
+    if (set == NULL)
+        return 0;
+    switch (how)
+    {
+    case SIG_BLOCK:
+        process->blocked |= mask;
+        break;
+    case SIG_UNBLOCK:
+        process->blocked &= ~mask;
+        break;
+    case SIG_SETMASK:
+        process->blocked = mask;
+        break;
+    default:
+        return -1;
+    }
+    /* Signals unblocked here are delivered on the way back to user mode */
+    return 0;
+}
+
 void set_sighandler_proxy(SIGHANDLER_PROXY handler)
 {
     proxy_handler = handler;
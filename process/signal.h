@@ -20,8 +20,14 @@
 #define SIGNAL_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #define TOTAL_SIGNALS 32
+/* Data pushed on the user stack for the proxy handler: signal, handler, interrupted address, and the x0 and syndrome of an interrupted syscall
+   The last slot tells whether the FP/SIMD registers of the interrupted context follow the frame */
+#define SIGNAL_FRAME_SIZE 48
+/* GPRs of the interrupted context saved by the proxy handler below the frame, x0-x30 in order */
+#define SIGNAL_CONTEXT_SIZE 256
 
 #define SIGHUP  1
 #define SIGINT  2
@@ -33,6 +39,11 @@
 #define SIGSTOP 19
 #define SIGTSTP 20 /* Stop signal issued from shell */
 
+/* How sigprocmask changes the blocked signals */
+#define SIG_BLOCK   0
+#define SIG_UNBLOCK 1
+#define SIG_SETMASK 2
+
 typedef void (*SIGHANDLER)(int);
 typedef void (*SIGHANDLER_PROXY)(void);
 
@@ -45,6 +56,9 @@ struct ProcessControl;
 void init_def_handlers(struct ProcessControl* proc_ctrl);
 void init_handlers(struct Process* process);
 void check_pending_signals(struct Process* process);
+bool signal_pending(struct Process* process);
+bool signal_caught(struct Process* process, int signal);
+int sigprocmask(struct Process* process, int how, const uint32_t* set, uint32_t* oldset);
 void register_handler(struct Process* process, int signal, SIGHANDLER new_handler);
 void set_sighandler_proxy(SIGHANDLER_PROXY handler);
 
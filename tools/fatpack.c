@@ -0,0 +1,468 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Host tool to repack the FAT disk image after files are copied in through a loop mount
+   Every file in the root directory is moved to consecutive clusters and a lookup index is written to the sectors
+   between the MBR and the partition (see struct FsIndexHeader in fs/file.h) which the kernel loads at mount
+   Subdirectories and their contents are left where they are
+   Usage: fatpack <disk image> */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SECTOR_SIZE 512
+#define PARTITION_ENTRY_OFFSET 0x1be
+#define MBR_SIGNATURE_OFFSET 0x1fe
+#define DIR_ENTRY_SIZE 32
+#define ENTRY_AVAILABLE 0
+#define ENTRY_DELETED 0xe5
+#define ATTR_VOLUME_LABEL 0x08
+#define ATTR_DIRECTORY 0x10
+#define ATTR_LONG_FILENAME 0x0f
+#define FAT16_MIN_CLUSTERS 4085
+#define FAT32_MIN_CLUSTERS 65525
+#define FAT32_ENTRY_MASK 0x0fffffff
+#define FSINFO_FREE_COUNT_OFFSET 488
+#define FSINFO_NEXT_FREE_OFFSET 492
+
+#define FS_INDEX_MAGIC 0x58494246 /* "FBIX" */
+#define FS_INDEX_LBA 1
+#define FS_INDEX_MIN_SLOTS 16
+#define FS_INDEX_MAX_SLOTS 512
+#define FS_INDEX_USED 1
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+struct FsIndexHeader
+{
+    uint32_t magic;
+    uint32_t slot_count;
+    uint32_t entry_count;
+    uint32_t partition_lba;
+};
+
+struct FsIndexEntry
+{
+    uint32_t hash;
+    uint32_t dir_index;
+    uint32_t cluster_index;
+    uint32_t file_size;
+    char name[8];
+    char ext[3];
+    uint8_t flags;
+    uint32_t reserved;
+};
+
+/* A file in the root directory to be moved */
+struct File
+{
+    uint8_t* entry;
+    uint32_t dir_index;
+    uint32_t* chain;
+    uint32_t length;
+};
+
+static uint8_t* image;
+static uint8_t* part;
+static int fat32;
+static uint32_t bytes_per_sector, cluster_size, cluster_count, fat_size, fat_count;
+static uint64_t fat_offset, root_offset, data_offset;
+static uint32_t root_entry_count, root_cluster, fs_info_sector;
+static uint8_t* pinned;
+
+static uint16_t get16(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put16(uint8_t* p, uint16_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t value)
+{
+    put16(p, value);
+    put16(p + 2, value >> 16);
+}
+
+static uint32_t get_fat(const uint8_t* fat, uint32_t cluster)
+{
+    return fat32 ? get32(fat + cluster * 4) & FAT32_ENTRY_MASK : get16(fat + cluster * 2);
+}
+
+static void set_fat(uint8_t* fat, uint32_t cluster, uint32_t value)
+{
+    if (fat32)
+        put32(fat + cluster * 4, (get32(fat + cluster * 4) & ~FAT32_ENTRY_MASK) | (value & FAT32_ENTRY_MASK));
+    else
+        put16(fat + cluster * 2, value);
+}
+
+static int valid_cluster(uint32_t cluster)
+{
+    return cluster >= 2 && cluster < cluster_count + 2;
+}
+
+static uint32_t end_of_chain(void)
+{
+    return fat32 ? 0x0ffffff8 : 0xfff8;
+}
+
+static uint32_t bad_cluster(void)
+{
+    return fat32 ? 0x0ffffff7 : 0xfff7;
+}
+
+static uint8_t* cluster_data(uint8_t* data, uint32_t cluster)
+{
+    return data + (uint64_t)(cluster - 2) * cluster_size;
+}
+
+static uint32_t entry_cluster(const uint8_t* entry)
+{
+    return get16(entry + 26) | (fat32 ? (uint32_t)get16(entry + 20) << 16 : 0);
+}
+
+/* Collect the cluster chain starting at cluster. Returns its length or 0 if it is broken or loops */
+static uint32_t get_chain(const uint8_t* fat, uint32_t cluster, uint32_t** chain)
+{
+    uint32_t length = 0;
+
+    *chain = malloc(sizeof(uint32_t) * (cluster_count + 1));
+    while (valid_cluster(cluster))
+    {
+        if (length == cluster_count){
+            free(*chain);
+            return 0;
+        }
+        (*chain)[length++] = cluster;
+        cluster = get_fat(fat, cluster);
+    }
+    if (cluster < end_of_chain()){
+        free(*chain);
+        return 0;
+    }
+    return length;
+}
+
+static int pin_chain(const uint8_t* fat, uint32_t cluster);
+
+/* Pin every cluster of a subdirectory and everything below it */
+static int pin_dir(const uint8_t* fat, uint32_t cluster)
+{
+    uint32_t* chain;
+    uint32_t length = get_chain(fat, cluster, &chain);
+
+    if (length == 0)
+        return -1;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        uint8_t* entry = cluster_data(part + data_offset, chain[i]);
+        for (uint32_t j = 0; j < cluster_size / DIR_ENTRY_SIZE; j++, entry += DIR_ENTRY_SIZE)
+        {
+            if (entry[0] == ENTRY_AVAILABLE)
+                break;
+            if (entry[0] == ENTRY_DELETED || entry[0] == '.' || entry[11] == ATTR_LONG_FILENAME || (entry[11] & ATTR_VOLUME_LABEL))
+                continue;
+            if (!valid_cluster(entry_cluster(entry)) || pinned[entry_cluster(entry)])
+                continue;
+            if (entry[11] & ATTR_DIRECTORY){
+                if (pin_chain(fat, entry_cluster(entry)) < 0 || pin_dir(fat, entry_cluster(entry)) < 0)
+                    return -1;
+            }
+            else if (pin_chain(fat, entry_cluster(entry)) < 0)
+                return -1;
+        }
+    }
+    free(chain);
+    return 0;
+}
+
+static int pin_chain(const uint8_t* fat, uint32_t cluster)
+{
+    uint32_t* chain;
+    uint32_t length = get_chain(fat, cluster, &chain);
+
+    if (length == 0)
+        return -1;
+    for (uint32_t i = 0; i < length; i++)
+        pinned[chain[i]] = 1;
+    free(chain);
+    return 0;
+}
+
+static uint32_t index_hash(const uint8_t* entry)
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+
+    for (int i = 0; i < 11; i++)
+        hash = (hash ^ entry[i]) * FNV_PRIME;
+    return hash;
+}
+
+/* Write the lookup index to the gap between the MBR and the partition if it fits */
+static void write_index(struct File* files, uint32_t file_count, uint32_t lba)
+{
+    struct FsIndexHeader header;
+    struct FsIndexEntry* table;
+    uint32_t slot_count = FS_INDEX_MIN_SLOTS;
+
+    /* Keep the table at most half full so that probe sequences stay short */
+    while (slot_count < file_count * 2)
+        slot_count *= 2;
+    if (slot_count > FS_INDEX_MAX_SLOTS || FS_INDEX_LBA + 1 + slot_count * sizeof(struct FsIndexEntry) / SECTOR_SIZE > lba){
+        fprintf(stderr, "fatpack: no room for a lookup index, the kernel will scan the directory\n");
+        if (lba > FS_INDEX_LBA)
+            memset(image + FS_INDEX_LBA * SECTOR_SIZE, 0, SECTOR_SIZE);
+        return;
+    }
+
+    table = calloc(slot_count, sizeof(struct FsIndexEntry));
+    for (uint32_t i = 0; i < file_count; i++)
+    {
+        uint32_t hash = index_hash(files[i].entry);
+        uint32_t slot = hash & (slot_count - 1);
+
+        while (table[slot].flags & FS_INDEX_USED)
+            slot = (slot + 1) & (slot_count - 1);
+        table[slot].hash = hash;
+        table[slot].dir_index = files[i].dir_index;
+        table[slot].cluster_index = entry_cluster(files[i].entry);
+        table[slot].file_size = get32(files[i].entry + 28);
+        memcpy(table[slot].name, files[i].entry, 8);
+        memcpy(table[slot].ext, files[i].entry + 8, 3);
+        table[slot].flags = FS_INDEX_USED;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = FS_INDEX_MAGIC;
+    header.slot_count = slot_count;
+    header.entry_count = file_count;
+    header.partition_lba = lba;
+    memset(image + FS_INDEX_LBA * SECTOR_SIZE, 0, SECTOR_SIZE);
+    memcpy(image + FS_INDEX_LBA * SECTOR_SIZE, &header, sizeof(header));
+    memcpy(image + (FS_INDEX_LBA + 1) * SECTOR_SIZE, table, slot_count * sizeof(struct FsIndexEntry));
+    free(table);
+}
+
+int main(int argc, char** argv)
+{
+    FILE* fp;
+    long image_size;
+    uint8_t *old_fat, *new_fat, *new_data, *bpb;
+    uint32_t lba = 0, total_sectors, sectors_per_fat, root_sectors, file_count = 0, next = 2, free_count = 0;
+    struct File* files;
+
+    if (argc != 2){
+        fprintf(stderr, "Usage: %s <disk image>\n", argv[0]);
+        return 1;
+    }
+    if ((fp = fopen(argv[1], "rb")) == NULL){
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(fp, 0, SEEK_END);
+    image_size = ftell(fp);
+    rewind(fp);
+    image = malloc(image_size);
+    if (image == NULL || image_size < SECTOR_SIZE || fread(image, 1, image_size, fp) != (size_t)image_size){
+        fprintf(stderr, "fatpack: failed to read %s\n", argv[1]);
+        return 1;
+    }
+    fclose(fp);
+
+    /* Locate the partition from the master boot record. A bare volume without a partition table has no room for an index */
+    if (get16(image + MBR_SIGNATURE_OFFSET) == 0xaa55 && get32(image + PARTITION_ENTRY_OFFSET + 8) != 0)
+        lba = get32(image + PARTITION_ENTRY_OFFSET + 8);
+    if ((uint64_t)lba * SECTOR_SIZE + SECTOR_SIZE > (uint64_t)image_size){
+        fprintf(stderr, "fatpack: partition out of bounds\n");
+        return 1;
+    }
+    part = image + (uint64_t)lba * SECTOR_SIZE;
+    bpb = part;
+    if (get16(bpb + MBR_SIGNATURE_OFFSET) != 0xaa55){
+        fprintf(stderr, "fatpack: invalid FAT signature\n");
+        return 1;
+    }
+
+    /* Work out the volume layout the same way the kernel does */
+    bytes_per_sector = get16(bpb + 11);
+    cluster_size = bytes_per_sector * bpb[13];
+    total_sectors = get16(bpb + 19) ? get16(bpb + 19) : get32(bpb + 32);
+    sectors_per_fat = get16(bpb + 22) ? get16(bpb + 22) : get32(bpb + 36);
+    fat_count = bpb[16];
+    root_entry_count = get16(bpb + 17);
+    if (cluster_size == 0 || bytes_per_sector == 0){
+        fprintf(stderr, "fatpack: invalid BIOS parameter block\n");
+        return 1;
+    }
+    root_sectors = (root_entry_count * DIR_ENTRY_SIZE + bytes_per_sector - 1) / bytes_per_sector;
+    fat_offset = (uint64_t)get16(bpb + 14) * bytes_per_sector;
+    fat_size = sectors_per_fat * bytes_per_sector;
+    root_offset = fat_offset + (uint64_t)fat_count * fat_size;
+    data_offset = root_offset + (uint64_t)root_sectors * bytes_per_sector;
+    cluster_count = (total_sectors - data_offset / bytes_per_sector) / bpb[13];
+    if (cluster_count < FAT16_MIN_CLUSTERS){
+        fprintf(stderr, "fatpack: FAT12 volumes are not supported\n");
+        return 1;
+    }
+    fat32 = cluster_count >= FAT32_MIN_CLUSTERS;
+    root_cluster = fat32 ? get32(bpb + 44) : 0;
+    fs_info_sector = fat32 ? get16(bpb + 48) : 0;
+    if ((uint64_t)lba * SECTOR_SIZE + data_offset + (uint64_t)cluster_count * cluster_size > (uint64_t)image_size){
+        fprintf(stderr, "fatpack: image is smaller than the volume\n");
+        return 1;
+    }
+
+    old_fat = part + fat_offset;
+    new_fat = calloc(1, fat_size);
+    new_data = calloc(cluster_count, cluster_size);
+    pinned = calloc(cluster_count + 2, 1);
+    files = calloc(cluster_count, sizeof(struct File));
+
+    /* Pin the clusters which stay in place. The FAT32 root directory, subdirectories with their contents and bad clusters */
+    for (uint32_t c = 2; c < cluster_count + 2; c++)
+    {
+        if (get_fat(old_fat, c) == bad_cluster())
+            pinned[c] = 1;
+    }
+    if (fat32 && pin_chain(old_fat, root_cluster) < 0){
+        fprintf(stderr, "fatpack: broken root directory chain\n");
+        return 1;
+    }
+
+    /* Gather the files of the root directory */
+    {
+        uint32_t* root_chain = NULL;
+        uint32_t entries = fat32 ? get_chain(old_fat, root_cluster, &root_chain) * (cluster_size / DIR_ENTRY_SIZE) : root_entry_count;
+        uint32_t per_cluster = cluster_size / DIR_ENTRY_SIZE;
+
+        for (uint32_t i = 0; i < entries; i++)
+        {
+            uint8_t* entry = fat32 ? cluster_data(part + data_offset, root_chain[i / per_cluster]) + (i % per_cluster) * DIR_ENTRY_SIZE
+                                   : part + root_offset + i * DIR_ENTRY_SIZE;
+            uint32_t cluster = entry_cluster(entry);
+
+            if (entry[0] == ENTRY_AVAILABLE)
+                break;
+            if (entry[0] == ENTRY_DELETED || entry[11] == ATTR_LONG_FILENAME || (entry[11] & ATTR_VOLUME_LABEL))
+                continue;
+            if (entry[11] & ATTR_DIRECTORY){
+                if (valid_cluster(cluster) && !pinned[cluster] && (pin_chain(old_fat, cluster) < 0 || pin_dir(old_fat, cluster) < 0)){
+                    fprintf(stderr, "fatpack: broken directory chain\n");
+                    return 1;
+                }
+                continue;
+            }
+            files[file_count].entry = entry;
+            files[file_count].dir_index = i;
+            if (valid_cluster(cluster)){
+                files[file_count].length = get_chain(old_fat, cluster, &files[file_count].chain);
+                if (files[file_count].length == 0){
+                    fprintf(stderr, "fatpack: broken cluster chain for directory entry %u\n", i);
+                    return 1;
+                }
+            }
+            file_count++;
+        }
+        free(root_chain);
+    }
+
+    /* Pinned clusters keep their table entries and data */
+    memcpy(new_fat, old_fat, fat32 ? 8 : 4);
+    for (uint32_t c = 2; c < cluster_count + 2; c++)
+    {
+        if (pinned[c]){
+            set_fat(new_fat, c, get_fat(old_fat, c));
+            memcpy(cluster_data(new_data, c), cluster_data(part + data_offset, c), cluster_size);
+        }
+    }
+    /* The FAT32 root directory was copied along with the pinned clusters and it is the copy which gets written back
+       Point the files at their entries in the copy so that the new start clusters are patched there */
+    if (fat32){
+        for (uint32_t i = 0; i < file_count; i++)
+            files[i].entry = new_data + (files[i].entry - (part + data_offset));
+    }
+
+    /* Lay out each file in the first run of free clusters long enough to hold it, in directory order */
+    for (uint32_t i = 0; i < file_count; i++)
+    {
+        struct File* file = files + i;
+        uint32_t start = next, run = 0;
+
+        if (file->length == 0)
+            continue;
+        while (run < file->length && start + run < cluster_count + 2)
+        {
+            if (pinned[start + run]){
+                start += run + 1;
+                run = 0;
+            }
+            else
+                run++;
+        }
+        if (run < file->length){
+            fprintf(stderr, "fatpack: no contiguous space for directory entry %u\n", file->dir_index);
+            return 1;
+        }
+        for (uint32_t j = 0; j < file->length; j++)
+        {
+            memcpy(cluster_data(new_data, start + j), cluster_data(part + data_offset, file->chain[j]), cluster_size);
+            set_fat(new_fat, start + j, j + 1 < file->length ? start + j + 1 : (fat32 ? FAT32_ENTRY_MASK : 0xffff));
+            pinned[start + j] = 1;
+        }
+        put16(file->entry + 26, start & 0xffff);
+        if (fat32)
+            put16(file->entry + 20, start >> 16);
+        next = start + file->length;
+    }
+
+    /* Write back every copy of the allocation table and the data region */
+    for (uint32_t i = 0; i < fat_count; i++)
+        memcpy(part + fat_offset + (uint64_t)i * fat_size, new_fat, fat_size);
+    memcpy(part + data_offset, new_data, (size_t)cluster_count * cluster_size);
+    if (fat32 && fs_info_sector != 0){
+        uint8_t* fs_info = part + (uint64_t)fs_info_sector * bytes_per_sector;
+        for (uint32_t c = 2; c < cluster_count + 2; c++)
+        {
+            if (get_fat(new_fat, c) == 0)
+                free_count++;
+        }
+        put32(fs_info + FSINFO_FREE_COUNT_OFFSET, free_count);
+        put32(fs_info + FSINFO_NEXT_FREE_OFFSET, next);
+    }
+    write_index(files, file_count, lba);
+
+    if ((fp = fopen(argv[1], "wb")) == NULL || fwrite(image, 1, image_size, fp) != (size_t)image_size){
+        fprintf(stderr, "fatpack: failed to write %s\n", argv[1]);
+        return 1;
+    }
+    fclose(fp);
+    printf("%s: %u files laid out in consecutive clusters\n", argv[1], file_count);
+
+    return 0;
+}
@@ -0,0 +1,212 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Host tool to pack a disk image into the chunked LZ4 format understood by the kernel (see fs/block.h)
+   Usage: zimage <disk image> <output image> */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define ZIMAGE_MAGIC 0x315a4246 /* "FBZ1" */
+#define CHUNK_SIZE (64*1024)
+#define MIN_MATCH 4
+#define LAST_LITERALS 5 /* The last 5 bytes of a block are always literals */
+#define MATCH_SAFE_DISTANCE 12 /* The last match must start at least 12 bytes before the end of a block */
+#define MAX_OFFSET 65535
+#define HASH_BITS 14
+
+struct ZImageHeader
+{
+    uint32_t magic;
+    uint32_t chunk_size;
+    uint32_t chunk_count;
+    uint32_t image_size;
+    uint32_t total_size;
+    uint32_t reserved[3];
+};
+
+static uint32_t read32(const uint8_t* p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t hash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static uint8_t* write_length(uint8_t* op, uint32_t length)
+{
+    while (length >= 255)
+    {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = length;
+    return op;
+}
+
+static uint8_t* write_sequence(uint8_t* op, const uint8_t* literals, uint32_t literal_len, uint32_t offset, uint32_t match_len)
+{
+    uint8_t* token = op++;
+
+    *token = (literal_len >= 15 ? 15 : literal_len) << 4;
+    if (literal_len >= 15)
+        op = write_length(op, literal_len - 15);
+    memcpy(op, literals, literal_len);
+    op += literal_len;
+    /* A zero match length marks the final literal only sequence */
+    if (match_len == 0)
+        return op;
+
+    *op++ = offset & 0xff;
+    *op++ = offset >> 8;
+    match_len -= MIN_MATCH;
+    *token |= match_len >= 15 ? 15 : match_len;
+    if (match_len >= 15)
+        op = write_length(op, match_len - 15);
+    return op;
+}
+
+/* Greedy single pass LZ4 block compressor with a hash table of the last position of each 4 byte sequence
+   Returns the compressed size, dst must hold at least the worst case of size + size/255 + 16 bytes */
+static uint32_t lz4_compress(const uint8_t* src, uint32_t size, uint8_t* dst)
+{
+    static uint32_t table[1 << HASH_BITS];
+    const uint8_t* anchor = src;
+    const uint8_t* ip = src;
+    const uint8_t* match_limit = src + size - LAST_LITERALS;
+    const uint8_t* src_limit = src + size - MATCH_SAFE_DISTANCE;
+    uint8_t* op = dst;
+
+    memset(table, 0xff, sizeof(table));
+    if (size >= MATCH_SAFE_DISTANCE){
+        while (ip < src_limit)
+        {
+            uint32_t h = hash(read32(ip));
+            uint32_t candidate = table[h];
+            const uint8_t* ref = src + candidate;
+
+            table[h] = ip - src;
+            if (candidate == UINT32_MAX || ip - ref > MAX_OFFSET || read32(ref) != read32(ip)){
+                ip++;
+                continue;
+            }
+            /* Extend the match forward, stopping short of the trailing literals */
+            uint32_t match_len = MIN_MATCH;
+            while (ip + match_len < match_limit && ip[match_len] == ref[match_len])
+                match_len++;
+            op = write_sequence(op, anchor, ip - anchor, ip - ref, match_len);
+            ip += match_len;
+            anchor = ip;
+        }
+    }
+    op = write_sequence(op, anchor, src + size - anchor, 0, 0);
+
+    return op - dst;
+}
+
+static int all_zero(const uint8_t* buf, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        if (buf[i] != 0)
+            return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    FILE *in, *out;
+    uint8_t *image, *packed, *compressed;
+    uint32_t *offsets;
+    struct ZImageHeader header;
+    long image_size;
+    uint32_t chunk_count, pos, table_size, packed_size = 0;
+
+    if (argc != 3){
+        fprintf(stderr, "Usage: %s <disk image> <output image>\n", argv[0]);
+        return 1;
+    }
+    if ((in = fopen(argv[1], "rb")) == NULL){
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    image_size = ftell(in);
+    rewind(in);
+
+    /* The last chunk is padded with zeros up to the chunk size */
+    chunk_count = (image_size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    image = calloc(chunk_count, CHUNK_SIZE);
+    packed = malloc((size_t)chunk_count * CHUNK_SIZE);
+    compressed = malloc(CHUNK_SIZE + CHUNK_SIZE / 255 + 16);
+    offsets = malloc((chunk_count + 1) * sizeof(uint32_t));
+    if (!image || !packed || !compressed || !offsets || fread(image, 1, image_size, in) != (size_t)image_size){
+        fprintf(stderr, "Failed to read %s\n", argv[1]);
+        return 1;
+    }
+    fclose(in);
+
+    table_size = sizeof(header) + (chunk_count + 1) * sizeof(uint32_t);
+    pos = table_size;
+    for (uint32_t i = 0; i < chunk_count; i++)
+    {
+        uint8_t* chunk = image + (size_t)i * CHUNK_SIZE;
+        uint32_t size = 0;
+
+        offsets[i] = pos;
+        if (!all_zero(chunk, CHUNK_SIZE)){
+            /* Keep the chunk stored as is if compression does not make it smaller */
+            size = lz4_compress(chunk, CHUNK_SIZE, compressed);
+            if (size >= CHUNK_SIZE){
+                size = CHUNK_SIZE;
+                memcpy(packed + packed_size, chunk, size);
+            }
+            else
+                memcpy(packed + packed_size, compressed, size);
+        }
+        packed_size += size;
+        pos += size;
+    }
+    offsets[chunk_count] = pos;
+
+    memset(&header, 0, sizeof(header));
+    header.magic = ZIMAGE_MAGIC;
+    header.chunk_size = CHUNK_SIZE;
+    header.chunk_count = chunk_count;
+    header.image_size = image_size;
+    header.total_size = pos;
+
+    if ((out = fopen(argv[2], "wb")) == NULL){
+        perror(argv[2]);
+        return 1;
+    }
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(offsets, sizeof(uint32_t), chunk_count + 1, out);
+    fwrite(packed, 1, packed_size, out);
+    fclose(out);
+    printf("%s: %ld bytes packed to %u bytes in %u chunks\n", argv[2], image_size, pos, chunk_count);
+
+    return 0;
+}
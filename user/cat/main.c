@@ -21,19 +21,15 @@
 static void print_usage(void)
 {
     printf("Usage:");
-    printf("\tcat [OPTION] FILE\n");
-    printf("\tConcatenate FILE to standard output (shell)\n\n");
+    printf("\tcat [OPTION] [FILE]\n");
+    printf("\tConcatenate FILE to standard output (shell)\n");
+    printf("\tWith no FILE, read standard input\n\n");
     printf("\t-h\tdisplay this help and exit\n");
 }
 
 int main(int argc, char** argv)
 {
-    int filearg = 1;
-    if (argc < 2){
-        printf("%s: bad usage\n", argv[0]);
-        printf("Try \'%s -h\' for more information\n", argv[0]);
-        return 1;
-    }
+    int filearg = 0;
     if (argc > 1){
         int opt = 1;
         while (opt < argc)
@@ -62,6 +58,19 @@ int main(int argc, char** argv)
         }
     }
     
+    uint32_t size_sent;
+    /* Copy standard input to standard output if no file is given, which lets cat terminate a pipeline */
+    if (filearg == 0){
+        while ((size_sent = sendfile(STDOUT_FILENO, STDIN_FILENO, NULL, UINT32_MAX)) > 0 && size_sent != UINT32_MAX);
+        /* Standard input is the console unless redirected, which can't be read as a file */
+        if (size_sent == UINT32_MAX){
+            printf("%s: bad usage\n", argv[0]);
+            printf("Try \'%s -h\' for more information\n", argv[0]);
+            return 1;
+        }
+        return 0;
+    }
+
     int filelen = strlen(argv[filearg]);
     char filename[filelen+1];
     memcpy(filename, argv[filearg], filelen);
@@ -73,16 +82,19 @@ int main(int argc, char** argv)
         printf("%s: %s: No such file or directory\n", argv[0], argv[filearg]);
         return 1;
     }
-    int file_size = get_file_size(fd);
-    char file_buf[file_size+1];
-    int size_read = read_file(fd, file_buf, file_size);
-    file_buf[file_size] = 0;
-
-    if (file_size != size_read){
-        printf("%s: %s: Error reading file\n", argv[0], argv[filearg]);
-        return 1;
+    /* Let the kernel stream the file to standard output in chunks instead of buffering all of it here */
+    uint32_t file_size = get_file_size(fd);
+    uint32_t offset = 0;
+    while (offset < file_size)
+    {
+        size_sent = sendfile(STDOUT_FILENO, fd, &offset, file_size - offset);
+        if (size_sent == 0 || size_sent == UINT32_MAX){
+            printf("%s: %s: Error reading file\n", argv[0], argv[filearg]);
+            close_file(fd);
+            return 1;
+        }
     }
-    printf("%s", file_buf);
+    close_file(fd);
 
     return 0;
 }
\ No newline at end of file
@@ -28,10 +28,8 @@ static int respawn(char* procname, const char* args[], int* new_pid)
 {
     int pid, ret = 0;
     
-    pid = fork();
-    if (pid == 0)
-        ret = exec(procname, args);
-    else if (pid == -1){
+    pid = spawn(procname, args, NULL, NULL);
+    if (pid == -1){
         printf("Init process failed to respawn %s\n", procname);
         ret = 1;
     }
@@ -44,11 +42,9 @@ static int respawn(char* procname, const char* args[], int* new_pid)
 int main(void)
 {
     printf("\nWelcome to %s!\n", stringify_value(NAME));
-    int pid = fork();
+    int pid = spawn("LOGIN.BIN", NULL, NULL, NULL);
     
-    if (pid == 0) /* Child process */
-        exec("LOGIN.BIN", NULL);
-    else if (pid == -1){
+    if (pid == -1){
         printf("Init process failed to spawn login shell!\n");
         return 1;
     }
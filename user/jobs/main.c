@@ -33,6 +33,21 @@ static void print_usage(void)
     printf("\t-s\trestrict output to stopped jobs\n");
 }
 
+/* Order the snapshot by PID with an insertion sort. Process counts are small */
+static void sort_procs(struct procinfo* procs, int count)
+{
+    struct procinfo key;
+    int j;
+
+    for (int i = 1; i < count; i++)
+    {
+        memcpy(&key, &procs[i], sizeof(key));
+        for (j = i - 1; j >= 0 && procs[j].pid > key.pid; j--)
+            memcpy(&procs[j+1], &procs[j], sizeof(key));
+        memcpy(&procs[j+1], &key, sizeof(key));
+    }
+}
+
 void display_job(int job_spec, int pid, char* name, char* args, int args_size, bool show_pid, bool running)
 {
     int args_pos = 0;
@@ -95,41 +110,34 @@ int main(int argc, char** argv)
             opt++;
         }
     }
-    int pid_count = get_active_procs(NULL, false);
-    int pid_list[pid_count];
-    if (pid_count > 0){
-        get_active_procs(pid_list, false);
-        sort(pid_list, pid_count);
-    }
-    else{
+    /* Jobs are children of the shell, take a snapshot of its session in one call */
+    int proc_count = get_proc_snapshot(NULL, 0, false);
+    if (proc_count <= 0){
         if (req_js != -1){
             printf("%s: %d: no such job\n", argv[0], req_js);
             return 1;
         }
         return 0;
     }
+    int max_procs = proc_count;
+    struct procinfo procs[max_procs];
+    proc_count = get_proc_snapshot(procs, max_procs, false);
+    /* More processes may have been created since the count was taken, only as many as fit are filled in */
+    if (proc_count > max_procs)
+        proc_count = max_procs;
+    sort_procs(procs, proc_count);
     
-    int job_spec, state;
-    char procname[MAX_FILENAME_BYTES+1];
-    for(int i = 0; i < pid_count; i++)
+    for(int i = 0; i < proc_count; i++)
     {
-        if (show_but_pid){
-            memset(procname, 0, sizeof(procname));
-            int args_size = get_proc_data(pid_list[i], NULL, &state, &job_spec, procname, NULL);
-            if (job_spec <= 0 || (req_js != -1 && req_js != job_spec))
-                continue;
-            char procargs[args_size];
-            if (args_size > 0)
-                get_proc_data(pid_list[i], NULL, NULL, NULL, NULL, procargs);
-            if ((show_stopped && state == STOPPED) || (show_running && !(state == STOPPED || state == KILLED)))
-                display_job(job_spec, pid_list[i], procname, procargs, args_size, show_pid, state != STOPPED);
-        }
-        else{
-            get_proc_data(pid_list[i], NULL, &state, &job_spec, NULL, NULL);
-            if (job_spec <= 0 || (req_js != -1 && req_js != job_spec))
-                continue;
-            if ((show_stopped && state == STOPPED) || (show_running && !(state == STOPPED || state == KILLED)))
-                printf("%d\n", pid_list[i]);
+        struct procinfo* proc = &procs[i];
+        int job_spec = proc->job_spec;
+        if (job_spec <= 0 || (req_js != -1 && req_js != job_spec))
+            continue;
+        if ((show_stopped && proc->state == STOPPED) || (show_running && !(proc->state == STOPPED || proc->state == KILLED))){
+            if (show_but_pid)
+                display_job(job_spec, proc->pid, proc->name, proc->args, proc->args_size, show_pid, proc->state != STOPPED);
+            else
+                printf("%d\n", proc->pid);
         }
         if (req_js == job_spec){
             req_js = -1;
@@ -17,10 +17,14 @@
  */
 
 #include "flib.h"
+#include "signal.h"
 #include <stdbool.h>
 
 #define MAX_SCAN_BUF_SIZE 1024
 
+uint64_t read_record(void);
+uint64_t read_counter(void);
+
 int strlen(const char* str)
 {
     int len = 0;
@@ -332,3 +336,167 @@ int scanf(const char *fmt, ...)
     va_end(ap);
     return assigned;
 }
+
+int sigemptyset(sigset_t* set)
+{
+    *set = 0;
+    return 0;
+}
+
+int sigfillset(sigset_t* set)
+{
+    *set = ~(sigset_t)0;
+    return 0;
+}
+
+int sigaddset(sigset_t* set, int signum)
+{
+    if (signum <= 0 || signum > SIGUNUSED)
+        return -1;
+    *set |= (1U << signum);
+    return 0;
+}
+
+int sigdelset(sigset_t* set, int signum)
+{
+    if (signum <= 0 || signum > SIGUNUSED)
+        return -1;
+    *set &= ~(1U << signum);
+    return 0;
+}
+
+int sigismember(const sigset_t* set, int signum)
+{
+    if (signum <= 0 || signum > SIGUNUSED)
+        return -1;
+    return (*set >> signum) & 1;
+}
+
+int ring_init(struct sys_ring* ring, struct ring_sqe* sqes, struct ring_cqe* cqes, uint32_t entries)
+{
+    memset(ring, 0, sizeof(struct sys_ring));
+    ring->entries = entries;
+    ring->sqes = sqes;
+    ring->cqes = cqes;
+    return ring_setup(ring);
+}
+
+/* Claim the next submission entry. It is run by the following ring_enter, hence must be filled in before that. NULL if the queue is full */
+struct ring_sqe* ring_get_sqe(struct sys_ring* ring)
+{
+    struct ring_sqe* sqe;
+
+    if (ring->sq_tail - ring->sq_head >= ring->entries)
+        return NULL;
+    sqe = &ring->sqes[ring->sq_tail & (ring->entries - 1)];
+    memset(sqe, 0, sizeof(struct ring_sqe));
+    ring->sq_tail++;
+    return sqe;
+}
+
+/* Oldest completion not yet consumed. NULL if there is none */
+struct ring_cqe* ring_peek_cqe(struct sys_ring* ring)
+{
+    if (ring->cq_head == ring->cq_tail)
+        return NULL;
+    return &ring->cqes[ring->cq_head & (ring->entries - 1)];
+}
+
+void ring_cqe_seen(struct sys_ring* ring)
+{
+    ring->cq_head++;
+}
+
+/* Process identity and time are read from the kernel data page without a system call */
+int getpid(void)
+{
+    return ((const struct proc_record*)read_record())->pid;
+}
+
+int getppid(void)
+{
+    return ((const struct proc_record*)read_record())->ppid;
+}
+
+/* Kernel timer ticks (10 ms each) since boot, derived from the counter exactly as the kernel does */
+uint64_t get_ticks(void)
+{
+    const struct kernel_data* data = (const struct kernel_data*)KERNEL_DATA_ADDR;
+
+    if (data->tick_interval == 0)
+        return 0;
+    return (read_counter() - data->boot_count) / data->tick_interval;
+}
+
+/* Nanoseconds since boot at the resolution of the system counter */
+uint64_t clock_ns(void)
+{
+    const struct kernel_data* data = (const struct kernel_data*)KERNEL_DATA_ADDR;
+    uint64_t count;
+
+    if (data->timer_freq == 0)
+        return 0;
+    count = read_counter() - data->boot_count;
+    /* Whole seconds and the remainder are scaled apart so that the product doesn't overflow */
+    return (count / data->timer_freq) * 1000000000 + (count % data->timer_freq) * 1000000000 / data->timer_freq;
+}
+
+int nice(int incr)
+{
+    int prio = getpriority(PRIO_PROCESS, 0) + incr;
+    /* Values out of range are clamped by the kernel */
+    if (setpriority(PRIO_PROCESS, 0, prio) < 0)
+        return -1;
+    return getpriority(PRIO_PROCESS, 0);
+}
+
+/* Turn a command name into the file name of its executable the way the shell runs commands i.e. in upper case with the BIN
+   extension appended if the name has none. Returns 0 on success, -1 if the name doesn't fit an 8.3 name and -2 for another extension */
+int resolve_prog(const char* name, char* prog)
+{
+    int namelen = strlen((char*)name);
+    int ext = namelen;
+
+    if (namelen > MAX_FILENAME_BYTES+MAX_EXTNAME_BYTES+1)
+        return -1;
+    memcpy(prog, (char*)name, namelen+1);
+    to_upper_str(prog);
+    /* The last dot separates the extension */
+    while (ext > 0 && prog[ext-1] != '.')
+        ext--;
+    if (ext == 0){
+        if (namelen > MAX_FILENAME_BYTES)
+            return -1;
+        memcpy(prog+namelen, ".BIN", MAX_EXTNAME_BYTES+2);
+    }
+    else if (memcmp(prog+ext, "BIN", MAX_EXTNAME_BYTES+1) != 0)
+        return -2;
+
+    return 0;
+}
+
+void spawn_actions_init(struct spawn_actions* actions)
+{
+    actions->count = 0;
+}
+
+static int spawn_add(struct spawn_actions* actions, int type, int fd, int new_fd)
+{
+    if (actions->count >= MAX_SPAWN_ACTIONS)
+        return -1;
+    actions->list[actions->count].type = type;
+    actions->list[actions->count].fd = fd;
+    actions->list[actions->count].new_fd = new_fd;
+    actions->count++;
+    return 0;
+}
+
+int spawn_add_dup2(struct spawn_actions* actions, int fd, int new_fd)
+{
+    return spawn_add(actions, SPAWN_DUP2, fd, new_fd);
+}
+
+int spawn_add_close(struct spawn_actions* actions, int fd)
+{
+    return spawn_add(actions, SPAWN_CLOSE, fd, -1);
+}
@@ -37,13 +37,140 @@ struct DirEntry {
     uint16_t create_time;
     uint16_t create_date;
     uint16_t access_date;
-    uint16_t attr_index;
+    uint16_t cluster_index_hi;
     uint16_t m_time;
     uint16_t m_date;
     uint16_t cluster_index;
     uint32_t file_size;
 } __attribute__((packed));
 
+/* Segment of a scatter-gather transfer with readv and writev */
+struct iovec {
+    void* iov_base;
+    size_t iov_len;
+};
+
+#define PROC_ARGS_SUMMARY 64
+
+/* Record of a process filled in by get_proc_snapshot */
+struct procinfo {
+    int pid;
+    int ppid;
+    int state;
+    int job_spec;
+    int nice;
+    char name[9];
+    char args[PROC_ARGS_SUMMARY]; /* Null separated program arguments */
+    uint32_t args_size;
+    uint64_t cpu_ticks;
+    uint64_t rss; /* Resident memory in kB */
+    uint64_t utime; /* User time in microseconds */
+    uint64_t stime; /* System time in microseconds */
+    uint64_t wait_time; /* Time spent waiting to run in microseconds */
+    uint64_t nvcsw; /* Voluntary context switches */
+    uint64_t nivcsw; /* Involuntary context switches */
+};
+
+#define RUSAGE_SELF 0
+#define RUSAGE_CHILDREN -1
+
+/* CPU usage of the calling process or of its reaped children filled in by getrusage. Times are in microseconds */
+struct rusage {
+    uint64_t ru_utime;
+    uint64_t ru_stime;
+    uint64_t ru_wait;
+    uint64_t ru_nvcsw;
+    uint64_t ru_nivcsw;
+};
+
+#define MAX_SPAWN_ACTIONS 8
+
+enum En_SpawnAction
+{
+    SPAWN_CLOSE = 1,
+    SPAWN_DUP2
+};
+
+/* File descriptor changes applied in order to the child of spawn before it starts */
+struct spawn_actions {
+    int count;
+    struct {
+        int type;
+        int fd;
+        int new_fd;
+    } list[MAX_SPAWN_ACTIONS];
+};
+
+/* Operations of the futex system call */
+enum En_FutexOp
+{
+    FUTEX_WAIT = 0, /* Sleep if the word still holds the given value */
+    FUTEX_WAKE, /* Wake up to the given count of waiters */
+    FUTEX_LOCK, /* Take the word as a mutex, sleeping while it is held */
+    FUTEX_UNLOCK /* Release the mutex and wake a waiter */
+};
+
+#define RING_ENTRIES_MAX 256
+
+/* Syscalls commonly batched on a syscall ring. The op of a ring entry is the syscall number and its args are those of the library call in order */
+enum En_RingOp
+{
+    RING_OP_WRITE = 0, /* writeu */
+    RING_OP_SLEEP = 1, /* msleep */
+    RING_OP_WAIT = 3, /* waitpid */
+    RING_OP_OPEN = 4,
+    RING_OP_CLOSE = 5,
+    RING_OP_FILE_SIZE = 6,
+    RING_OP_READ = 7,
+    RING_OP_GETCHAR = 10,
+    RING_OP_GETPID = 11,
+    RING_OP_PROC_DATA = 15,
+    RING_OP_WRITE_FILE = 27,
+    RING_OP_SENDFILE = 31
+};
+
+/* Submission entry of a syscall ring */
+struct ring_sqe {
+    int64_t op;
+    int64_t args[6];
+    uint64_t user_data; /* Copied to the completion to tell it apart */
+};
+
+/* Completion entry of a syscall ring */
+struct ring_cqe {
+    uint64_t user_data;
+    int64_t result; /* Return value of the syscall. -1 for an op which can't be run from a ring (exit, fork, exec, thread_create) */
+};
+
+/* Syscall ring registered with the kernel. Layout matches struct SyscallRing in the kernel
+   Entries queued with ring_get_sqe run in order in one trap on ring_enter, and completions are collected with ring_peek_cqe
+   A ring belongs to the thread which registered it and isn't inherited by a forked child */
+struct sys_ring {
+    uint32_t sq_head; /* Advanced by the kernel */
+    uint32_t sq_tail;
+    uint32_t cq_head;
+    uint32_t cq_tail; /* Advanced by the kernel */
+    uint32_t entries; /* Slots in each queue. Must be a power of 2 up to RING_ENTRIES_MAX */
+    uint32_t reserved;
+    struct ring_sqe* sqes;
+    struct ring_cqe* cqes;
+};
+
+#define KERNEL_DATA_ADDR 0x800000 /* Read-only page the kernel maps into every process */
+
+/* Timer calibration at the start of the kernel data page. Layout matches struct KernelData in the kernel */
+struct kernel_data {
+    uint64_t timer_freq; /* Frequency of the system counter in Hz */
+    uint64_t boot_count; /* Counter value at which the kernel started keeping time */
+    uint64_t tick_interval; /* Counter increments per timer tick */
+};
+
+/* Identity of the running process on the kernel data page */
+struct proc_record {
+    int pid;
+    int ppid;
+};
+
 enum En_ProcessState
 {
     UNUSED = 0,
@@ -76,6 +203,14 @@ enum En_ProcessState
 #define ASCII_CTRL_C 0x03
 #define ASCII_CTRL_Z 26
 
+#define PRIO_PROCESS 0
+#define NZERO 20 /* Range of nice values is [-NZERO, NZERO-1] */
+
+#define STDIN_FILENO 0
+#define STDOUT_FILENO 1
+#define STDERR_FILENO 2
+#define IOV_MAX 16
+
 int printf(const char* fmt, ...);
 int scanf(const char *fmt, ...);
 char* itoa(int);
@@ -102,14 +237,37 @@ void sort(int* arr, size_t size);
 
 int writeu(char* buf, int buf_size);
 void msleep(uint64_t ticks_10ms);
+uint64_t get_ticks(void);
+uint64_t clock_ns(void);
 int open_file(char* filename);
 int close_file(int fd);
 uint32_t get_file_size(int fd);
 uint32_t read_file(int fd, void* buffer, uint32_t size);
+int create_file(char* filename);
+uint32_t write_file(int fd, void* buffer, uint32_t size);
+int remove_file(char* filename);
+int pipe(int fds[2]);
+int dup2(int oldfd, int newfd);
+uint32_t sendfile(int out_fd, int in_fd, uint32_t* offset, uint32_t count);
+int readv(int fd, const struct iovec* iov, int iovcnt);
+int writev(int fd, const struct iovec* iov, int iovcnt);
 int fork(void);
 int wait(int* wstatus);
 int waitpid(int pid, int* wstatus, int options);
 int exec(char* prog_file, const char* args[]);
+int spawn(char* prog_file, const char* args[], const char* envp[], const struct spawn_actions* actions);
+int resolve_prog(const char* name, char* prog);
+void spawn_actions_init(struct spawn_actions* actions);
+int spawn_add_dup2(struct spawn_actions* actions, int fd, int new_fd);
+int spawn_add_close(struct spawn_actions* actions, int fd);
+int thread_create(void (*entry)(void*), void* stack, void* arg, volatile int* tid);
+int futex(volatile uint32_t* addr, int op, uint32_t val);
+int ring_setup(struct sys_ring* ring);
+int ring_enter(uint32_t to_submit);
+int ring_init(struct sys_ring* ring, struct ring_sqe* sqes, struct ring_cqe* cqes, uint32_t entries);
+struct ring_sqe* ring_get_sqe(struct sys_ring* ring);
+struct ring_cqe* ring_peek_cqe(struct sys_ring* ring);
+void ring_cqe_seen(struct sys_ring* ring);
 void exit(int status);
 int kill(int pid, int signum);
 void signal(int signum, void (*handler)(int));
@@ -120,6 +278,13 @@ int get_pstatus(void);
 int get_proc_data(int pid, int* ppid, int* state, int* job_spec, char* procname, char* procargs);
 int read_root_dir(void* buf);
 int get_active_procs(int* pid_list, int all);
+int get_proc_snapshot(struct procinfo* info, int max, int all);
+int getrusage(int who, struct rusage* usage);
+int getloadavg(uint64_t loads[3]);
+int sched_yield(void);
+int getpriority(int which, int who);
+int setpriority(int which, int who, int prio);
+int nice(int incr);
 int setjobctl(int job_spec, int req);
 int getjpid(int job_spec);
 int setenv(const char *name, const char *value, int overwrite);
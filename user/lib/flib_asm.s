@@ -75,10 +75,10 @@
 .global fork
 .global exec
 .global getchar
-.global getpid
+.global read_record
+.global read_counter
 .global getjpid
 .global read_root_dir
-.global getppid
 .global get_active_procs
 .global get_pstatus
 .global get_proc_data
@@ -90,6 +90,26 @@
 .global unsetenv
 .global getfullenv
 .global switchpenv
+.global create_file
+.global write_file
+.global remove_file
+.global pipe
+.global dup2
+.global sendfile
+.global readv
+.global writev
+.global get_proc_snapshot
+.global sched_yield
+.global getpriority
+.global setpriority
+.global spawn
+.global thread_create
+.global futex
+.global ring_setup
+.global ring_enter
+.global sigprocmask
+.global getrusage
+.global getloadavg
 
 memset:
     # x0 => dst x1 => value x2 => size
@@ -165,60 +185,27 @@ copy:
 memcpy_end:
     ret
 
+# System call stubs. Under the register ABI (svc #1) the kernel takes the syscall number in x8 and up to 6 arguments in x0-x5
+# which is where the caller already placed them, hence the stubs only load the number. The return value comes back in x0
 writeu:
-    # Allocate 16 bytes on the stack to accomodate the args to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the args on the stack beforehand
-    sub sp, sp, #16
     # Set the syscall index to 0 (write screen) in x8
     mov x8, #0
-    stp x0, x1, [sp]
-    # Load the arg count in x0
-    mov x0, #2
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #16
+    # Operating system trap with the arguments left in x0 and x1 (register ABI)
+    svc #1
     ret
 
 msleep:
-    # Allocate 8 bytes on the stack to accomodate the argument to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the arg on the stack beforehand
-    sub sp, sp, #8
-    str x0, [sp]
     # Set the syscall index to 1 (sleep) in x8
     mov x8, #1
-    # Load the arg count in x0
-    mov x0, #1
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #8
+    # Operating system trap with the argument left in x0 (register ABI)
+    svc #1
     ret
 
 exit:
-    # Allocate 8 bytes on the stack to accomodate the argument to this function
-    # We need the registers for other purposes hence saving the arg on the stack beforehand
-    sub sp, sp, #8
-    str x0, [sp]
     # Set the syscall index to 2 (exit) in x8
     mov x8, #2
-    # Load the arg count in x0
-    mov x0, #1
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #8
+    # Operating system trap with the argument left in x0 (register ABI)
+    svc #1
     ret
 
 wait:
@@ -228,316 +215,128 @@ wait:
     neg x0, x0
     mov x2, 0
 waitpid:
-    # Allocate 24 bytes on the stack to accomodate the argument to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the arg on the stack beforehand
-    sub sp, sp, #24
-    stp x0, x1, [sp]
-    str x2, [sp, #16]
     # Set the syscall index to 3 (wait) in x8
     mov x8, #3
-    # Load the arg count in x0
-    mov x0, #3
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #24
+    # Operating system trap with the arguments left in x0-x2 (register ABI)
+    svc #1
     ret
 
 open_file:
-    # Allocate 8 bytes on the stack to accomodate the argument to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the arg on the stack beforehand
-    sub sp, sp, #8
-    str x0, [sp]
     # Set the syscall index to 4 (open file) in x8
     mov x8, #4
-    # Load the arg count in x0
-    mov x0, #1
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #8
+    # Operating system trap with the argument left in x0 (register ABI)
+    svc #1
     ret
 
 close_file:
-    # Allocate 8 bytes on the stack to accomodate the argument to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the arg on the stack beforehand
-    sub sp, sp, #8
-    str x0, [sp]
     # Set the syscall index to 5 (close file) in x8
     mov x8, #5
-    # Load the arg count in x0
-    mov x0, #1
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #8
+    # Operating system trap with the argument left in x0 (register ABI)
+    svc #1
     ret
 
 get_file_size:
-    # Allocate 8 bytes on the stack to accomodate the argument to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the arg on the stack beforehand
-    sub sp, sp, #8
-    str x0, [sp]
     # Set the syscall index to 6 (file size) in x8
     mov x8, #6
-    # Load the arg count in x0
-    mov x0, #1
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #8
+    # Operating system trap with the argument left in x0 (register ABI)
+    svc #1
     ret
 
 read_file:
-    # Allocate 24 bytes on the stack to accomodate the args to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the args on the stack beforehand
-    sub sp, sp, #24
-    stp x0, x1, [sp]
-    str x2, [sp, #16]
     # Set the syscall index to 7 (read file) in x8
     mov x8, #7
-    # Load the arg count in x0
-    mov x0, #3
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #24
+    # Operating system trap with the arguments left in x0-x2 (register ABI)
+    svc #1
     ret
 
 fork:
-    # No arguments to this syscall hence no stack space required
     # Set the syscall index to 8 (fork) in x8
     mov x8, #8
-    # Load the arg count in x0
-    mov x0, #0
-    # Operating system trap
-    svc #0
+    # Operating system trap (register ABI)
+    svc #1
     ret
 
 exec:
-    # Allocate 16 bytes on the stack to accomodate the args to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the args on the stack beforehand
-    sub sp, sp, #16
-    stp x0, x1, [sp]
     # Set the syscall index to 9 (exec) in x8
     mov x8, #9
-    # Load the arg count in x0
-    mov x0, #2
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #16
+    # Operating system trap with the arguments left in x0 and x1 (register ABI)
+    svc #1
     ret
 
 getchar:
-    # No arguments to this syscall hence no stack space required
     # Set the syscall index to 10 (get pressed key) in x8
     mov x8, #10
-    # Load the arg count in x0
-    mov x0, #0
-    # Operating system trap
-    svc #0
+    # Operating system trap (register ABI)
+    svc #1
     ret
 
-getpid:
-    # No arguments to this syscall hence no stack space required
-    # Set the syscall index to 11 (get process ID) in x8
-    mov x8, #11
-    # Load the arg count in x0
-    mov x0, #0
-    # Operating system trap
-    svc #0
+read_record:
+    # The kernel keeps the read-only thread ID register pointed at the record of the running process on the kernel data page
+    mrs x0, tpidrro_el0
+    ret
+
+read_counter:
+    # The instruction barrier keeps the virtual counter, which the kernel lets EL0 read, from being read ahead of preceding instructions
+    isb
+    mrs x0, cntvct_el0
     ret
 
 getjpid:
-    # Allocate 8 bytes on the stack to accomodate the argument to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the arg on the stack beforehand
-    sub sp, sp, #8
-    str x0, [sp]
     # Set the syscall index to 20 (get process ID of a job) in x8
     mov x8, #20
-    # Load the arg count in x0
-    mov x0, #1
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #8
+    # Operating system trap with the argument left in x0 (register ABI)
+    svc #1
     ret
 
 read_root_dir:
-    # Allocate 8 bytes on the stack to accomodate the argument to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the arg on the stack beforehand
-    sub sp, sp, #8
-    str x0, [sp]
     # Set the syscall index to 12 (read root directory table) in x8
     mov x8, #12
-    # Load the arg count in x0
-    mov x0, #1
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #8
-    ret
-
-getppid:
-    # No arguments to this syscall hence no stack space required
-    # Set the syscall index to 13 (get parent process ID) in x8
-    mov x8, #13
-    # Load the arg count in x0
-    mov x0, #0
-    # Operating system trap
-    svc #0
+    # Operating system trap with the argument left in x0 (register ABI)
+    svc #1
     ret
 
 get_active_procs:
-    # Allocate 16 bytes on the stack to accomodate the argument to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the arg on the stack beforehand
-    sub sp, sp, #16
-    stp x0, x1, [sp]
     # Set the syscall index to 14 (active process ID list) in x8
     mov x8, #14
-    # Load the arg count in x0
-    mov x0, #2
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #16
+    # Operating system trap with the arguments left in x0 and x1 (register ABI)
+    svc #1
     ret
 
 get_pstatus:
-    # Allocate 8 bytes on the stack to accomodate the argument to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the arg on the stack beforehand
-    sub sp, sp, #8
-    str x0, [sp]
     # Set the syscall index to 18 (parent process status) in x8
     mov x8, #18
-    # Load the arg count in x0
-    mov x0, #1
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #8
+    # Operating system trap with the argument left in x0 (register ABI)
+    svc #1
     ret
 
 get_proc_data:
-    # Allocate 48 bytes on the stack to accomodate the args to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the args on the stack beforehand
-    sub sp, sp, #48
-    stp x0, x1, [sp]
-    stp x2, x3, [sp, #16]
-    stp x4, x5, [sp, #(16*2)]
     # Set the syscall index to 15 (get process data for given pid) in x8
     mov x8, #15
-    # Load the arg count in x0
-    mov x0, #6
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #48
+    # Operating system trap with the arguments left in x0-x5 (register ABI)
+    svc #1
     ret
 
 setjobctl:
-    # Allocate 16 bytes on the stack to accomodate the argument to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the arg on the stack beforehand
-    sub sp, sp, #16
-    stp x0, x1, [sp]
     # Set the syscall index to 19 (set process control) in x8
     mov x8, #19
-    # Load the arg count in x0
-    mov x0, #2
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #16
+    # Operating system trap with the arguments left in x0 and x1 (register ABI)
+    svc #1
     ret
 
 kill:
-    # Allocate 16 bytes on the stack to accomodate the args to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the args on the stack beforehand
-    sub sp, sp, #16
-    stp x0, x1, [sp]
     # Set the syscall index to 16 (send signal) in x8
     mov x8, #16
-    # Load the arg count in x0
-    mov x0, #2
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #16
+    # Operating system trap with the arguments left in x0 and x1 (register ABI)
+    svc #1
     ret
 
 signal:
-    # Allocate 24 bytes on the stack to accomodate the args to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the args on the stack beforehand
-    sub sp, sp, #24
-    stp x0, x1, [sp]
     # Pass third argument as signal handler proxy routine which will be invoked by the kernel
     ldr x2, =sighandler_proxy
-    str x2, [sp, #16]
     # Set the syscall index to 17 (handle signal) in x8
     mov x8, #17
-    # Load the arg count in x0
-    mov x0, #3
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #24
+    # Operating system trap with the arguments left in x0-x2 (register ABI)
+    svc #1
     ret
 
 sighandler_proxy:
@@ -546,103 +345,185 @@ sighandler_proxy:
     ldp x0, x1, [sp, #(16*16)]
     # Branch from x1 register to user specified custom handler
     blr x1
-    # Save register values of previous process context which are going to be overwritten during proxy request
-    ldr x1, [sp, #8]
-    ldr x8, [sp, #(16*4)]
-    stp x1, x8, [sp, #(16*16)]
-    restore_context
     # Set special request code (signal handler proxy restore) in x8
+    # The saved context is left on the stack for the kernel to restore all registers from, along with the program counter
     mov x8, #101
-    # Load x1 with the pointer to selective previous context data
-    mov x1, sp
     # Operating system trap
     svc #0
     # We should never reach here. The process should resume execution at the point where it was previously interrupted
     ret
 
 setenv:
-    # Allocate 24 bytes on the stack to accomodate the args to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the arg on the stack beforehand
-    sub sp, sp, #24
-    stp x0, x1, [sp]
-    str x2, [sp, #16]
     # Set the syscall index to 21 (set env var) in x8
     mov x8, #21
-    # Load the arg count in x0
-    mov x0, #3
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #24
+    # Operating system trap with the arguments left in x0-x2 (register ABI)
+    svc #1
     ret
 
 getenv:
-    # Allocate 8 bytes on the stack to accomodate the argument to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the arg on the stack beforehand
-    sub sp, sp, #8
-    str x0, [sp]
     # Set the syscall index to 22 (get env var) in x8
     mov x8, #22
-    # Load the arg count in x0
-    mov x0, #1
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #8
+    # Operating system trap with the argument left in x0 (register ABI)
+    svc #1
     ret
 
 unsetenv:
-    # Allocate 8 bytes on the stack to accomodate the argument to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the arg on the stack beforehand
-    sub sp, sp, #8
-    str x0, [sp]
     # Set the syscall index to 23 (unset env var) in x8
     mov x8, #23
-    # Load the arg count in x0
-    mov x0, #1
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #8
+    # Operating system trap with the argument left in x0 (register ABI)
+    svc #1
     ret
 
 getfullenv:
-    # Allocate 8 bytes on the stack to accomodate the argument to this function
-    # Note that in aarch64, args to functions are loaded in GPRs not the stack
-    # We need the registers for other purposes hence saving the arg on the stack beforehand
-    sub sp, sp, #8
-    str x0, [sp]
     # Set the syscall index to 24 (get full environment) in x8
     mov x8, #24
-    # Load the arg count in x0
-    mov x0, #1
-    # Load x1 with the pointer to the arguments i.e. the current stack pointer
-    mov x1, sp
-    # Operating system trap
-    svc #0
-
-    # Restore the stack
-    add sp, sp, #8
+    # Operating system trap with the argument left in x0 (register ABI)
+    svc #1
     ret
 
 switchpenv:
-    # No arguments to this syscall hence no stack space required
     # Set the syscall index to 25 (switch to parent env) in x8
     mov x8, #25
-    # Load the arg count in x0
-    mov x0, #0
-    # Operating system trap
-    svc #0
+    # Operating system trap (register ABI)
+    svc #1
+    ret
+
+create_file:
+    # Set the syscall index to 26 (create file) in x8
+    mov x8, #26
+    # Operating system trap with the argument left in x0 (register ABI)
+    svc #1
+    ret
+
+write_file:
+    # Set the syscall index to 27 (write file) in x8
+    mov x8, #27
+    # Operating system trap with the arguments left in x0-x2 (register ABI)
+    svc #1
+    ret
+
+remove_file:
+    # Set the syscall index to 28 (remove file) in x8
+    mov x8, #28
+    # Operating system trap with the argument left in x0 (register ABI)
+    svc #1
+    ret
+
+pipe:
+    # Set the syscall index to 29 (pipe) in x8
+    mov x8, #29
+    # Operating system trap with the argument left in x0 (register ABI)
+    svc #1
+    ret
+
+dup2:
+    # Set the syscall index to 30 (dup2) in x8
+    mov x8, #30
+    # Operating system trap with the arguments left in x0 and x1 (register ABI)
+    svc #1
+    ret
+
+sendfile:
+    # Set the syscall index to 31 (sendfile) in x8
+    mov x8, #31
+    # Operating system trap with the arguments left in x0-x3 (register ABI)
+    svc #1
+    ret
+
+readv:
+    # Set the syscall index to 32 (readv) in x8
+    mov x8, #32
+    # Operating system trap with the arguments left in x0-x2 (register ABI)
+    svc #1
+    ret
+
+writev:
+    # Set the syscall index to 33 (writev) in x8
+    mov x8, #33
+    # Operating system trap with the arguments left in x0-x2 (register ABI)
+    svc #1
+    ret
+
+get_proc_snapshot:
+    # Set the syscall index to 34 (bulk process snapshot) in x8
+    mov x8, #34
+    # Operating system trap with the arguments left in x0-x2 (register ABI)
+    svc #1
+    ret
+
+sched_yield:
+    # Set the syscall index to 35 (yield the processor) in x8
+    mov x8, #35
+    # Operating system trap (register ABI)
+    svc #1
+    ret
+
+getpriority:
+    # Set the syscall index to 36 (get scheduling priority) in x8
+    mov x8, #36
+    # Operating system trap with the arguments left in x0 and x1 (register ABI)
+    svc #1
+    ret
+
+setpriority:
+    # Set the syscall index to 37 (set scheduling priority) in x8
+    mov x8, #37
+    # Operating system trap with the arguments left in x0-x2 (register ABI)
+    svc #1
+    ret
+
+spawn:
+    # Set the syscall index to 38 (spawn) in x8
+    mov x8, #38
+    # Operating system trap with the arguments left in x0-x3 (register ABI)
+    svc #1
+    ret
+
+thread_create:
+    # Set the syscall index to 39 (thread_create) in x8
+    mov x8, #39
+    # Operating system trap with the arguments left in x0-x3 (register ABI)
+    svc #1
+    ret
+
+futex:
+    # Set the syscall index to 40 (futex) in x8
+    mov x8, #40
+    # Operating system trap with the arguments left in x0-x2 (register ABI)
+    svc #1
+    ret
+
+ring_setup:
+    # Set the syscall index to 41 (register a syscall ring) in x8
+    mov x8, #41
+    # Operating system trap with the argument left in x0 (register ABI)
+    svc #1
+    ret
+
+ring_enter:
+    # Set the syscall index to 42 (run queued ring entries) in x8
+    mov x8, #42
+    # Operating system trap with the argument left in x0 (register ABI)
+    svc #1
+    ret
+
+sigprocmask:
+    # Set the syscall index to 43 (change blocked signals) in x8
+    mov x8, #43
+    # Operating system trap with the arguments left in x0-x2 (register ABI)
+    svc #1
+    ret
+
+getrusage:
+    # Set the syscall index to 44 (CPU usage of the process or its children) in x8
+    mov x8, #44
+    # Operating system trap with the arguments left in x0-x1 (register ABI)
+    svc #1
+    ret
+
+getloadavg:
+    # Set the syscall index to 45 (system load averages) in x8
+    mov x8, #45
+    # Operating system trap with the argument left in x0 (register ABI)
+    svc #1
     ret
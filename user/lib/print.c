@@ -19,87 +19,116 @@
 #include "flib.h"
 #include <stddef.h>
 
-#define PRINT_BATCH_BUF_SIZE 100
+#define PRINT_MAX_SEGMENTS IOV_MAX
+#define PRINT_SCRATCH_SIZE 128
 
-static int flush_uart(char* buf, int count)
+/* Output of a printf call gathered as segments so that it reaches the console in a single writev system call */
+struct PrintBatch
 {
-    buf[count] = 0;
-    /* Invoke a system call to flush the buffer to the uart console */
-    return writeu(buf, count);
+    struct iovec iov[PRINT_MAX_SEGMENTS];
+    int iovcnt;
+    char scratch[PRINT_SCRATCH_SIZE]; /* Holds converted values since the conversion functions reuse static buffers */
+    int scratch_pos;
+    int count;
+};
+
+static void flush_batch(struct PrintBatch* batch)
+{
+    if (batch->iovcnt > 0){
+        int written = writev(STDOUT_FILENO, batch->iov, batch->iovcnt);
+        if (written > 0)
+            batch->count += written;
+    }
+    batch->iovcnt = 0;
+    batch->scratch_pos = 0;
+}
+
+static void add_segment(struct PrintBatch* batch, const char* base, size_t len)
+{
+    if (len == 0)
+        return;
+    if (batch->iovcnt == PRINT_MAX_SEGMENTS)
+        flush_batch(batch);
+    batch->iov[batch->iovcnt].iov_base = (void*)base;
+    batch->iov[batch->iovcnt].iov_len = len;
+    batch->iovcnt++;
+}
+
+static void add_converted(struct PrintBatch* batch, const char* str)
+{
+    int len = strlen(str);
+    if (batch->scratch_pos + len > PRINT_SCRATCH_SIZE)
+        flush_batch(batch);
+    memcpy(batch->scratch + batch->scratch_pos, (void*)str, len);
+    add_segment(batch, batch->scratch + batch->scratch_pos, len);
+    batch->scratch_pos += len;
 }
 
 int printf(const char *fmt, ...)
 {
     va_list ap;
     const char* p;
+    const char* literal;
     char* sval;
-    int ival;
-    uint8_t cval[2];
-    uint64_t xval;
-    uint32_t uval;
-    char buf[PRINT_BATCH_BUF_SIZE];
-    uint16_t pos, count = 0;
+    char cval;
+    struct PrintBatch batch;
+
+    batch.iovcnt = 0;
+    batch.scratch_pos = 0;
+    batch.count = 0;
     
     va_start(ap, fmt);
-    for(p = fmt, pos = 0; *p; p++)
+    for(p = fmt; *p; p++)
     {
+        /* Literal text is referenced in place from the format string rather than copied */
         if (*p != '%'){
-            if (pos == PRINT_BATCH_BUF_SIZE-1){
-                count += flush_uart(buf, pos);
-                pos = 0;
+            literal = p;
+            while (*(p+1) && *(p+1) != '%')
+            {
+                p++;
             }
-            buf[pos++] = *p;
+            add_segment(&batch, literal, p - literal + 1);
             continue;
         }
 
-        char* fmt_spec_str;
-
         switch(*++p)
         {
         case 'c':
-            cval[0] = (char)va_arg(ap, int);
-            cval[1] = 0;
-            fmt_spec_str = cval;
+            cval = (char)va_arg(ap, int);
+            if (cval == 0)
+                break;
+            if (batch.scratch_pos == PRINT_SCRATCH_SIZE)
+                flush_batch(&batch);
+            batch.scratch[batch.scratch_pos] = cval;
+            add_segment(&batch, batch.scratch + batch.scratch_pos, 1);
+            batch.scratch_pos++;
             break;
         case 'x':
-            xval = va_arg(ap, uint64_t);
-            fmt_spec_str = xtoa(xval);
+            add_converted(&batch, xtoa(va_arg(ap, uint64_t)));
             break;
         case 'd':
-            ival = va_arg(ap, int);
-            fmt_spec_str = itoa(ival);
+            add_converted(&batch, itoa(va_arg(ap, int)));
             break;
         case 's':
             sval = va_arg(ap, char*);
-            fmt_spec_str = sval;
+            if (sval != NULL)
+                add_segment(&batch, sval, strlen(sval));
             break;
         case 'u':
-            uval = va_arg(ap, uint32_t);
-            fmt_spec_str = uitoa(uval);
+            add_converted(&batch, uitoa(va_arg(ap, uint32_t)));
+            break;
+        case '\0':
+            /* A trailing '%' ends the format string */
+            p--;
             break;
         default:
-            fmt_spec_str = NULL;
             break;
         }
-
-        if (fmt_spec_str != NULL && *fmt_spec_str != 0){
-            do
-            {
-                if (pos == PRINT_BATCH_BUF_SIZE-1){
-                    count += flush_uart(buf, pos);
-                    pos = 0;
-                }
-                buf[pos++] = *fmt_spec_str++;
-            } while (*fmt_spec_str);
-        }
-        else
-            continue;
     }
 
-    if (pos > 0)
-        count += flush_uart(buf, pos);
+    flush_batch(&batch);
     va_end(ap);
-    return count;
+    return batch.count;
 }
 
 char *itoa(int dec_val)
@@ -0,0 +1,100 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "pthread.h"
+
+/* Threads start here so that the value returned by the start routine is kept for join. Exit only ends the calling thread */
+static void thread_entry(void* arg)
+{
+    pthread_t* thread = (pthread_t*)arg;
+
+    thread->ret = thread->start(thread->arg);
+    exit(0);
+}
+
+int pthread_create(pthread_t* thread, void* (*start)(void*), void* arg)
+{
+    int tid;
+
+    if (thread == NULL || start == NULL)
+        return -1;
+    thread->start = start;
+    thread->arg = arg;
+    thread->ret = NULL;
+    tid = thread_create(thread_entry, thread->stack + PTHREAD_STACK_SIZE, thread, &thread->tid);
+    return tid < 0 ? -1 : 0;
+}
+
+int pthread_join(pthread_t* thread, void** retval)
+{
+    int tid;
+
+    /* The kernel clears the thread ID and wakes the futex on it once the thread is gone */
+    while ((tid = thread->tid) != 0)
+        futex((volatile uint32_t*)&thread->tid, FUTEX_WAIT, tid);
+    if (retval != NULL)
+        *retval = thread->ret;
+    return 0;
+}
+
+int pthread_mutex_init(pthread_mutex_t* mutex)
+{
+    mutex->lock = 0;
+    return 0;
+}
+
+/* Exclusive loads and stores cannot be relied on with caches disabled, so the test and set is left to the kernel */
+int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+    return futex(&mutex->lock, FUTEX_LOCK, 0);
+}
+
+int pthread_mutex_unlock(pthread_mutex_t* mutex)
+{
+    return futex(&mutex->lock, FUTEX_UNLOCK, 0);
+}
+
+int pthread_cond_init(pthread_cond_t* cond)
+{
+    cond->seq = 0;
+    return 0;
+}
+
+int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex)
+{
+    /* Read the sequence before releasing the mutex. A signal sent in between changes it and the wait returns at once */
+    uint32_t seq = cond->seq;
+
+    pthread_mutex_unlock(mutex);
+    futex(&cond->seq, FUTEX_WAIT, seq);
+    return pthread_mutex_lock(mutex);
+}
+
+int pthread_cond_signal(pthread_cond_t* cond)
+{
+    cond->seq++;
+    futex(&cond->seq, FUTEX_WAKE, 1);
+    return 0;
+}
+
+int pthread_cond_broadcast(pthread_cond_t* cond)
+{
+    cond->seq++;
+    futex(&cond->seq, FUTEX_WAKE, INT32_MAX);
+    return 0;
+}
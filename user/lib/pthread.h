@@ -0,0 +1,56 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PTHREAD_H
+#define PTHREAD_H
+
+#include "flib.h"
+
+#define PTHREAD_STACK_SIZE 8192
+
+/* A thread owns no memory of its own. There is no user heap so the caller provides the record along with the stack, usually as a global */
+typedef struct {
+    volatile int tid; /* Thread ID, cleared by the kernel when the thread exits */
+    void* (*start)(void*);
+    void* arg;
+    void* ret; /* Value returned by the start routine */
+    uint8_t stack[PTHREAD_STACK_SIZE] __attribute__((aligned(16)));
+} pthread_t;
+
+typedef struct {
+    volatile uint32_t lock;
+} pthread_mutex_t;
+
+typedef struct {
+    volatile uint32_t seq; /* Bumped on every signal or broadcast */
+} pthread_cond_t;
+
+#define PTHREAD_MUTEX_INITIALIZER {0}
+#define PTHREAD_COND_INITIALIZER {0}
+
+int pthread_create(pthread_t* thread, void* (*start)(void*), void* arg);
+int pthread_join(pthread_t* thread, void** retval);
+int pthread_mutex_init(pthread_mutex_t* mutex);
+int pthread_mutex_lock(pthread_mutex_t* mutex);
+int pthread_mutex_unlock(pthread_mutex_t* mutex);
+int pthread_cond_init(pthread_cond_t* cond);
+int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex);
+int pthread_cond_signal(pthread_cond_t* cond);
+int pthread_cond_broadcast(pthread_cond_t* cond);
+
+#endif
@@ -35,4 +35,19 @@
 #define SIG_DFL ((void (*)(int))0)     /* default signal handling */
 #define SIG_IGN ((void (*)(int))1)     /* ignore signal */
 
+/* How sigprocmask changes the blocked signals */
+#define SIG_BLOCK   0
+#define SIG_UNBLOCK 1
+#define SIG_SETMASK 2
+
+/* Set of signals with bit n standing for signal n */
+typedef uint32_t sigset_t;
+
+int sigprocmask(int how, const sigset_t* set, sigset_t* oldset);
+int sigemptyset(sigset_t* set);
+int sigfillset(sigset_t* set);
+int sigaddset(sigset_t* set, int signum);
+int sigdelset(sigset_t* set, int signum);
+int sigismember(const sigset_t* set, int signum);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,81 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "flib.h"
+#include <stddef.h>
+
+static void print_usage(void)
+{
+    printf("Usage:");
+    printf("\tnice [OPTION] [COMMAND [ARG]...]\n");
+    printf("\tRun COMMAND with an adjusted niceness, which affects process scheduling\n");
+    printf("\tWith no COMMAND, print the current niceness\n");
+    printf("\tNiceness values range from -20 (most favorable to the process) to 19 (least favorable)\n");
+    printf("\tOnly a privileged process may lower the niceness\n\n");
+    printf("\t-h\tdisplay this help and exit\n");
+    printf("\t-n N\tadd integer N to the niceness (default 10)\n");
+}
+
+int main(int argc, char** argv)
+{
+    int adjustment = 10;
+    int opt = 1;
+
+    while (opt < argc && argv[opt][0] == '-')
+    {
+        if (argv[opt][1] == 'h' && argv[opt][2] == 0){
+            print_usage();
+            return 0;
+        }
+        if (argv[opt][1] == 'n' && argv[opt][2] == 0 && opt+1 < argc){
+            adjustment = atoi(argv[opt+1]);
+            opt += 2;
+            continue;
+        }
+        printf("%s: invalid option \'%s\'\n", argv[0], argv[opt]);
+        printf("Try \'%s -h\' for more information\n", argv[0]);
+        return 1;
+    }
+    if (opt == argc){
+        printf("%d\n", getpriority(PRIO_PROCESS, 0));
+        return 0;
+    }
+
+    if (setpriority(PRIO_PROCESS, 0, getpriority(PRIO_PROCESS, 0) + adjustment) < 0){
+        printf("%s: cannot set niceness\n", argv[0]);
+        return 1;
+    }
+    /* Resolve the executable the same way the shell does */
+    char prog[MAX_FILENAME_BYTES+MAX_EXTNAME_BYTES+2];
+    if (resolve_prog(argv[opt], prog) < 0){
+        printf("%s: %s: command not found\n", argv[0], argv[opt]);
+        return 127;
+    }
+    /* The argument list passed to exec is null terminated and excludes the program name */
+    const char* args[argc-opt];
+    for (int i = opt+1; i < argc; i++)
+    {
+        args[i-opt-1] = argv[i];
+    }
+    args[argc-opt-1] = NULL;
+    /* The command replaces this process and keeps the adjusted niceness */
+    exec(prog, args);
+
+    printf("%s: %s: command not found\n", argv[0], argv[opt]);
+    return 127;
+}
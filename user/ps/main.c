@@ -52,6 +52,21 @@ static char state_rep(int state)
     return state_ch;
 }
 
+/* Order the snapshot by PID with an insertion sort. Process counts are small */
+static void sort_procs(struct procinfo* procs, int count)
+{
+    struct procinfo key;
+    int j;
+
+    for (int i = 1; i < count; i++)
+    {
+        memcpy(&key, &procs[i], sizeof(key));
+        for (j = i - 1; j >= 0 && procs[j].pid > key.pid; j--)
+            memcpy(&procs[j+1], &procs[j], sizeof(key));
+        memcpy(&procs[j+1], &key, sizeof(key));
+    }
+}
+
 static void print_usage(void)
 {
     printf("Usage:");
@@ -109,7 +124,7 @@ int main(int argc, char** argv)
         }
     }
 
-    const char* ff_header = "PID    PPID    STATE    CMD";
+    const char* ff_header = "PID    PPID    STATE    NI    TICKS    RSS(K)    CMD";
     const char* sf_header = "PID    CMD";
     const char* header = full_format ? ff_header : sf_header;
     int header_len = strlen(header);
@@ -120,37 +135,40 @@ int main(int argc, char** argv)
     }
     separator[header_len+1] = 0;
     
-    int pid_count = get_active_procs(NULL, all);
-    int pid_list[pid_count];
-    if (rows == 0 || rows > pid_count)
-        rows = pid_count;
-    get_active_procs(pid_list, all);
-    sort(pid_list, pid_count);
+    /* Take a snapshot of all selected processes in one call */
+    int proc_count = get_proc_snapshot(NULL, 0, all);
+    if (proc_count < 0)
+        return 1;
+    int max_procs = proc_count > 0 ? proc_count : 1;
+    struct procinfo procs[max_procs];
+    proc_count = get_proc_snapshot(procs, max_procs, all);
+    /* More processes may have been created since the count was taken, only as many as fit are filled in */
+    if (proc_count > max_procs)
+        proc_count = max_procs;
+    sort_procs(procs, proc_count);
+    if (rows == 0 || rows > proc_count)
+        rows = proc_count;
 
-    int ppid, state, args_size, args_pos;
-    char procname[MAX_FILENAME_BYTES+1];
+    int args_pos;
 
     printf("%s\n", header);
     printf("%s\n", separator);
     for(int i = 0; i < rows; i++)
     {
-        memset(procname, 0, sizeof(procname));
-        args_size = get_proc_data(pid_list[i], NULL, NULL, NULL, procname, NULL);
         if (full_format){
-            char procargs[args_size];
-            get_proc_data(pid_list[i], &ppid, &state, NULL, NULL, args_size > 0 ? procargs : NULL);
-            printf("%d\t%d\t%c\t%s ", pid_list[i], ppid, state_rep(state), procname);
+            printf("%d\t%d\t%c\t%d\t%u\t%u\t%s ", procs[i].pid, procs[i].ppid, state_rep(procs[i].state), procs[i].nice,
+                   (uint32_t)procs[i].cpu_ticks, (uint32_t)procs[i].rss, procs[i].name);
             args_pos = 0;
-            /* Print the process arguments from the procargs buffer filled by the kernel */
-            while (args_pos < args_size)
+            /* Print the process arguments from the null separated summary filled by the kernel */
+            while (args_pos < procs[i].args_size)
             {
-                printf("%s ", procargs+args_pos);
-                args_pos += (strlen(procargs+args_pos)+1);
+                printf("%s ", procs[i].args+args_pos);
+                args_pos += (strlen(procs[i].args+args_pos)+1);
             }
             printf("\n");
             continue;
         }
-        printf("%d\t%s\n", pid_list[i], procname);
+        printf("%d\t%s\n", procs[i].pid, procs[i].name);
     }
     
     return 0;
@@ -34,10 +34,108 @@ void sighandler(int signum)
     }
 }
 
+static void report_status(int wpid, int wstatus)
+{
+    if (WIFSIGNALED(wstatus)){
+        switch (WTERMSIG(wstatus))
+        {
+        case SIGINT:
+            printf("\n");
+            break;
+        case SIGABRT:
+            printf("Aborted\n");
+            break;
+        case SIGKILL:
+            printf("Killed\n");
+            break;
+        case SIGTERM:
+            printf("Terminated\n");
+        default:
+            break;
+        }
+    }
+    else if (WIFSTOPPED(wstatus)){
+        int job_spec;
+        char procname[MAX_FILENAME_BYTES+1];
+        get_proc_data(wpid, NULL, NULL, &job_spec, procname, NULL);
+        printf("^Z\n[%d]  Stopped\t%s\n", job_spec, procname);
+    }
+}
+
+static void run_pipeline(char stage_cmds[][MAX_CMD_BUF_SIZE], char stage_echos[][MAX_CMD_BUF_SIZE], int stages, char* shell)
+{
+    char* args[MAX_PIPE_STAGES][MAX_PROG_ARGS];
+    int cmd_pos[MAX_PIPE_STAGES];
+    int pids[MAX_PIPE_STAGES];
+    int fds[2];
+    struct spawn_actions actions;
+    int in_fd = -1;
+    int started = 0;
+    int wstatus, wpid;
+
+    /* Resolve every command up front so that a typo in a later stage doesn't leave earlier ones running */
+    for (int i = 0; i < stages; i++)
+    {
+        int arg_count = resolve_cmd(stage_cmds[i], stage_echos[i], shell, &cmd_pos[i], args[i]);
+        if (arg_count < 0)
+            return;
+        if (arg_count > 0 && strlen(args[i][arg_count-1]) == 1 && args[i][arg_count-1][0] == '&'){
+            printf("%s: background pipelines are not supported\n", shell);
+            return;
+        }
+    }
+
+    for (int i = 0; i < stages; i++)
+    {
+        if (i < stages-1 && pipe(fds) < 0){
+            printf("%s: pipe: too many open files\n", shell);
+            break;
+        }
+        /* Read from the previous stage and write to the next one through the standard streams of the child */
+        spawn_actions_init(&actions);
+        if (in_fd >= 0){
+            spawn_add_dup2(&actions, in_fd, STDIN_FILENO);
+            spawn_add_close(&actions, in_fd);
+        }
+        if (i < stages-1){
+            spawn_add_dup2(&actions, fds[1], STDOUT_FILENO);
+            spawn_add_close(&actions, fds[0]);
+            spawn_add_close(&actions, fds[1]);
+        }
+        int cmd_pid = spawn(stage_cmds[i]+cmd_pos[i], (const char**)args[i], NULL, &actions);
+        /* Drop the shell's copies of the pipe ends or the readers will never see end of file */
+        if (in_fd >= 0)
+            close_file(in_fd);
+        in_fd = -1;
+        if (i < stages-1){
+            close_file(fds[1]);
+            in_fd = fds[0];
+        }
+        if (cmd_pid < 0){
+            printf("%s: spawn failed\n", shell);
+            break;
+        }
+        pids[started++] = cmd_pid;
+    }
+    if (in_fd >= 0)
+        close_file(in_fd);
+
+    for (int i = 0; i < started; i++)
+    {
+        wpid = waitpid(pids[i], &wstatus, WUNTRACED);
+        /* Only the status of the last stage is reported like any other foreground command */
+        if (wpid != -1 && i == started-1)
+            report_status(wpid, wstatus);
+    }
+}
+
 int main(int argc, char** argv)
 {
     char cmd_buf[MAX_CMD_BUF_SIZE];
     char echo_buf[MAX_CMD_BUF_SIZE];
+    /* Per stage command buffers of a pipeline. Static to keep them off the user stack */
+    static char stage_cmds[MAX_PIPE_STAGES][MAX_CMD_BUF_SIZE];
+    static char stage_echos[MAX_PIPE_STAGES][MAX_CMD_BUF_SIZE];
     int cmd_size = 0;
     int wstatus;
 
@@ -58,78 +156,33 @@ int main(int argc, char** argv)
         
         if (cmd_size > 0){
             int cmd_pos, arg_count;
-            char* cmd_ext;
             char* args[MAX_PROG_ARGS];
-            arg_count = get_cmd_info(cmd_buf, echo_buf, &cmd_pos, &cmd_ext, args);
-            if (cmd_ext == NULL){
-                char* cmd_end = cmd_buf+cmd_pos+strlen(cmd_buf+cmd_pos);
-                memcpy(cmd_end, ".BIN", MAX_EXTNAME_BYTES+1);
-                *(cmd_end+MAX_EXTNAME_BYTES+1) = 0;
-            }
-            else if (memcmp(cmd_ext, "BIN", MAX_EXTNAME_BYTES) != 0){
-                printf("%s: not an executable\n", echo_buf+cmd_pos);
+            if (find('|', cmd_buf) >= 0){
+                int stages = split_pipeline(cmd_buf, echo_buf, stage_cmds, stage_echos);
+                if (stages < 0)
+                    printf("%s: syntax error near unexpected token \'|\'\n", argv[0]);
+                else
+                    run_pipeline(stage_cmds, stage_echos, stages, argv[0]);
                 continue;
             }
-            /* Forbid direct execution of init and login programs by the user */
-            if (memcmp(cmd_buf+cmd_pos, "INIT.BIN", strlen(cmd_buf+cmd_pos)) == 0 ||
-                memcmp(cmd_buf+cmd_pos, "LOGIN.BIN", strlen(cmd_buf+cmd_pos)) == 0){
-                printf("%s: %s - Operation not permitted\n", argv[0], cmd_buf+cmd_pos);
+            arg_count = resolve_cmd(cmd_buf, echo_buf, argv[0], &cmd_pos, args);
+            if (arg_count < 0)
                 continue;
-            }
-            if (memcmp(cmd_buf+cmd_pos, "FG.BIN", 6) == 0 || memcmp(cmd_buf+cmd_pos, "BG.BIN", 6) == 0){
-                char jctl_cmd[] = "JOBCTL.BIN";
-                int jctl_len = strlen(jctl_cmd);
-                memcpy(cmd_buf+cmd_pos, jctl_cmd, jctl_len);
-                cmd_buf[cmd_pos+jctl_len] = 0;
-                if (!args[0])
-                    args[0] = echo_buf+cmd_pos;
-                args[1] = echo_buf+cmd_pos;
-                args[2] = NULL;
-            }
-            int fd = open_file(cmd_buf+cmd_pos);
-            if (fd < 0)
-                printf("%s: command not found\n", echo_buf+cmd_pos);
+            /* The command is started straight from its binary, sparing a copy of the shell that it would replace anyway */
+            int cmd_pid = spawn(cmd_buf+cmd_pos, (const char**)args, NULL, NULL);
+            if (cmd_pid < 0)
+                printf("%s: spawn failed\n", argv[0]);
             else{
-                close_file(fd);
-                int cmd_pid = fork();
-                if (cmd_pid == 0)
-                    exec(cmd_buf+cmd_pos, (const char**)args);
-                else{
-                    /* Don't make the parent wait since it's a background process, so that the shell becomes available to subsequent commands */
-                    if (arg_count > 0 && strlen(args[arg_count-1]) == 1 && args[arg_count-1][0] == '&'){
-                        int jobspec;
-                        get_proc_data(cmd_pid, NULL, NULL, &jobspec, NULL, NULL);
-                        printf("[%d] %d\n", jobspec, cmd_pid);
-                        continue;
-                    }
-                    int wpid = waitpid(cmd_pid, &wstatus, WUNTRACED);
-                    if (wpid != -1){
-                        if (WIFSIGNALED(wstatus)){
-                            switch (WTERMSIG(wstatus))
-                            {
-                            case SIGINT:
-                                printf("\n");
-                                break;
-                            case SIGABRT:
-                                printf("Aborted\n");
-                                break;
-                            case SIGKILL:
-                                printf("Killed\n");
-                                break;
-                            case SIGTERM:
-                                printf("Terminated\n");
-                            default:
-                                break;
-                            }
-                        }
-                        else if (WIFSTOPPED(wstatus)){
-                            int job_spec;
-                            char procname[MAX_FILENAME_BYTES+1];
-                            get_proc_data(wpid, NULL, NULL, &job_spec, procname, NULL);
-                            printf("^Z\n[%d]  Stopped\t%s\n", job_spec, procname);
-                        }
-                    }
+                /* Don't make the parent wait since it's a background process, so that the shell becomes available to subsequent commands */
+                if (arg_count > 0 && strlen(args[arg_count-1]) == 1 && args[arg_count-1][0] == '&'){
+                    int jobspec;
+                    get_proc_data(cmd_pid, NULL, NULL, &jobspec, NULL, NULL);
+                    printf("[%d] %d\n", jobspec, cmd_pid);
+                    continue;
                 }
+                int wpid = waitpid(cmd_pid, &wstatus, WUNTRACED);
+                if (wpid != -1)
+                    report_status(wpid, wstatus);
             }
         }
     }
@@ -79,6 +79,86 @@ int get_cmd_info(char* cmd, char* echo, int* cmd_pos, char** ext, char** echo_ar
     return arg_count;
 }
 
+int resolve_cmd(char* cmd, char* echo, char* shell, int* cmd_pos, char** args)
+{
+    int arg_count, fd, resolved;
+    char* cmd_ext;
+    char prog[MAX_FILENAME_BYTES+MAX_EXTNAME_BYTES+2];
+
+    arg_count = get_cmd_info(cmd, echo, cmd_pos, &cmd_ext, args);
+    if (arg_count < 0)
+        return -1;
+    resolved = resolve_prog(cmd+*cmd_pos, prog);
+    if (resolved == -2){
+        printf("%s: not an executable\n", echo+*cmd_pos);
+        return -1;
+    }
+    if (resolved < 0){
+        printf("%s: command not found\n", echo+*cmd_pos);
+        return -1;
+    }
+    /* The command is null terminated in place and its arguments are taken from the echo buffer, leaving room for the extension */
+    memcpy(cmd+*cmd_pos, prog, strlen(prog)+1);
+    /* Forbid direct execution of init and login programs by the user */
+    if (memcmp(cmd+*cmd_pos, "INIT.BIN", strlen(cmd+*cmd_pos)) == 0 ||
+        memcmp(cmd+*cmd_pos, "LOGIN.BIN", strlen(cmd+*cmd_pos)) == 0){
+        printf("%s: %s - Operation not permitted\n", shell, cmd+*cmd_pos);
+        return -1;
+    }
+    if (memcmp(cmd+*cmd_pos, "FG.BIN", 6) == 0 || memcmp(cmd+*cmd_pos, "BG.BIN", 6) == 0){
+        char jctl_cmd[] = "JOBCTL.BIN";
+        int jctl_len = strlen(jctl_cmd);
+        memcpy(cmd+*cmd_pos, jctl_cmd, jctl_len);
+        cmd[*cmd_pos+jctl_len] = 0;
+        if (!args[0])
+            args[0] = echo+*cmd_pos;
+        args[1] = echo+*cmd_pos;
+        args[2] = NULL;
+    }
+    fd = open_file(cmd+*cmd_pos);
+    if (fd < 0){
+        printf("%s: command not found\n", echo+*cmd_pos);
+        return -1;
+    }
+    close_file(fd);
+
+    return arg_count;
+}
+
+int split_pipeline(char* cmd, char* echo, char stage_cmds[][MAX_CMD_BUF_SIZE], char stage_echos[][MAX_CMD_BUF_SIZE])
+{
+    int stages = 0;
+    int start = 0, end = 0;
+
+    /* Copy every stage to a buffer of its own so that appending the executable extension to a command can't spill into the next one */
+    while (1)
+    {
+        if (cmd[end] == '|' || cmd[end] == '\0'){
+            if (stages == MAX_PIPE_STAGES)
+                return -1;
+            memset(stage_cmds[stages], 0, MAX_CMD_BUF_SIZE);
+            memset(stage_echos[stages], 0, MAX_CMD_BUF_SIZE);
+            memcpy(stage_cmds[stages], cmd+start, end-start);
+            memcpy(stage_echos[stages], echo+start, end-start);
+            /* A stage with nothing but spaces is a syntax error */
+            int i = 0;
+            while (stage_cmds[stages][i] == ' ')
+            {
+                i++;
+            }
+            if (stage_cmds[stages][i] == '\0')
+                return -1;
+            stages++;
+            if (cmd[end] == '\0')
+                break;
+            start = end+1;
+        }
+        end++;
+    }
+
+    return stages;
+}
+
 int read_cmd(char* buf, char* echo_buf)
 {
     char shell_echo[4];
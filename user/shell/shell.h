@@ -25,6 +25,7 @@
 
 #define MAX_CMD_BUF_SIZE 1024
 #define MAX_PROG_ARGS 100
+#define MAX_PIPE_STAGES 8
 
 #define buf_offset(base, ptr) (int)((uint64_t)(ptr) - (uint64_t)(base))
 
@@ -32,5 +33,7 @@ extern bool interrupted; /* Whether an interrupt signal (SIGINT) was received by
 
 int get_cmd_info(char* cmd, char* echo, int* cmd_pos, char** ext, char** echo_args);
 int read_cmd(char* buf, char* echo_buf);
+int resolve_cmd(char* cmd, char* echo, char* shell, int* cmd_pos, char** args);
+int split_pipeline(char* cmd, char* echo, char stage_cmds[][MAX_CMD_BUF_SIZE], char stage_echos[][MAX_CMD_BUF_SIZE]);
 
 #endif
\ No newline at end of file
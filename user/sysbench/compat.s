@@ -0,0 +1,47 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+.section .text
+.global getpid_argv_abi
+.global getpid_register_abi
+.global getpid_full_entry
+
+getpid_argv_abi:
+    # getpid through the older calling convention (svc #0) still accepted by the kernel, for comparison with the register ABI
+    # Arguments would be spilled to the stack with x0 holding their count and x1 pointing to them
+    sub sp, sp, #16
+    # Set the syscall index to 11 (get pid) in x8
+    mov x8, #11
+    mov x0, #0
+    mov x1, sp
+    svc #0
+
+    add sp, sp, #16
+    ret
+
+getpid_register_abi:
+    # getpid through the register ABI. The library getpid reads the kernel data page instead of trapping
+    mov x8, #11
+    svc #1
+    ret
+
+getpid_full_entry:
+    # getpid through the register ABI on the full kernel entry and exit path which saves and loads every register (svc #2)
+    mov x8, #11
+    svc #2
+    ret
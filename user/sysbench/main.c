@@ -0,0 +1,95 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "flib.h"
+
+#define DEF_CALLS 100000
+#define RING_BATCH 64
+
+int getpid_argv_abi(void);
+int getpid_register_abi(void);
+int getpid_full_entry(void);
+
+static struct ring_sqe sqes[RING_BATCH];
+static struct ring_cqe cqes[RING_BATCH];
+
+/* Run the calls in batches of getpid entries on a syscall ring, one trap per batch */
+static int ring_calls(int calls)
+{
+    struct sys_ring ring;
+    int queued;
+
+    if (ring_init(&ring, sqes, cqes, RING_BATCH) < 0)
+        return -1;
+    for (int i = 0; i < calls; i += queued)
+    {
+        for (queued = 0; queued < RING_BATCH && i + queued < calls; queued++)
+            ring_get_sqe(&ring)->op = RING_OP_GETPID;
+        ring_enter(0);
+        while (ring_peek_cqe(&ring) != NULL)
+            ring_cqe_seen(&ring);
+    }
+    ring_setup(NULL);
+    return 0;
+}
+
+static void report(const char* name, int calls, uint64_t ns)
+{
+    printf("%s: %d calls in %u us, %u ns per call\n", name, calls, (uint32_t)(ns / 1000), (uint32_t)(ns / calls));
+}
+
+int main(int argc, char** argv)
+{
+    int calls = DEF_CALLS;
+    uint64_t start;
+
+    if (argc > 1){
+        calls = atoi(argv[1]);
+        if (calls <= 0){
+            printf("Usage:\tsysbench [CALLS]\n");
+            printf("\tMeasure the latency of a null system call (getpid) through both syscall calling conventions, the full kernel entry path, a syscall ring and the kernel data page\n");
+            return 1;
+        }
+    }
+
+    start = clock_ns();
+    for (int i = 0; i < calls; i++)
+        getpid_argv_abi();
+    report("svc #0 (argument array)", calls, clock_ns() - start);
+
+    start = clock_ns();
+    for (int i = 0; i < calls; i++)
+        getpid_register_abi();
+    report("svc #1 (register ABI)", calls, clock_ns() - start);
+
+    start = clock_ns();
+    for (int i = 0; i < calls; i++)
+        getpid_full_entry();
+    report("svc #2 (register ABI, full entry)", calls, clock_ns() - start);
+
+    start = clock_ns();
+    if (ring_calls(calls) == 0)
+        report("syscall ring (batches of " stringify_value(RING_BATCH) ")", calls, clock_ns() - start);
+
+    start = clock_ns();
+    for (int i = 0; i < calls; i++)
+        getpid();
+    report("kernel data page", calls, clock_ns() - start);
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "flib.h"
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/wait.h>
+
+static void print_usage(void)
+{
+    printf("Usage:");
+    printf("\ttime [OPTION] COMMAND [ARG]...\n");
+    printf("\tRun COMMAND and report the real, user and system time it took\n");
+    printf("\tTimes include those of the children COMMAND waited for\n\n");
+    printf("\t-h\tdisplay this help and exit\n");
+    printf("\t-v\talso report the time spent waiting to run and the context switches\n");
+}
+
+/* Print a time in microseconds as minutes and seconds to the millisecond, as in 0m1.250s */
+static void print_time(const char* label, uint64_t usec)
+{
+    uint64_t msec = usec / 1000;
+    uint32_t frac = msec % 1000;
+
+    printf("%s\t%um%u.%u%u%us\n", label, (uint32_t)(msec / 60000), (uint32_t)(msec / 1000 % 60), frac / 100, frac / 10 % 10, frac % 10);
+}
+
+int main(int argc, char** argv)
+{
+    bool verbose = false;
+    int opt = 1;
+
+    while (opt < argc && argv[opt][0] == '-')
+    {
+        if (argv[opt][1] == 'h' && argv[opt][2] == 0){
+            print_usage();
+            return 0;
+        }
+        if (argv[opt][1] == 'v' && argv[opt][2] == 0){
+            verbose = true;
+            opt++;
+            continue;
+        }
+        printf("%s: invalid option \'%s\'\n", argv[0], argv[opt]);
+        printf("Try \'%s -h\' for more information\n", argv[0]);
+        return 1;
+    }
+    if (opt == argc){
+        print_usage();
+        return 1;
+    }
+
+    /* Resolve the executable the same way the shell does */
+    char prog[MAX_FILENAME_BYTES+MAX_EXTNAME_BYTES+2];
+    if (resolve_prog(argv[opt], prog) < 0){
+        printf("%s: %s: command not found\n", argv[0], argv[opt]);
+        return 127;
+    }
+    /* The argument list passed to spawn is null terminated and excludes the program name */
+    const char* args[argc-opt];
+    for (int i = opt+1; i < argc; i++)
+    {
+        args[i-opt-1] = argv[i];
+    }
+    args[argc-opt-1] = NULL;
+
+    /* Usage of the children reaped so far is subtracted, leaving that of the command alone */
+    struct rusage before, after;
+    int wstatus = 0;
+    if (getrusage(RUSAGE_CHILDREN, &before) < 0){
+        printf("%s: cannot get resource usage\n", argv[0]);
+        return 1;
+    }
+    uint64_t start = clock_ns();
+    int pid = spawn(prog, args, NULL, NULL);
+    if (pid < 0){
+        printf("%s: %s: command not found\n", argv[0], argv[opt]);
+        return 127;
+    }
+    waitpid(pid, &wstatus, 0);
+    uint64_t real = (clock_ns() - start) / 1000;
+    getrusage(RUSAGE_CHILDREN, &after);
+
+    printf("\n");
+    print_time("real", real);
+    print_time("user", after.ru_utime - before.ru_utime);
+    print_time("sys", after.ru_stime - before.ru_stime);
+    if (verbose){
+        print_time("wait", after.ru_wait - before.ru_wait);
+        printf("csw\t%u voluntary, %u involuntary\n", (uint32_t)(after.ru_nvcsw - before.ru_nvcsw), (uint32_t)(after.ru_nivcsw - before.ru_nivcsw));
+    }
+
+    return WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 1;
+}
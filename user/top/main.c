@@ -0,0 +1,207 @@
+/**
+    Frostbyte kernel and operating system
+    Copyright (C) 2023  Amol Dhamale <amoldhamale1105@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "flib.h"
+#include <stddef.h>
+#include <stdbool.h>
+
+#define TOP_MAX_PROCS 100
+
+/* CPU time of the processes at the previous refresh, to tell how much of the interval each one ran */
+struct sample {
+    int pid;
+    uint64_t cpu_time;
+};
+
+static struct procinfo procs[TOP_MAX_PROCS];
+static uint32_t usage[TOP_MAX_PROCS]; /* CPU use over the last interval in tenths of a percent, by position in procs */
+static struct sample prev[TOP_MAX_PROCS];
+static int prev_count = 0;
+
+static char state_rep(int state)
+{
+    switch (state)
+    {
+    case INIT:
+        return 'i';
+    case RUNNING:
+        return 'R';
+    case READY:
+        return 'r';
+    case SLEEP:
+        return 's';
+    case STOPPED:
+        return 'T';
+    case KILLED:
+        return 'z';
+    default:
+        return '?';
+    }
+}
+
+static void print_usage(void)
+{
+    printf("Usage:");
+    printf("\ttop [OPTION...]\n");
+    printf("\tDisplay processes ordered by CPU usage, refreshed periodically\n\n");
+    printf("\t-h\tdisplay this help and exit\n");
+    printf("\t-d N\tdelay N seconds between refreshes (default 2)\n");
+    printf("\t-n N\texit after N refreshes (default runs until interrupted)\n");
+}
+
+static uint64_t cpu_time(const struct procinfo* proc)
+{
+    return proc->utime + proc->stime;
+}
+
+static uint64_t prev_cpu_time(int pid)
+{
+    for (int i = 0; i < prev_count; i++)
+    {
+        if (prev[i].pid == pid)
+            return prev[i].cpu_time;
+    }
+    return 0;
+}
+
+/* Order the processes by their CPU use over the last interval with an insertion sort, ties broken by PID */
+static void sort_procs(int count)
+{
+    struct procinfo key;
+    uint32_t key_usage;
+    int j;
+
+    for (int i = 1; i < count; i++)
+    {
+        memcpy(&key, &procs[i], sizeof(key));
+        key_usage = usage[i];
+        for (j = i - 1; j >= 0 && (usage[j] < key_usage || (usage[j] == key_usage && procs[j].pid > key.pid)); j--)
+        {
+            memcpy(&procs[j+1], &procs[j], sizeof(key));
+            usage[j+1] = usage[j];
+        }
+        memcpy(&procs[j+1], &key, sizeof(key));
+        usage[j+1] = key_usage;
+    }
+}
+
+/* Print a value in hundredths with two decimals */
+static void print_hundredths(uint64_t value)
+{
+    printf("%u.%u%u", (uint32_t)(value / 100), (uint32_t)(value / 10 % 10), (uint32_t)(value % 10));
+}
+
+/* Print a time in microseconds as minutes, seconds and hundredths, as in 1:05.20 */
+static void print_cpu_time(uint64_t usec)
+{
+    uint64_t csec = usec / 10000;
+    uint32_t sec = csec / 100 % 60;
+
+    printf("%u:%u%u.%u%u", (uint32_t)(csec / 6000), sec / 10, sec % 10, (uint32_t)(csec / 10 % 10), (uint32_t)(csec % 10));
+}
+
+static void refresh(uint64_t interval_us)
+{
+    uint64_t loads[3];
+    int running = 0, sleeping = 0, stopped = 0;
+    int count = get_proc_snapshot(procs, TOP_MAX_PROCS, 1);
+
+    if (count > TOP_MAX_PROCS)
+        count = TOP_MAX_PROCS;
+    for (int i = 0; i < count; i++)
+    {
+        /* Processes which were not there at the previous refresh ran for at most what they have used so far */
+        uint64_t delta = cpu_time(procs + i) - prev_cpu_time(procs[i].pid);
+        usage[i] = interval_us > 0 ? delta * 1000 / interval_us : 0;
+        if (procs[i].state == RUNNING || procs[i].state == READY)
+            running++;
+        else if (procs[i].state == SLEEP)
+            sleeping++;
+        else if (procs[i].state == STOPPED)
+            stopped++;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        prev[i].pid = procs[i].pid;
+        prev[i].cpu_time = cpu_time(procs + i);
+    }
+    prev_count = count;
+    sort_procs(count);
+
+    /* Clear the screen and move the cursor to the top left corner */
+    printf("\x1b[2J\x1b[H");
+    printf("top - up %u min, load average: ", (uint32_t)(get_ticks() / 6000));
+    if (getloadavg(loads) == 0){
+        print_hundredths(loads[0]);
+        printf(", ");
+        print_hundredths(loads[1]);
+        printf(", ");
+        print_hundredths(loads[2]);
+    }
+    printf("\nTasks: %d total, %d running, %d sleeping, %d stopped\n\n", count, running, sleeping, stopped);
+    printf("PID\tNI\tS\t%cCPU\tTIME\tWAIT\tVCSW\tIVCSW\tRSS(K)\tCMD\n", '%');
+    for (int i = 0; i < count; i++)
+    {
+        printf("%d\t%d\t%c\t%u.%u\t", procs[i].pid, procs[i].nice, state_rep(procs[i].state), usage[i] / 10, usage[i] % 10);
+        print_cpu_time(cpu_time(procs + i));
+        printf("\t");
+        print_cpu_time(procs[i].wait_time);
+        printf("\t%u\t%u\t%u\t%s\n", (uint32_t)procs[i].nvcsw, (uint32_t)procs[i].nivcsw, (uint32_t)procs[i].rss, procs[i].name);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int delay = 2;
+    int iterations = 0;
+    int opt = 1;
+
+    while (opt < argc)
+    {
+        if (argv[opt][0] == '-' && argv[opt][1] == 'h' && argv[opt][2] == 0){
+            print_usage();
+            return 0;
+        }
+        if (argv[opt][0] == '-' && (argv[opt][1] == 'd' || argv[opt][1] == 'n') && argv[opt][2] == 0 && opt+1 < argc){
+            if (argv[opt][1] == 'd')
+                delay = atoi(argv[opt+1]);
+            else
+                iterations = atoi(argv[opt+1]);
+            opt += 2;
+            continue;
+        }
+        printf("%s: invalid option \'%s\'\n", argv[0], argv[opt]);
+        printf("Try \'%s -h\' for more information\n", argv[0]);
+        return 1;
+    }
+    if (delay < 1)
+        delay = 1;
+
+    /* The first refresh reports use since each process started, measured against the uptime */
+    uint64_t last = clock_ns();
+    refresh(last / 1000);
+    for (int i = 1; iterations == 0 || i < iterations; i++)
+    {
+        msleep(delay * 100);
+        uint64_t now = clock_ns();
+        refresh((now - last) / 1000);
+        last = now;
+    }
+
+    return 0;
+}